@@ -0,0 +1,229 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "batchrenderer.h"
+
+// STL includes
+#include <chrono>
+
+// LegacySPC includes
+#include "mappedspcfile.h"
+#include "spcrunner.h"
+#include "threadpool.h"
+#include "wavfilewriter.h"
+
+namespace LegacySPC
+{
+
+// Frames rendered and written at once
+static const int ChunkFrames = 4096;
+
+class BatchRenderer::Private
+{
+public:
+	Private()
+	 : threadCount(0), sampleRate(32000),
+	   defaultSongLength(180), defaultFadeoutLength(10000),
+	   silenceLength(0), silenceThreshold(0), haltDetection(false)
+	{}
+
+	int threadCount;
+	int sampleRate;
+	int defaultSongLength;
+	int defaultFadeoutLength;
+	int silenceLength;
+	int silenceThreshold;
+	bool haltDetection;
+	BatchSummary summary;
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+}
+
+BatchRenderer::BatchRenderer()
+ : d(new Private)
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+	delete d;
+}
+
+void BatchRenderer::setThreadCount(int threadCount)
+{
+	d->threadCount = threadCount;
+}
+
+void BatchRenderer::setOutputSampleRate(int rate)
+{
+	if( rate > 0 )
+	{
+		d->sampleRate = rate;
+	}
+}
+
+void BatchRenderer::setDefaultLengths(int songLength, int fadeoutLength)
+{
+	d->defaultSongLength = songLength;
+	d->defaultFadeoutLength = fadeoutLength;
+}
+
+void BatchRenderer::setSilenceDetection(int milliseconds, int threshold)
+{
+	d->silenceLength = milliseconds;
+	d->silenceThreshold = threshold;
+}
+
+void BatchRenderer::setHaltDetection(bool enabled)
+{
+	d->haltDetection = enabled;
+}
+
+std::vector<BatchJobResult> BatchRenderer::render(const std::vector<BatchJob> &jobs)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Each task writes only its own result
+	std::vector<BatchJobResult> results(jobs.size());
+	{
+		ThreadPool pool(d->threadCount);
+		for(size_t i = 0; i < jobs.size(); i++)
+		{
+			const BatchJob *job = &jobs[i];
+			BatchJobResult *result = &results[i];
+			pool.submit( [this, job, result]() { renderJob(*job, *result); } );
+		}
+		pool.wait();
+	}
+
+	d->summary = BatchSummary();
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		if( results[i].success )
+		{
+			d->summary.succeeded++;
+			d->summary.emulatedSeconds += results[i].emulatedSeconds;
+		}
+		else
+		{
+			d->summary.failed++;
+		}
+	}
+	d->summary.wallSeconds = secondsSince(start);
+
+	return results;
+}
+
+BatchSummary BatchRenderer::summary() const
+{
+	return d->summary;
+}
+
+void BatchRenderer::renderJob(const BatchJob &job, BatchJobResult &result) const
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	result = BatchJobResult();
+	result.job = job;
+
+	MappedSpcFile file(job.inputFile);
+	if( !file.isOpen() )
+	{
+		result.errorMessage = "Can't read SPC file";
+		result.wallSeconds = secondsSince(start);
+		return;
+	}
+
+	SpcRunner runner;
+	runner.setOutputSampleRate(d->sampleRate);
+	runner.setSilenceDetection(d->silenceLength, d->silenceThreshold);
+	runner.setHaltDetection(d->haltDetection);
+	if( !runner.loadSpcFile(file) )
+	{
+		result.errorMessage = "Can't load SPC file";
+		result.wallSeconds = secondsSince(start);
+		return;
+	}
+
+	ID666Tag tag = file.id666Tag();
+	int songLength = tag.songLength > 0 ? tag.songLength : d->defaultSongLength;
+	int fadeoutLength = tag.fadeoutLength > 0 ? tag.fadeoutLength : d->defaultFadeoutLength;
+
+	long long songFrames = static_cast<long long>(songLength) * d->sampleRate;
+	long long fadeFrames = static_cast<long long>(fadeoutLength) * d->sampleRate / 1000;
+
+	// The xid6 lengths are more precise, and the only ones in many files
+	ExtendedID666Tag extendedTag = file.extendedTag();
+	if( extendedTag.playLength() > 0 )
+	{
+		songFrames = extendedTag.playLength() * d->sampleRate / ExtendedID666Tag::TicksPerSecond;
+		if( extendedTag.fadeLength > 0 )
+		{
+			fadeFrames = static_cast<long long>(extendedTag.fadeLength) * d->sampleRate / ExtendedID666Tag::TicksPerSecond;
+		}
+	}
+	runner.setMutedVoices(extendedTag.mutedVoices);
+
+	long long totalFrames = songFrames + fadeFrames;
+
+	WavFileWriter writer;
+	if( !writer.open(job.outputFile, d->sampleRate) )
+	{
+		result.errorMessage = "Can't create WAV file";
+		result.wallSeconds = secondsSince(start);
+		return;
+	}
+
+	s16 buffer[ChunkFrames * 2];
+	bool success = true;
+	long long frame = 0;
+	while( frame < totalFrames && success && runner.endReason() == SpcRunner::NotEnded )
+	{
+		int frames = totalFrames - frame < ChunkFrames ? static_cast<int>(totalFrames - frame) : ChunkFrames;
+		frames = static_cast<int>( runner.render(buffer, frames) );
+
+		// Linear fadeout after the song length
+		for(int i = 0; i < frames; i++)
+		{
+			long long position = frame + i;
+			if( position >= songFrames )
+			{
+				long long remaining = totalFrames - position;
+				buffer[i * 2] = static_cast<s16>( buffer[i * 2] * remaining / fadeFrames );
+				buffer[i * 2 + 1] = static_cast<s16>( buffer[i * 2 + 1] * remaining / fadeFrames );
+			}
+		}
+
+		success = writer.write(buffer, frames);
+		frame += frames;
+	}
+	success = writer.close() && success;
+
+	if( success )
+	{
+		result.success = true;
+		result.endReason = runner.endReason();
+		result.emulatedSeconds = static_cast<double>(frame) / d->sampleRate;
+	}
+	else
+	{
+		result.errorMessage = "Can't write WAV file";
+	}
+	result.wallSeconds = secondsSince(start);
+}
+
+}
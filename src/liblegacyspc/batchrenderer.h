@@ -0,0 +1,191 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_BATCHRENDERER_H
+#define LEGACYSPC_BATCHRENDERER_H
+
+#include <legacyspc_export.h>
+
+#include <spcrunner.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief SPC file to render to a WAV file
+ */
+struct BatchJob
+{
+	BatchJob()
+	{}
+
+	BatchJob(const std::string &input, const std::string &output)
+	 : inputFile(input), outputFile(output)
+	{}
+
+	/**
+	 * @brief Path of the SPC file
+	 */
+	std::string inputFile;
+	/**
+	 * @brief Path of the WAV file to create
+	 */
+	std::string outputFile;
+};
+
+/**
+ * @brief Outcome of a BatchJob
+ */
+struct BatchJobResult
+{
+	BatchJobResult()
+	 : success(false), endReason(SpcRunner::NotEnded), emulatedSeconds(0.0), wallSeconds(0.0)
+	{}
+
+	BatchJob job;
+	bool success;
+	/**
+	 * @brief Reason of the failure
+	 */
+	std::string errorMessage;
+	/**
+	 * @brief Why the song ended before its length
+	 */
+	SpcRunner::EndReason endReason;
+	/**
+	 * @brief Length of the rendered song, fadeout included
+	 */
+	double emulatedSeconds;
+	/**
+	 * @brief Time taken to render the job
+	 */
+	double wallSeconds;
+};
+
+/**
+ * @brief Totals of a batch
+ */
+struct BatchSummary
+{
+	BatchSummary()
+	 : succeeded(0), failed(0), emulatedSeconds(0.0), wallSeconds(0.0)
+	{}
+
+	/**
+	 * @brief Get the emulated seconds rendered per wall second
+	 * @return Throughput, 0 when nothing was rendered
+	 */
+	double throughput() const
+	{
+		return wallSeconds > 0.0 ? emulatedSeconds / wallSeconds : 0.0;
+	}
+
+	int succeeded;
+	int failed;
+	double emulatedSeconds;
+	/**
+	 * @brief Time taken by the whole batch
+	 */
+	double wallSeconds;
+};
+
+/**
+ * @brief Render many SPC files to WAV files in parallel
+ *
+ * Each job has its own SpcRunner, the jobs are spread over a
+ * work-stealing ThreadPool. A song plays for the length of its
+ * ID666 tag, then fades out for the fadeout length of the tag.
+ * The lengths and the muted voices of the xid6 tag win when present.
+ * The defaults are used for the tags without lengths. With the end
+ * detection, the WAV file stops where the song was found to end.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT BatchRenderer
+{
+public:
+	/**
+	 * @brief Create a new instance of BatchRenderer
+	 */
+	BatchRenderer();
+	/**
+	 * @brief Destructor
+	 */
+	~BatchRenderer();
+
+	/**
+	 * @brief Set the number of threads used to render
+	 * @param threadCount Thread count, 0 for one per core
+	 */
+	void setThreadCount(int threadCount);
+
+	/**
+	 * @brief Set the sample rate of the WAV files
+	 * @param rate Sample rate in Hz, 32000 by default
+	 */
+	void setOutputSampleRate(int rate);
+
+	/**
+	 * @brief Set the lengths used when the ID666 tag has none
+	 * @param songLength Seconds before the fadeout
+	 * @param fadeoutLength Fadeout in milliseconds
+	 */
+	void setDefaultLengths(int songLength, int fadeoutLength);
+
+	/**
+	 * @brief Stop a song after a length of silence
+	 * @param milliseconds Length of the silence, 0 to disable the detection
+	 * @param threshold Highest absolute sample value counted as silence
+	 * @see SpcRunner::setSilenceDetection()
+	 */
+	void setSilenceDetection(int milliseconds, int threshold = 0);
+
+	/**
+	 * @brief Stop a song when its CPU executes SLEEP or STOP
+	 * @param enabled true to detect a halted CPU
+	 */
+	void setHaltDetection(bool enabled);
+
+	/**
+	 * @brief Render the jobs and wait for them to finish
+	 * @param jobs Jobs to render
+	 * @return A result for each job, in the same order
+	 */
+	std::vector<BatchJobResult> render(const std::vector<BatchJob> &jobs);
+
+	/**
+	 * @brief Get the totals of the last render()
+	 * @return Summary of the last batch
+	 */
+	BatchSummary summary() const;
+
+	/**
+	 * @brief Render a single job in the calling thread
+	 * @param job Job to render
+	 * @param result Filled with the outcome of the job
+	 */
+	void renderJob(const BatchJob &job, BatchJobResult &result) const;
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "compressedsnapshot.h"
+
+// STL includes
+#include <cstddef>
+
+// LegacySPC includes
+#include "snapshotcodec.h"
+#include "spcstate.h"
+
+namespace LegacySPC
+{
+
+// The registers, timers and DSP state follow the RAM
+static const size_t RestOffset = offsetof(SpcState, ram) + sizeof(SpcState::ram);
+static const size_t RestSize = sizeof(SpcState) - RestOffset;
+
+CompressedSnapshot::CompressedSnapshot()
+ : m_position(0)
+{
+}
+
+void CompressedSnapshot::compress(const SpcState &state, const byte *referenceRam)
+{
+	m_position = state.position;
+
+	m_data.clear();
+	SnapshotCodec::encode(state.ram, referenceRam, sizeof(state.ram), m_data);
+	SnapshotCodec::encode(reinterpret_cast<const byte*>(&state) + RestOffset, 0, RestSize, m_data);
+
+	m_data.shrink_to_fit();
+}
+
+bool CompressedSnapshot::decompress(SpcState &state, const byte *referenceRam) const
+{
+	if( m_data.empty() )
+	{
+		return false;
+	}
+
+	size_t used = SnapshotCodec::decode(&m_data[0], m_data.size(), referenceRam, state.ram, sizeof(state.ram));
+	if( !used )
+	{
+		return false;
+	}
+
+	if( !SnapshotCodec::decode(&m_data[used], m_data.size() - used, 0, reinterpret_cast<byte*>(&state) + RestOffset, RestSize) )
+	{
+		return false;
+	}
+
+	state.position = m_position;
+	return true;
+}
+
+long long CompressedSnapshot::position() const
+{
+	return m_position;
+}
+
+size_t CompressedSnapshot::size() const
+{
+	return sizeof(*this) + m_data.capacity();
+}
+
+bool CompressedSnapshot::isEmpty() const
+{
+	return m_data.empty();
+}
+
+void CompressedSnapshot::clear()
+{
+	m_position = 0;
+	std::vector<byte>().swap(m_data);
+}
+
+}
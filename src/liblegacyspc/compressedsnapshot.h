@@ -0,0 +1,106 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_COMPRESSEDSNAPSHOT_H
+#define LEGACYSPC_COMPRESSEDSNAPSHOT_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+#include <vector>
+
+namespace LegacySPC
+{
+
+struct SpcState;
+
+/**
+ * @brief SpcState compressed against the RAM of its file
+ *
+ * The RAM is stored as the difference with a reference RAM,
+ * usually the RAM of the loaded file, and the rest of the state
+ * as is, both compressed with SnapshotCodec. A snapshot of a song
+ * takes a few kilobytes instead of the 64 KiB of a SpcState, so
+ * thousands can be kept for seeking and rewinding.
+ *
+ * Restoring needs the same reference RAM as compressing, and the
+ * same SpcState layout: snapshots are kept in memory, use
+ * SpcStateFile to save states in files.
+ *
+ * @code
+LegacySPC::CompressedSnapshot snapshot;
+runner.saveSnapshot(snapshot);
+...
+runner.restoreSnapshot(snapshot);
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ * @see SpcRunner::saveSnapshot()
+ */
+class LEGACYSPC_EXPORT CompressedSnapshot
+{
+public:
+	/**
+	 * @brief Create an empty snapshot
+	 */
+	CompressedSnapshot();
+
+	/**
+	 * @brief Compress a state
+	 * @param state State to compress
+	 * @param referenceRam RAM to compare with, null to compress the RAM alone
+	 */
+	void compress(const SpcState &state, const byte *referenceRam);
+
+	/**
+	 * @brief Decompress the state
+	 * @param state Receives the state
+	 * @param referenceRam RAM given to compress()
+	 * @return false if the snapshot is empty or invalid
+	 */
+	bool decompress(SpcState &state, const byte *referenceRam) const;
+
+	/**
+	 * @brief Get the position of the state
+	 * @return DSP samples generated since the file was loaded
+	 */
+	long long position() const;
+
+	/**
+	 * @brief Get the memory used by the compressed state
+	 * @return Size in bytes
+	 */
+	size_t size() const;
+
+	/**
+	 * @brief Check if a state was compressed
+	 * @return true if compress() was never called
+	 */
+	bool isEmpty() const;
+
+	/**
+	 * @brief Free the compressed state
+	 */
+	void clear();
+
+private:
+	long long m_position;
+	std::vector<byte> m_data;
+};
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "contenthasher.h"
+
+// STL includes
+#include <cstring>
+
+namespace LegacySPC
+{
+
+static const unsigned long long HashMultiplier = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long readWord(const byte *data)
+{
+	unsigned long long word;
+	memcpy(&word, data, sizeof(word));
+#ifndef LEGACYSPC_LSB
+	word = ( (word & 0x00000000000000FFULL) << 56 ) | ( (word & 0x000000000000FF00ULL) << 40 ) |
+	       ( (word & 0x0000000000FF0000ULL) << 24 ) | ( (word & 0x00000000FF000000ULL) << 8 ) |
+	       ( (word & 0x000000FF00000000ULL) >> 8 ) | ( (word & 0x0000FF0000000000ULL) >> 24 ) |
+	       ( (word & 0x00FF000000000000ULL) >> 40 ) | ( (word & 0xFF00000000000000ULL) >> 56 );
+#endif
+	return word;
+}
+
+ContentHasher::ContentHasher()
+{
+	reset();
+}
+
+void ContentHasher::reset()
+{
+	m_hash = HashMultiplier;
+	m_size = 0;
+	m_pendingSize = 0;
+}
+
+void ContentHasher::addWord(unsigned long long word)
+{
+	m_hash = (m_hash ^ word) * HashMultiplier;
+	m_hash ^= m_hash >> 32;
+}
+
+void ContentHasher::add(const byte *data, size_t size)
+{
+	m_size += size;
+
+	// Complete the word of the previous call first
+	if( m_pendingSize )
+	{
+		while( m_pendingSize < sizeof(m_pending) && size )
+		{
+			m_pending[m_pendingSize++] = *data++;
+			size--;
+		}
+		if( m_pendingSize < sizeof(m_pending) )
+		{
+			return;
+		}
+		addWord( readWord(m_pending) );
+		m_pendingSize = 0;
+	}
+
+	for(; size >= 8; data += 8, size -= 8)
+	{
+		addWord( readWord(data) );
+	}
+
+	memcpy(m_pending, data, size);
+	m_pendingSize = size;
+}
+
+unsigned long long ContentHasher::result() const
+{
+	unsigned long long hash = m_hash;
+	for(size_t i = 0; i < m_pendingSize; i++)
+	{
+		hash = (hash ^ m_pending[i]) * HashMultiplier;
+		hash ^= hash >> 32;
+	}
+
+	hash ^= m_size * HashMultiplier;
+	hash ^= hash >> 32;
+	hash *= HashMultiplier;
+	hash ^= hash >> 29;
+
+	// 0 is left to mean "no hash"
+	return hash ? hash : 1;
+}
+
+}
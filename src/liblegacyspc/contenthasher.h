@@ -0,0 +1,80 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_CONTENTHASHER_H
+#define LEGACYSPC_CONTENTHASHER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Streaming 64-bit hash of a byte stream
+ *
+ * The data can be added in pieces of any size, the hash only
+ * depends on the bytes and their order. The bytes are read as
+ * little-endian words, so the hash is the same on every platform
+ * and can be stored in files.
+ *
+ * It is a fast multiply-xorshift hash to find identical contents,
+ * not a cryptographic hash.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT ContentHasher
+{
+public:
+	/**
+	 * @brief Create a hasher with no data
+	 */
+	ContentHasher();
+
+	/**
+	 * @brief Start again with no data
+	 */
+	void reset();
+
+	/**
+	 * @brief Add data to the hash
+	 * @param data Bytes to add
+	 * @param size Number of bytes
+	 */
+	void add(const byte *data, size_t size);
+
+	/**
+	 * @brief Get the hash of the data added so far
+	 *
+	 * More data can be added afterwards.
+	 * @return Hash, never 0
+	 */
+	unsigned long long result() const;
+
+private:
+	void addWord(unsigned long long word);
+
+	unsigned long long m_hash;
+	unsigned long long m_size;
+	// Bytes waiting for a complete word
+	byte m_pending[8];
+	size_t m_pendingSize;
+};
+
+}
+
+#endif
@@ -0,0 +1,1141 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "dsp.h"
+
+// STL includes
+#include <cstring>
+
+// LegacySPC includes
+#include "ram.h"
+#include "spcstate.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+// Gaussian interpolation table of the S-DSP, as read from the
+// chip. The four taps used for any position sum to 2047-2049.
+static const s16 GaussianTable[512] =
+{
+	   0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+	   1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    1,    2,    2,    2,    2,    2,
+	   2,    2,    3,    3,    3,    3,    3,    4,    4,    4,    4,    4,    5,    5,    5,    5,
+	   6,    6,    6,    6,    7,    7,    7,    8,    8,    8,    9,    9,    9,   10,   10,   10,
+	  11,   11,   11,   12,   12,   13,   13,   14,   14,   15,   15,   15,   16,   16,   17,   17,
+	  18,   19,   19,   20,   20,   21,   22,   22,   23,   23,   24,   25,   25,   26,   27,   27,
+	  28,   29,   29,   30,   31,   32,   32,   33,   34,   35,   36,   36,   37,   38,   39,   40,
+	  41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   52,   53,   54,   55,   56,
+	  58,   59,   60,   61,   62,   64,   65,   66,   67,   69,   70,   71,   73,   74,   76,   77,
+	  78,   80,   81,   83,   84,   86,   87,   89,   90,   92,   94,   95,   97,   99,  100,  102,
+	 104,  106,  107,  109,  111,  113,  115,  117,  118,  120,  122,  124,  126,  128,  130,  132,
+	 134,  137,  139,  141,  143,  145,  147,  150,  152,  154,  156,  159,  161,  163,  166,  168,
+	 171,  173,  175,  178,  180,  183,  186,  188,  191,  193,  196,  199,  201,  204,  207,  210,
+	 212,  215,  218,  221,  224,  227,  230,  233,  236,  239,  242,  245,  248,  251,  254,  257,
+	 260,  263,  267,  270,  273,  276,  280,  283,  286,  290,  293,  297,  300,  304,  307,  311,
+	 314,  318,  321,  325,  328,  332,  336,  339,  343,  347,  351,  354,  358,  362,  366,  370,
+	 374,  378,  381,  385,  389,  393,  397,  401,  405,  410,  414,  418,  422,  426,  430,  434,
+	 439,  443,  447,  451,  456,  460,  464,  469,  473,  477,  482,  486,  491,  495,  499,  504,
+	 508,  513,  517,  522,  527,  531,  536,  540,  545,  550,  554,  559,  563,  568,  573,  577,
+	 582,  587,  592,  596,  601,  606,  611,  615,  620,  625,  630,  635,  640,  644,  649,  654,
+	 659,  664,  669,  674,  678,  683,  688,  693,  698,  703,  708,  713,  718,  723,  728,  732,
+	 737,  742,  747,  752,  757,  762,  767,  772,  777,  782,  787,  792,  797,  802,  806,  811,
+	 816,  821,  826,  831,  836,  841,  846,  851,  855,  860,  865,  870,  875,  880,  884,  889,
+	 894,  899,  904,  908,  913,  918,  923,  927,  932,  937,  941,  946,  951,  955,  960,  965,
+	 969,  974,  978,  983,  988,  992,  997, 1001, 1005, 1010, 1014, 1019, 1023, 1027, 1032, 1036,
+	1040, 1045, 1049, 1053, 1057, 1061, 1066, 1070, 1074, 1078, 1082, 1086, 1090, 1094, 1098, 1102,
+	1106, 1109, 1113, 1117, 1121, 1125, 1128, 1132, 1136, 1139, 1143, 1146, 1150, 1153, 1157, 1160,
+	1164, 1167, 1170, 1174, 1177, 1180, 1183, 1186, 1190, 1193, 1196, 1199, 1202, 1205, 1207, 1210,
+	1213, 1216, 1219, 1221, 1224, 1227, 1229, 1232, 1234, 1237, 1239, 1241, 1244, 1246, 1248, 1251,
+	1253, 1255, 1257, 1259, 1261, 1263, 1265, 1267, 1269, 1270, 1272, 1274, 1275, 1277, 1279, 1280,
+	1282, 1283, 1284, 1286, 1287, 1288, 1290, 1291, 1292, 1293, 1294, 1295, 1296, 1297, 1297, 1298,
+	1299, 1300, 1300, 1301, 1302, 1302, 1303, 1303, 1303, 1304, 1304, 1304, 1304, 1304, 1305, 1305
+};
+
+// Number of samples of the global counter period used
+// by the envelopes and the noise generator.
+static const int CounterRange = 2048 * 5 * 3;
+
+static const int CounterRates[32] =
+{
+	CounterRange + 1, // Never fire
+	2048, 1536, 1280, 1024, 768, 640, 512, 384, 320, 256, 192, 160, 128, 96, 80,
+	64, 48, 40, 32, 24, 20, 16, 12, 10, 8, 6, 5, 4, 3, 2, 1
+};
+
+static const int CounterOffsets[32] =
+{
+	1, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536,
+	0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 536, 0, 1040, 0, 0
+};
+
+// Number of decoded BRR samples kept for each voice
+static const int BrrBufferSize = 12;
+// Size of a BRR block in bytes, one header and eight bytes of nibbles
+static const int BrrBlockSize = 9;
+
+/**
+ * @internal
+ * @brief Register write waiting to be applied
+ */
+struct QueuedWrite
+{
+	int sampleTime;
+	byte address;
+	byte value;
+};
+
+// CPU write to RAM the lagging DSP must not see yet
+struct JournaledRamWrite
+{
+	int sampleTime;
+	uint16 address;
+	byte previousValue;
+};
+
+enum EnvelopeMode
+{
+	ReleaseMode,
+	AttackMode,
+	DecayMode,
+	SustainMode
+};
+
+typedef DspVoiceState DspVoice;
+
+static_assert( sizeof(DspVoiceState::buffer) == BrrBufferSize * 2 * sizeof(int), "BRR buffer size mismatch" );
+
+static inline int clamp16(int value)
+{
+	if( static_cast<s16>(value) != value )
+	{
+		value = (value >> 31) ^ 0x7FFF;
+	}
+
+	return value;
+}
+
+// The state saved by Dsp::saveState() is a base class,
+// so it is copied at once.
+class Dsp::Private : public DspState
+{
+public:
+	Private()
+	 : ram(0), ramData(0), mutedVoices(0), stateOnly(false),
+	   hasStems(false), stemPosition(0),
+	   inBlock(false), blockBuffer(0), blockSize(0), blockPosition(0),
+	   queueHead(0), queueTail(0), journalCount(0)
+	{
+		memset(journalPages, 0, sizeof(journalPages));
+		reset();
+	}
+
+	void reset()
+	{
+		memset(registers, 0, sizeof(registers));
+		memset(writtenRegisters, 0, sizeof(writtenRegisters));
+		memset(voices, 0, sizeof(voices));
+		memset(echoHistory, 0, sizeof(echoHistory));
+
+		registers[Flags] = 0xE0;
+		writtenRegisters[Flags] = 0xE0;
+
+		counter = 0;
+		noise = 0x4000;
+		echoOffset = 0;
+		echoLength = 0;
+		echoHistoryPosition = 0;
+		newKeyOn = 0;
+		activeVoices = 0;
+		memset(reserved, 0, sizeof(reserved));
+	}
+
+	bool isCounterFiring(int rate) const
+	{
+		return (counter + CounterOffsets[rate]) % CounterRates[rate] == 0;
+	}
+
+	/**
+	 * @brief Read RAM as it was at the sample being generated
+	 */
+	byte readRam(int address) const
+	{
+		address &= 0xFFFF;
+		if( journalPages[address >> 13] & (1u << ((address >> 8) & 31)) )
+		{
+			// The first later write holds the value at this time
+			for(int i = 0; i < journalCount; i++)
+			{
+				const JournaledRamWrite &write = ramJournal[i];
+				if( write.address == address && write.sampleTime > blockPosition )
+				{
+					return write.previousValue;
+				}
+			}
+		}
+
+		return ramData[address];
+	}
+
+	int readRamWord(int address) const
+	{
+		return readRam(address) | (readRam(address + 1) << 8);
+	}
+
+	void clearRamJournal()
+	{
+		if( journalCount )
+		{
+			journalCount = 0;
+			memset(journalPages, 0, sizeof(journalPages));
+		}
+	}
+
+	/**
+	 * @brief Check if the DSP can read or write the echo buffer at an address
+	 *
+	 * Both the current and the last written echo registers are
+	 * considered, they differ while writes are queued.
+	 */
+	bool isInEchoBuffer(int address) const
+	{
+		int length = echoLength;
+		int currentLength = (registers[EchoDelay] & 0x0F) << 11;
+		int writtenLength = (writtenRegisters[EchoDelay] & 0x0F) << 11;
+		if( currentLength > length )
+		{
+			length = currentLength;
+		}
+		if( writtenLength > length )
+		{
+			length = writtenLength;
+		}
+		if( length < 4 )
+		{
+			length = 4;
+		}
+
+		return ((address - (registers[EchoStart] << 8)) & 0xFFFF) < length ||
+		       ((address - (writtenRegisters[EchoStart] << 8)) & 0xFFFF) < length;
+	}
+
+	void stopVoice(int voiceIndex)
+	{
+		DspVoice &voice = voices[voiceIndex];
+
+		voice.envelope = 0;
+		voice.envelopeMode = ReleaseMode;
+		voice.output = 0;
+
+		registers[(voiceIndex << 4) + EnvelopeX] = 0;
+		registers[(voiceIndex << 4) + OutputX] = 0;
+
+		activeVoices &= ~(1 << voiceIndex);
+	}
+
+	static bool isVolatileRegister(byte address)
+	{
+		int voiceRegister = address & 0x0F;
+
+		return voiceRegister == EnvelopeX || voiceRegister == OutputX || address == EndX;
+	}
+
+	void writeRegister(byte address, byte value);
+	void keyOnVoice(int voiceIndex);
+	void decodeBrr(int voiceIndex);
+	int interpolate(const DspVoice &voice) const;
+	void runEnvelope(int voiceIndex);
+
+	// The stem output and the state only mode are template
+	// parameters so the common path has no extra work.
+	template<bool WithStems, bool StateOnly>
+	void runSample(s16 *output);
+	// Advances blockPosition. In state only mode, the last sample
+	// can be generated in full.
+	void render(s16 *buffer, int sampleCount, bool exactLastSample);
+
+	Ram *ram;
+	byte *ramData;
+
+	byte mutedVoices;
+	bool stateOnly;
+
+	bool hasStems;
+	StemBuffers stems;
+	int stemPosition;
+
+	bool inBlock;
+	s16 *blockBuffer;
+	int blockSize;
+	int blockPosition;
+
+	QueuedWrite writeQueue[MaxQueuedWrites];
+	int queueHead;
+	int queueTail;
+
+	JournaledRamWrite ramJournal[MaxJournaledRamWrites];
+	int journalCount;
+	// 256 bits, one for each RAM page with a journaled write
+	uint32 journalPages[8];
+};
+
+void Dsp::Private::writeRegister(byte address, byte value)
+{
+	switch( address )
+	{
+		case KeyOn:
+			newKeyOn |= value;
+			break;
+		case EndX:
+			// Any write clear ENDX
+			value = 0;
+			break;
+	}
+
+	registers[address] = value;
+}
+
+void Dsp::Private::keyOnVoice(int voiceIndex)
+{
+	DspVoice &voice = voices[voiceIndex];
+
+	int directoryEntry = (registers[SourceDirectory] << 8) + (registers[(voiceIndex << 4) + SourceNumber] << 2);
+
+	memset(voice.buffer, 0, sizeof(voice.buffer));
+	voice.bufferPosition = 0;
+	voice.interpolationPosition = 0;
+	voice.brrAddress = readRamWord(directoryEntry);
+	voice.brrOffset = 1;
+	voice.envelope = 0;
+	voice.envelopeMode = AttackMode;
+	voice.output = 0;
+
+	registers[EndX] &= ~(1 << voiceIndex);
+
+	activeVoices |= 1 << voiceIndex;
+}
+
+void Dsp::Private::decodeBrr(int voiceIndex)
+{
+	DspVoice &voice = voices[voiceIndex];
+
+	int header = readRam(voice.brrAddress);
+	int shift = header >> 4;
+	int filter = header & 0x0C;
+
+	int nibbles = (readRam(voice.brrAddress + voice.brrOffset) << 8) |
+	              readRam(voice.brrAddress + voice.brrOffset + 1);
+
+	int *position = &voice.buffer[voice.bufferPosition];
+	for(int i = 0; i < 4; i++, position++, nibbles <<= 4)
+	{
+		// Sign extend the upper nibble
+		int sample = static_cast<s16>(nibbles) >> 12;
+
+		sample = (sample << shift) >> 1;
+		if( shift >= 0xD )
+		{
+			// Invalid shift ranges keep only the sign
+			sample = (sample >> 25) << 11;
+		}
+
+		// Previous samples, read from the doubled part of the buffer
+		int p1 = position[BrrBufferSize - 1];
+		int p2 = position[BrrBufferSize - 2] >> 1;
+
+		if( filter >= 8 )
+		{
+			sample += p1;
+			sample -= p2;
+			if( filter == 8 )
+			{
+				sample += p2 >> 4;
+				sample += (p1 * -3) >> 6;
+			}
+			else
+			{
+				sample += (p1 * -13) >> 7;
+				sample += (p2 * 3) >> 4;
+			}
+		}
+		else if( filter )
+		{
+			sample += p1 >> 1;
+			sample += (-p1) >> 5;
+		}
+
+		sample = static_cast<s16>( clamp16(sample) * 2 );
+
+		position[0] = sample;
+		position[BrrBufferSize] = sample;
+	}
+
+	voice.bufferPosition += 4;
+	if( voice.bufferPosition >= BrrBufferSize )
+	{
+		voice.bufferPosition = 0;
+	}
+
+	voice.brrOffset += 2;
+	if( voice.brrOffset >= BrrBlockSize )
+	{
+		voice.brrOffset = 1;
+
+		if( header & 0x01 )
+		{
+			// End of sample, continue at the loop address
+			int directoryEntry = (registers[SourceDirectory] << 8) + (registers[(voiceIndex << 4) + SourceNumber] << 2);
+			voice.brrAddress = readRamWord(directoryEntry + 2);
+
+			registers[EndX] |= 1 << voiceIndex;
+
+			if( !(header & 0x02) )
+			{
+				stopVoice(voiceIndex);
+			}
+		}
+		else
+		{
+			voice.brrAddress = (voice.brrAddress + BrrBlockSize) & 0xFFFF;
+		}
+	}
+}
+
+int Dsp::Private::interpolate(const DspVoice &voice) const
+{
+	int offset = (voice.interpolationPosition >> 4) & 0xFF;
+	const s16 *forward = GaussianTable + 255 - offset;
+	const s16 *reverse = GaussianTable + offset;
+
+	const int *in = &voice.buffer[voice.bufferPosition + (voice.interpolationPosition >> 12)];
+
+	int output = (forward[0] * in[0]) >> 11;
+	output += (forward[256] * in[1]) >> 11;
+	output += (reverse[256] * in[2]) >> 11;
+	output = static_cast<s16>(output);
+	output += (reverse[0] * in[3]) >> 11;
+
+	return clamp16(output) & ~1;
+}
+
+void Dsp::Private::runEnvelope(int voiceIndex)
+{
+	DspVoice &voice = voices[voiceIndex];
+	const byte *voiceRegisters = &registers[voiceIndex << 4];
+
+	int envelope = voice.envelope;
+
+	if( voice.envelopeMode == ReleaseMode )
+	{
+		envelope -= 0x8;
+		if( envelope <= 0 )
+		{
+			stopVoice(voiceIndex);
+			return;
+		}
+
+		voice.envelope = envelope;
+		return;
+	}
+
+	int rate;
+	int adsr1 = voiceRegisters[Adsr1];
+	if( adsr1 & 0x80 )
+	{
+		int adsr2 = voiceRegisters[Adsr2];
+
+		if( voice.envelopeMode == AttackMode )
+		{
+			rate = ((adsr1 & 0x0F) << 1) + 1;
+			envelope += rate < 31 ? 0x20 : 0x400;
+		}
+		else
+		{
+			// Exponential decrease
+			envelope--;
+			envelope -= envelope >> 8;
+
+			if( voice.envelopeMode == DecayMode )
+			{
+				rate = ((adsr1 >> 3) & 0x0E) + 0x10;
+			}
+			else
+			{
+				rate = adsr2 & 0x1F;
+			}
+		}
+
+		if( voice.envelopeMode == DecayMode && (envelope >> 8) == (adsr2 >> 5) )
+		{
+			voice.envelopeMode = SustainMode;
+		}
+	}
+	else
+	{
+		int gain = voiceRegisters[Gain];
+
+		if( !(gain & 0x80) )
+		{
+			// Direct gain
+			envelope = (gain & 0x7F) << 4;
+			rate = 31;
+		}
+		else
+		{
+			rate = gain & 0x1F;
+
+			switch( (gain >> 5) & 0x03 )
+			{
+				// Linear decrease
+				case 0:
+					envelope -= 0x20;
+					break;
+				// Exponential decrease
+				case 1:
+					envelope--;
+					envelope -= envelope >> 8;
+					break;
+				// Linear increase
+				case 2:
+					envelope += 0x20;
+					break;
+				// Bent increase
+				case 3:
+					envelope += voice.envelope < 0x600 ? 0x20 : 0x08;
+					break;
+			}
+		}
+	}
+
+	if( static_cast<unsigned>(envelope) > 0x7FF )
+	{
+		envelope = envelope < 0 ? 0 : 0x7FF;
+		if( voice.envelopeMode == AttackMode )
+		{
+			voice.envelopeMode = DecayMode;
+		}
+	}
+
+	if( isCounterFiring(rate) )
+	{
+		voice.envelope = envelope;
+	}
+}
+
+template<bool WithStems, bool StateOnly>
+void Dsp::Private::runSample(s16 *output)
+{
+	if( --counter < 0 )
+	{
+		counter = CounterRange - 1;
+	}
+
+	byte flags = registers[Flags];
+
+	// Soft reset stops every voice
+	if( flags & 0x80 )
+	{
+		for(int i = 0; i < VoiceCount; i++)
+		{
+			if( activeVoices & (1 << i) )
+			{
+				stopVoice(i);
+			}
+		}
+		newKeyOn = 0;
+	}
+
+	// Key on
+	if( newKeyOn )
+	{
+		for(int i = 0; i < VoiceCount; i++)
+		{
+			if( newKeyOn & (1 << i) )
+			{
+				keyOnVoice(i);
+			}
+		}
+		newKeyOn = 0;
+	}
+
+	// Key off
+	byte keyOff = registers[KeyOff] & activeVoices;
+	if( keyOff )
+	{
+		for(int i = 0; i < VoiceCount; i++)
+		{
+			if( keyOff & (1 << i) )
+			{
+				voices[i].envelopeMode = ReleaseMode;
+			}
+		}
+	}
+
+	// Noise generator
+	if( isCounterFiring(flags & 0x1F) )
+	{
+		int feedback = (noise << 13) ^ (noise << 14);
+		noise = (feedback & 0x4000) ^ (noise >> 1);
+	}
+
+	int mainLeft = 0;
+	int mainRight = 0;
+	int echoInputLeft = 0;
+	int echoInputRight = 0;
+
+	byte pitchModulation = registers[PitchModulation];
+	byte noiseEnable = registers[NoiseEnable];
+	byte echoEnable = registers[EchoEnable];
+	bool echoWrites = !(flags & 0x20);
+
+	// Without mixing, only the outputs feeding the echo buffer
+	// or the pitch of the next voice change the state.
+	byte neededOutputs = 0xFF;
+	if( StateOnly )
+	{
+		neededOutputs = (echoWrites ? echoEnable : 0) | (pitchModulation >> 1);
+	}
+	// A muted voice runs as usual but is not heard, its output is
+	// only needed for the pitch of the next voice.
+	neededOutputs &= ~mutedVoices | (pitchModulation >> 1);
+
+	if( WithStems )
+	{
+		byte silentVoices = ~activeVoices | mutedVoices;
+		for(int i = 0; i < VoiceCount; i++)
+		{
+			if( (silentVoices & (1 << i)) && stems.voices[i] )
+			{
+				stems.voices[i][stemPosition] = 0;
+			}
+		}
+	}
+
+	// Only the active voices are processed, an inactive voice
+	// has no BRR to decode and nothing to mix.
+	byte voicesToRun = activeVoices;
+	for(int i = 0; voicesToRun; i++, voicesToRun >>= 1)
+	{
+		if( !(voicesToRun & 1) )
+		{
+			continue;
+		}
+
+		DspVoice &voice = voices[i];
+		byte *voiceRegisters = &registers[i << 4];
+		int voiceBit = 1 << i;
+
+		int pitch = ((voiceRegisters[PitchHigh] & 0x3F) << 8) | voiceRegisters[PitchLow];
+		if( (pitchModulation & voiceBit) && i > 0 )
+		{
+			// Inactive voices have an output of 0
+			pitch += ((voices[i - 1].output >> 5) * pitch) >> 10;
+		}
+
+		voiceRegisters[EnvelopeX] = static_cast<byte>(voice.envelope >> 4);
+
+		if( neededOutputs & voiceBit )
+		{
+			int sample;
+			if( noiseEnable & voiceBit )
+			{
+				sample = static_cast<s16>(noise << 1);
+			}
+			else
+			{
+				sample = interpolate(voice);
+			}
+
+			int voiceOutput = ((sample * voice.envelope) >> 11) & ~1;
+			voice.output = voiceOutput;
+			voiceRegisters[OutputX] = static_cast<byte>(voiceOutput >> 8);
+		}
+
+		if( (neededOutputs & ~mutedVoices) & voiceBit )
+		{
+			int voiceOutput = voice.output;
+
+			if( WithStems && stems.voices[i] )
+			{
+				stems.voices[i][stemPosition] = static_cast<s16>(voiceOutput);
+			}
+
+			int left = (voiceOutput * static_cast<s8>(voiceRegisters[VolumeLeft])) >> 7;
+			int right = (voiceOutput * static_cast<s8>(voiceRegisters[VolumeRight])) >> 7;
+
+			if( !StateOnly )
+			{
+				mainLeft = clamp16(mainLeft + left);
+				mainRight = clamp16(mainRight + right);
+			}
+
+			if( echoEnable & voiceBit )
+			{
+				echoInputLeft = clamp16(echoInputLeft + left);
+				echoInputRight = clamp16(echoInputRight + right);
+			}
+		}
+
+		runEnvelope(i);
+
+		// The voice can be stopped by its envelope
+		if( !(activeVoices & voiceBit) )
+		{
+			continue;
+		}
+
+		// Advance the sample position, decode the next 4 samples
+		// once the oldest group has been consumed.
+		int position = (voice.interpolationPosition & 0x3FFF) + pitch;
+		if( position > 0x7FFF )
+		{
+			position = 0x7FFF;
+		}
+		voice.interpolationPosition = position;
+
+		if( position >= 0x4000 )
+		{
+			decodeBrr(i);
+			voice.interpolationPosition -= 0x4000;
+		}
+	}
+
+	// Echo
+	int echoAddress = ((registers[EchoStart] << 8) + echoOffset) & 0xFFFF;
+	if( echoOffset == 0 )
+	{
+		echoLength = (registers[EchoDelay] & 0x0F) << 11;
+	}
+
+	if( ++echoHistoryPosition >= 8 )
+	{
+		echoHistoryPosition = 0;
+	}
+	for(int channel = 0; channel < 2; channel++)
+	{
+		int echoSample = static_cast<s16>( readRamWord(echoAddress + channel * 2) ) >> 1;
+		echoHistory[echoHistoryPosition][channel] = echoSample;
+		echoHistory[echoHistoryPosition + 8][channel] = echoSample;
+	}
+
+	// Without mixing, the FIR filter only matters for the echo writes
+	int fir[2] = { 0, 0 };
+	if( !StateOnly || echoWrites )
+	{
+		for(int channel = 0; channel < 2; channel++)
+		{
+			const int (*history)[2] = &echoHistory[echoHistoryPosition + 1];
+
+			int sum = 0;
+			for(int tap = 0; tap < 7; tap++)
+			{
+				sum += (history[tap][channel] * static_cast<s8>(registers[(tap << 4) + FirCoefficient])) >> 6;
+			}
+			sum = static_cast<s16>(sum);
+			sum += (history[7][channel] * static_cast<s8>(registers[0x70 + FirCoefficient])) >> 6;
+
+			fir[channel] = clamp16(sum) & ~1;
+		}
+	}
+
+	if( echoWrites )
+	{
+		int echoOutputLeft = clamp16(echoInputLeft + ((fir[0] * static_cast<s8>(registers[EchoFeedback])) >> 7)) & ~1;
+		int echoOutputRight = clamp16(echoInputRight + ((fir[1] * static_cast<s8>(registers[EchoFeedback])) >> 7)) & ~1;
+
+		ramData[echoAddress] = static_cast<byte>(echoOutputLeft);
+		ramData[(echoAddress + 1) & 0xFFFF] = static_cast<byte>(echoOutputLeft >> 8);
+		ramData[(echoAddress + 2) & 0xFFFF] = static_cast<byte>(echoOutputRight);
+		ramData[(echoAddress + 3) & 0xFFFF] = static_cast<byte>(echoOutputRight >> 8);
+		// Seen by RamPageTracker, the 4 bytes can cross a page
+		ram->markDirty(echoAddress);
+		ram->markDirty((echoAddress + 3) & 0xFFFF);
+	}
+
+	echoOffset += 4;
+	if( echoOffset >= echoLength )
+	{
+		echoOffset = 0;
+	}
+
+	if( StateOnly )
+	{
+		return;
+	}
+
+	int echoReturnLeft = (fir[0] * static_cast<s8>(registers[EchoVolumeLeft])) >> 7;
+	int echoReturnRight = (fir[1] * static_cast<s8>(registers[EchoVolumeRight])) >> 7;
+
+	if( WithStems )
+	{
+		if( stems.echoLeft )
+		{
+			stems.echoLeft[stemPosition] = static_cast<s16>( clamp16(echoReturnLeft) );
+		}
+		if( stems.echoRight )
+		{
+			stems.echoRight[stemPosition] = static_cast<s16>( clamp16(echoReturnRight) );
+		}
+
+		stemPosition++;
+	}
+
+	if( output )
+	{
+		int left = (mainLeft * static_cast<s8>(registers[MainVolumeLeft])) >> 7;
+		int right = (mainRight * static_cast<s8>(registers[MainVolumeRight])) >> 7;
+
+		left += echoReturnLeft;
+		right += echoReturnRight;
+
+		if( flags & 0x40 )
+		{
+			left = right = 0;
+		}
+
+		output[0] = static_cast<s16>( clamp16(left) );
+		output[1] = static_cast<s16>( clamp16(right) );
+	}
+}
+
+Dsp::Dsp(Ram *ram)
+ : d(new Private)
+{
+	d->ram = ram;
+	d->ramData = ram->data();
+}
+
+Dsp::~Dsp()
+{
+	delete d;
+}
+
+void Dsp::reset()
+{
+	d->reset();
+	d->mutedVoices = 0;
+}
+
+void Dsp::loadRegisters(const std::vector<byte> &registers)
+{
+	loadRegisters(registers.empty() ? 0 : &registers[0], registers.size());
+}
+
+void Dsp::loadRegisters(const byte *registers, size_t count)
+{
+	byte mutedVoices = d->mutedVoices;
+
+	d->reset();
+	d->mutedVoices = mutedVoices;
+
+	for(size_t i = 0; i < count && i < RegisterCount; i++)
+	{
+		d->registers[i] = registers[i];
+	}
+
+	// KON only takes effect when written
+	d->registers[KeyOn] = 0;
+
+	memcpy(d->writtenRegisters, d->registers, sizeof(d->registers));
+}
+
+byte Dsp::readRegister(byte address) const
+{
+	return d->registers[address & 0x7F];
+}
+
+void Dsp::writeRegister(byte address, byte value)
+{
+	if( address >= RegisterCount )
+	{
+		return;
+	}
+
+	d->writtenRegisters[address] = value;
+	d->writeRegister(address, value);
+}
+
+byte Dsp::readRegisterAt(int sampleTime, byte address)
+{
+	address &= 0x7F;
+
+	if( Private::isVolatileRegister(address) )
+	{
+		renderUntil(sampleTime);
+		return d->registers[address];
+	}
+
+	return d->writtenRegisters[address];
+}
+
+void Dsp::Private::render(s16 *buffer, int sampleCount, bool exactLastSample)
+{
+	if( stateOnly )
+	{
+		if( exactLastSample && sampleCount > 0 )
+		{
+			sampleCount--;
+		}
+		else
+		{
+			exactLastSample = false;
+		}
+
+		for(int i = 0; i < sampleCount; i++, blockPosition++)
+		{
+			runSample<false, true>(0);
+		}
+
+		// The voice outputs skipped above are only seen through OUTX,
+		// read after the last sample. Generating it in full keeps
+		// the state exact whenever it can be observed.
+		if( exactLastSample )
+		{
+			runSample<false, false>(0);
+			blockPosition++;
+		}
+	}
+	else if( hasStems )
+	{
+		for(int i = 0; i < sampleCount; i++, blockPosition++)
+		{
+			runSample<true, false>(buffer);
+
+			if( buffer )
+			{
+				buffer += 2;
+			}
+		}
+	}
+	else
+	{
+		for(int i = 0; i < sampleCount; i++, blockPosition++)
+		{
+			runSample<false, false>(buffer);
+
+			if( buffer )
+			{
+				buffer += 2;
+			}
+		}
+	}
+}
+
+void Dsp::render(s16 *buffer, int sampleCount)
+{
+	d->render(buffer, sampleCount, true);
+}
+
+int Dsp::gaussianWeight(int index)
+{
+	return GaussianTable[index & 0x1FF];
+}
+
+byte Dsp::activeVoices() const
+{
+	return d->activeVoices;
+}
+
+byte Dsp::mutedVoices() const
+{
+	return d->mutedVoices;
+}
+
+void Dsp::beginBlock(s16 *buffer, int sampleCount)
+{
+	d->inBlock = true;
+	d->blockBuffer = buffer;
+	d->blockSize = sampleCount;
+	d->blockPosition = 0;
+}
+
+void Dsp::queueRegisterWrite(int sampleTime, byte address, byte value)
+{
+	if( !d->inBlock )
+	{
+		writeRegister(address, value);
+		return;
+	}
+
+	if( address >= RegisterCount )
+	{
+		return;
+	}
+
+	d->writtenRegisters[address] = value;
+
+	if( d->queueTail == MaxQueuedWrites )
+	{
+		// Catch up, the times are in order so it empties the queue
+		renderUntil(sampleTime);
+	}
+
+	QueuedWrite &write = d->writeQueue[d->queueTail++];
+	write.sampleTime = sampleTime;
+	write.address = address;
+	write.value = value;
+}
+
+void Dsp::renderUntil(int sampleTime)
+{
+	if( !d->inBlock )
+	{
+		return;
+	}
+
+	if( sampleTime > d->blockSize )
+	{
+		sampleTime = d->blockSize;
+	}
+
+	for(;;)
+	{
+		// Apply the writes that happened before the current sample
+		while( d->queueHead < d->queueTail && d->writeQueue[d->queueHead].sampleTime <= d->blockPosition )
+		{
+			const QueuedWrite &write = d->writeQueue[d->queueHead++];
+			d->writeRegister(write.address, write.value);
+		}
+
+		if( d->blockPosition >= sampleTime )
+		{
+			break;
+		}
+
+		// Render up to the next write
+		int nextPosition = sampleTime;
+		if( d->queueHead < d->queueTail && d->writeQueue[d->queueHead].sampleTime < nextPosition )
+		{
+			nextPosition = d->writeQueue[d->queueHead].sampleTime;
+		}
+
+		// Only the samples right before a read can be observed
+		s16 *buffer = d->blockBuffer ? d->blockBuffer + d->blockPosition * 2 : 0;
+		d->render(buffer, nextPosition - d->blockPosition, nextPosition == sampleTime);
+	}
+
+	if( d->queueHead == d->queueTail )
+	{
+		d->queueHead = d->queueTail = 0;
+	}
+
+	// Journaled writes are in time order
+	if( d->journalCount && d->ramJournal[d->journalCount - 1].sampleTime <= d->blockPosition )
+	{
+		d->clearRamJournal();
+	}
+}
+
+void Dsp::endBlock()
+{
+	renderUntil(d->blockSize);
+
+	// Writes can't be later than the block, but don't lose them
+	while( d->queueHead < d->queueTail )
+	{
+		const QueuedWrite &write = d->writeQueue[d->queueHead++];
+		d->writeRegister(write.address, write.value);
+	}
+	d->queueHead = d->queueTail = 0;
+	d->clearRamJournal();
+
+	d->inBlock = false;
+	d->blockBuffer = 0;
+}
+
+void Dsp::prepareRamRead(int sampleTime, uint16 address)
+{
+	if( !d->inBlock || d->blockPosition >= sampleTime )
+	{
+		return;
+	}
+
+	// Echo writes the DSP has not done yet, unless they are
+	// disabled now and in the written value.
+	bool echoWrites = !(d->registers[Flags] & 0x20) || !(d->writtenRegisters[Flags] & 0x20);
+	if( echoWrites && d->isInEchoBuffer(address) )
+	{
+		renderUntil(sampleTime);
+	}
+}
+
+void Dsp::prepareRamWrite(int sampleTime, uint16 address)
+{
+	if( !d->inBlock || d->blockPosition >= sampleTime )
+	{
+		return;
+	}
+
+	// The echo buffer is written by both, keep the order of the writes
+	if( d->isInEchoBuffer(address) )
+	{
+		renderUntil(sampleTime);
+		return;
+	}
+
+	if( d->journalCount == MaxJournaledRamWrites )
+	{
+		renderUntil(sampleTime);
+		return;
+	}
+
+	JournaledRamWrite &write = d->ramJournal[d->journalCount++];
+	write.sampleTime = sampleTime;
+	write.address = address;
+	write.previousValue = d->ramData[address];
+	d->journalPages[address >> 13] |= 1u << ((address >> 8) & 31);
+}
+
+void Dsp::setStateOnly(bool stateOnly)
+{
+	d->stateOnly = stateOnly;
+}
+
+bool Dsp::isStateOnly() const
+{
+	return d->stateOnly;
+}
+
+void Dsp::saveState(DspState &state) const
+{
+	state = *d;
+}
+
+void Dsp::restoreState(const DspState &state)
+{
+	static_cast<DspState&>(*d) = state;
+}
+
+void Dsp::setStemBuffers(const StemBuffers *buffers)
+{
+	if( buffers )
+	{
+		d->stems = *buffers;
+		d->hasStems = true;
+	}
+	else
+	{
+		d->stems = StemBuffers();
+		d->hasStems = false;
+	}
+
+	d->stemPosition = 0;
+}
+
+void Dsp::setMutedVoices(byte mask)
+{
+	d->mutedVoices = mask;
+}
+
+}
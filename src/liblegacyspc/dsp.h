@@ -0,0 +1,350 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_DSP_H
+#define LEGACYSPC_DSP_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <vector>
+
+namespace LegacySPC
+{
+
+class Ram;
+struct DspState;
+
+/**
+ * @brief Separate output buffers for the voices and the echo return
+ *
+ * Each non-null buffer receives one sample for each generated DSP
+ * sample. A voice buffer receives the voice output after its envelope
+ * and before its volume, a voice that is inactive or muted outputs 0.
+ * The echo buffers receive the echo return, after the echo volume.
+ */
+struct StemBuffers
+{
+	StemBuffers()
+	 : echoLeft(0), echoRight(0)
+	{
+		for(int i = 0; i < 8; i++)
+		{
+			voices[i] = 0;
+		}
+	}
+
+	/**
+	 * @brief Mono output of each voice
+	 */
+	s16 *voices[8];
+	/**
+	 * @brief Left echo return
+	 */
+	s16 *echoLeft;
+	/**
+	 * @brief Right echo return
+	 */
+	s16 *echoRight;
+};
+
+/**
+ * @brief Sony S-DSP emulator
+ *
+ * Generate the 32 kHz stereo output of the eight voices, including
+ * BRR decoding, gaussian interpolation, envelopes, noise, pitch modulation
+ * and echo. The DSP is emulated at the sample level, the internal
+ * ordering of the real chip within a sample is not emulated.
+ *
+ * The DSP keeps a mask of the voices that can produce sound. A voice
+ * becomes active when it is keyed on and becomes inactive when its
+ * release envelope reaches zero or when its sample ends without looping.
+ * Inactive voices are skipped entirely: no BRR decoding, interpolation
+ * or mixing is done for them.
+ *
+ * Muted voices keep running: they are keyed on, their envelope, BRR
+ * position, ENVX and ENDX are updated as usual, so muting does not change
+ * how the song runs. Only their interpolation and mixing are skipped,
+ * unless their output modulates the pitch of the next voice. Once
+ * unmuted, a voice is heard again right away.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT Dsp
+{
+public:
+	/**
+	 * @brief Registers of each voice, add voice * 0x10 to get the address
+	 */
+	enum VoiceRegisters
+	{
+		VolumeLeft = 0x00,
+		VolumeRight = 0x01,
+		PitchLow = 0x02,
+		PitchHigh = 0x03,
+		SourceNumber = 0x04,
+		Adsr1 = 0x05,
+		Adsr2 = 0x06,
+		Gain = 0x07,
+		EnvelopeX = 0x08,
+		OutputX = 0x09
+	};
+
+	/**
+	 * @brief Global registers
+	 */
+	enum GlobalRegisters
+	{
+		MainVolumeLeft = 0x0C,
+		MainVolumeRight = 0x1C,
+		EchoVolumeLeft = 0x2C,
+		EchoVolumeRight = 0x3C,
+		KeyOn = 0x4C,
+		KeyOff = 0x5C,
+		Flags = 0x6C,
+		EndX = 0x7C,
+		EchoFeedback = 0x0D,
+		PitchModulation = 0x2D,
+		NoiseEnable = 0x3D,
+		EchoEnable = 0x4D,
+		SourceDirectory = 0x5D,
+		EchoStart = 0x6D,
+		EchoDelay = 0x7D,
+		FirCoefficient = 0x0F ///< Add coefficient * 0x10
+	};
+
+	enum
+	{
+		VoiceCount = 8,
+		RegisterCount = 128,
+		SampleRate = 32000,
+		CyclesPerSample = 32, ///< CPU cycles for each DSP sample
+		MaxQueuedWrites = 2048,
+		MaxJournaledRamWrites = 2048
+	};
+
+	/**
+	 * @brief Create a new instance of Dsp
+	 * @param ram RAM used for samples and the echo buffer
+	 */
+	Dsp(Ram *ram);
+	/**
+	 * @brief Destructor
+	 */
+	~Dsp();
+
+	/**
+	 * @brief Stop all voices and clear the registers
+	 */
+	void reset();
+
+	/**
+	 * @brief Load all the registers, like from a SPC file
+	 *
+	 * All the voices are stopped, they will sound
+	 * on their next key on.
+	 * @param registers byte vector containing the 128 DSP registers
+	 */
+	void loadRegisters(const std::vector<byte> &registers);
+
+	/**
+	 * @brief Load the registers from a buffer, like a mapped SPC file
+	 * @param registers Register values from address 0
+	 * @param count Number of registers, at most RegisterCount are loaded
+	 */
+	void loadRegisters(const byte *registers, size_t count);
+
+	/**
+	 * @brief Read a DSP register
+	 * @param address Register address, 0x80-0xFF mirror 0x00-0x7F
+	 * @return Register value
+	 */
+	byte readRegister(byte address) const;
+
+	/**
+	 * @brief Write a DSP register
+	 * @param address Register address, writes to 0x80-0xFF are ignored
+	 * @param value Value to write
+	 */
+	void writeRegister(byte address, byte value);
+
+	/**
+	 * @brief Read a DSP register at a given time of the current block
+	 *
+	 * Only the registers updated by the DSP itself, ENVX, OUTX and
+	 * ENDX, make the DSP catch up to that time. The other registers
+	 * are read from the last written values, the DSP can stay behind.
+	 * @param sampleTime Sample of the block the read happens before
+	 * @param address Register address, 0x80-0xFF mirror 0x00-0x7F
+	 * @return Register value at that time
+	 */
+	byte readRegisterAt(int sampleTime, byte address);
+
+	/**
+	 * @brief Generate stereo samples
+	 * @param buffer Interleaved left/right output, can be null
+	 * to run the DSP without keeping the output.
+	 * @param sampleCount Number of stereo samples to generate
+	 */
+	void render(s16 *buffer, int sampleCount);
+
+	/**
+	 * @brief Start rendering a block of samples
+	 *
+	 * Inside a block, register writes are queued with their time
+	 * by queueRegisterWrite() and applied when the DSP reaches that
+	 * time, so long runs of samples can be rendered at once. The output
+	 * is the same as rendering sample by sample with the registers
+	 * written between the samples.
+	 *
+	 * The DSP only catches up when it has to: for reads done with
+	 * readRegisterAt() of registers it updates, for CPU accesses to the
+	 * echo buffer, when the write queue or the RAM journal is full,
+	 * and at the end of the block.
+	 * @param buffer Interleaved left/right output for the block, can be null
+	 * @param sampleCount Number of stereo samples in the block
+	 */
+	void beginBlock(s16 *buffer, int sampleCount);
+
+	/**
+	 * @brief Write a register at a given time of the current block
+	 *
+	 * Outside of a block, the register is written right away.
+	 * @param sampleTime Sample of the block before which the write takes effect
+	 * @param address Register address
+	 * @param value Value to write
+	 */
+	void queueRegisterWrite(int sampleTime, byte address, byte value);
+
+	/**
+	 * @brief Render the current block up to the given time
+	 *
+	 * The writes queued up to that time are applied, registers
+	 * read afterward have their value for that time.
+	 * @param sampleTime Sample of the block to render up to, excluded
+	 */
+	void renderUntil(int sampleTime);
+
+	/**
+	 * @brief Render the rest of the current block
+	 */
+	void endBlock();
+
+	/**
+	 * @brief Prepare a CPU read of RAM at a given time of the current block
+	 *
+	 * The DSP writes the echo buffer in RAM, it catches up before
+	 * the CPU reads it.
+	 * @param sampleTime Sample of the block the read happens before
+	 * @param address RAM address read by the CPU
+	 */
+	void prepareRamRead(int sampleTime, uint16 address);
+
+	/**
+	 * @brief Prepare a CPU write to RAM at a given time of the current block
+	 *
+	 * The DSP catches up before writes to the echo buffer. For other
+	 * addresses, the previous value is kept in a journal so the DSP,
+	 * lagging behind, reads it until it reaches the time of the write.
+	 * Call before the RAM is written.
+	 * @param sampleTime Sample of the block the write happens before
+	 * @param address RAM address written by the CPU
+	 */
+	void prepareRamWrite(int sampleTime, uint16 address);
+
+	/**
+	 * @brief Get an entry of the gaussian interpolation table
+	 *
+	 * The table is the one of the hardware, the interpolation
+	 * uses entries 255 - offset, 511 - offset, 256 + offset and
+	 * offset for the four samples at a position.
+	 * @param index Entry, from 0 to 511
+	 * @return Weight of the entry, out of 2048
+	 */
+	static int gaussianWeight(int index);
+
+	/**
+	 * @brief Get the voices that currently produce sound
+	 * @return Bit mask, bit 0 for voice 0
+	 */
+	byte activeVoices() const;
+
+	/**
+	 * @brief Get the muted voices
+	 * @return Bit mask, bit 0 for voice 0
+	 */
+	byte mutedVoices() const;
+
+	/**
+	 * @brief Set the muted voices
+	 * @param mask Bit mask, bit 0 for voice 0
+	 */
+	void setMutedVoices(byte mask);
+
+	/**
+	 * @brief Set the buffers receiving the separate voices output
+	 *
+	 * The buffers are filled from their start by the following calls
+	 * to render(), they must be large enough for all the samples
+	 * generated until the buffers are changed or removed. When no
+	 * buffers are set, the separate output costs nothing.
+	 * @param buffers Stem buffers, copied. Use null to disable the separate output.
+	 */
+	void setStemBuffers(const StemBuffers *buffers);
+
+	/**
+	 * @brief Only update the state of the DSP, without generating sound
+	 *
+	 * Envelopes, BRR decoding, the noise generator and the echo
+	 * buffer writes run as usual, but the voices are neither
+	 * interpolated nor mixed unless their output feeds the echo
+	 * buffer or the pitch modulation of the next voice. The state
+	 * reached is the same as a full render, the output buffers and
+	 * the stem buffers are not written.
+	 * @param stateOnly true to skip the sound generation
+	 */
+	void setStateOnly(bool stateOnly);
+
+	/**
+	 * @brief Check if the DSP only updates its state
+	 * @return true if the sound generation is skipped
+	 */
+	bool isStateOnly() const;
+
+	/**
+	 * @brief Save the internal state of the DSP
+	 *
+	 * Call outside of a block. The muted voices and the stem
+	 * buffers are settings, they are not part of the state.
+	 * @param state Receives the state
+	 */
+	void saveState(DspState &state) const;
+
+	/**
+	 * @brief Restore a state saved by saveState()
+	 *
+	 * Call outside of a block. The muted voices are kept.
+	 * @param state State to restore
+	 */
+	void restoreState(const DspState &state);
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
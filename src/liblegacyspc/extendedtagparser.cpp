@@ -0,0 +1,208 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "extendedtagparser.h"
+
+// STL includes
+#include <cstring>
+#include <string>
+
+// LegacySPC includes
+#include "spcfile.h"
+
+namespace LegacySPC
+{
+
+static const char ExtendedTagMagic[] = "xid6";
+// Magic string and chunk size
+static const size_t ChunkHeaderSize = 8;
+static const size_t ItemHeaderSize = 4;
+
+static unsigned int read32(const byte *data)
+{
+	return data[0] | data[1] << 8 | data[2] << 16 | static_cast<unsigned int>(data[3]) << 24;
+}
+
+// Strings include their terminating null, but don't trust it
+static std::string readString(const ExtendedTagParser::Item &item)
+{
+	if( !item.data )
+	{
+		return std::string();
+	}
+
+	const char *text = reinterpret_cast<const char*>(item.data);
+	const void *end = memchr(text, 0, item.size);
+
+	return std::string( text, end ? static_cast<const char*>(end) - text : item.size );
+}
+
+class ExtendedTagParser::Private
+{
+public:
+	Private()
+	 : data(0), position(0), end(0), valid(false)
+	{}
+
+	const byte *data;
+	size_t position;
+	// End of the chunk, within the buffer
+	size_t end;
+	bool valid;
+};
+
+ExtendedTagParser::ExtendedTagParser(const byte *data, size_t size)
+ : d(new Private)
+{
+	d->data = data;
+
+	if( size >= ChunkHeaderSize && memcmp(data, ExtendedTagMagic, 4) == 0 )
+	{
+		d->valid = true;
+		d->position = ChunkHeaderSize;
+
+		size_t chunkSize = read32(data + 4);
+		d->end = size - ChunkHeaderSize < chunkSize ? size : ChunkHeaderSize + chunkSize;
+	}
+}
+
+ExtendedTagParser::~ExtendedTagParser()
+{
+	delete d;
+}
+
+bool ExtendedTagParser::isValid() const
+{
+	return d->valid;
+}
+
+bool ExtendedTagParser::readItem(Item &item)
+{
+	if( d->position + ItemHeaderSize > d->end )
+	{
+		return false;
+	}
+
+	const byte *header = d->data + d->position;
+	item.id = header[0];
+	item.type = header[1];
+	int length = header[2] | header[3] << 8;
+
+	if( item.type == Data )
+	{
+		item.data = 0;
+		item.size = 0;
+		item.value = length;
+		d->position += ItemHeaderSize;
+		return true;
+	}
+
+	// Data is padded to 4 bytes
+	size_t paddedLength = (length + 3) & ~3;
+	if( d->position + ItemHeaderSize + length > d->end )
+	{
+		d->position = d->end;
+		return false;
+	}
+
+	item.data = header + ItemHeaderSize;
+	item.size = length;
+	item.value = item.type == Integer && length >= 4 ? static_cast<int>( read32(item.data) ) : 0;
+
+	d->position += ItemHeaderSize + paddedLength;
+	return true;
+}
+
+bool ExtendedTagParser::parse(const byte *data, size_t size, ExtendedID666Tag &tag)
+{
+	ExtendedTagParser parser(data, size);
+	if( !parser.isValid() )
+	{
+		return false;
+	}
+
+	tag.isPresent = true;
+
+	Item item;
+	while( parser.readItem(item) )
+	{
+		switch( item.id )
+		{
+			case SongTitle:
+				tag.songTitle = readString(item);
+				break;
+			case GameTitle:
+				tag.gameTitle = readString(item);
+				break;
+			case ArtistName:
+				tag.artistName = readString(item);
+				break;
+			case DumperName:
+				tag.dumperName = readString(item);
+				break;
+			case Comment:
+				tag.comment = readString(item);
+				break;
+			case OstTitle:
+				tag.ostTitle = readString(item);
+				break;
+			case PublisherName:
+				tag.publisherName = readString(item);
+				break;
+			case DateDumped:
+				tag.dateDumped = item.value;
+				break;
+			case Emulator:
+				tag.emulatorIndex = item.value;
+				break;
+			case OstDisc:
+				tag.ostDisc = item.value;
+				break;
+			case OstTrack:
+				tag.ostTrack = item.value;
+				break;
+			case CopyrightYear:
+				tag.copyrightYear = item.value;
+				break;
+			case IntroLength:
+				tag.introLength = item.value;
+				break;
+			case LoopLength:
+				tag.loopLength = item.value;
+				break;
+			case EndLength:
+				tag.endLength = item.value;
+				break;
+			case FadeLength:
+				tag.fadeLength = item.value;
+				break;
+			case MutedVoices:
+				tag.mutedVoices = static_cast<byte>(item.value);
+				break;
+			case LoopCount:
+				tag.loopCount = item.value;
+				break;
+			case MixingLevel:
+				tag.mixingLevel = item.value;
+				break;
+			default:
+				// Unknown items are skipped
+				break;
+		}
+	}
+
+	return true;
+}
+
+}
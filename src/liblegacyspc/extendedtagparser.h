@@ -0,0 +1,153 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_EXTENDEDTAGPARSER_H
+#define LEGACYSPC_EXTENDEDTAGPARSER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+
+namespace LegacySPC
+{
+
+struct ExtendedID666Tag;
+
+/**
+ * @brief Parse the extended ID666 (xid6) chunk of a SPC file
+ *
+ * The chunk starts with "xid6" and its size, followed by items. Each
+ * item has a 4 bytes header: id, type and a 16-bit length. Items of
+ * type Data hold their value in the length field, the others are
+ * followed by length bytes of data, padded to 4 bytes.
+ *
+ * The items are read one at a time from the buffer with readItem(),
+ * nothing is copied. parse() fills an ExtendedID666Tag from the
+ * known items. A truncated item ends the parsing, the items before
+ * it are kept.
+ *
+ * @code
+LegacySPC::ExtendedTagParser parser(data, size);
+LegacySPC::ExtendedTagParser::Item item;
+while( parser.readItem(item) )
+{
+	// Use item.id, item.value, item.data
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT ExtendedTagParser
+{
+public:
+	/**
+	 * @brief Item types
+	 */
+	enum ItemType
+	{
+		Data = 0, ///< Value in the length field
+		String = 1, ///< Null terminated string
+		Integer = 4 ///< 32-bit little-endian integer
+	};
+
+	/**
+	 * @brief Known item ids
+	 */
+	enum ItemId
+	{
+		SongTitle = 0x01,
+		GameTitle = 0x02,
+		ArtistName = 0x03,
+		DumperName = 0x04,
+		DateDumped = 0x05,
+		Emulator = 0x06,
+		Comment = 0x07,
+		OstTitle = 0x10,
+		OstDisc = 0x11,
+		OstTrack = 0x12,
+		PublisherName = 0x13,
+		CopyrightYear = 0x14,
+		IntroLength = 0x30,
+		LoopLength = 0x31,
+		EndLength = 0x32,
+		FadeLength = 0x33,
+		MutedVoices = 0x34,
+		LoopCount = 0x35,
+		MixingLevel = 0x36
+	};
+
+	/**
+	 * @brief An item of the chunk
+	 */
+	struct Item
+	{
+		byte id;
+		byte type;
+		/**
+		 * @brief Data following the header, null for Data items
+		 */
+		const byte *data;
+		/**
+		 * @brief Size of data in bytes
+		 */
+		size_t size;
+		/**
+		 * @brief Value of Data and Integer items
+		 */
+		int value;
+	};
+
+	/**
+	 * @brief Create a parser over a xid6 chunk
+	 * @param data Start of the chunk, the "xid6" magic string
+	 * @param size Bytes available from data
+	 */
+	ExtendedTagParser(const byte *data, size_t size);
+	/**
+	 * @brief Destructor
+	 */
+	~ExtendedTagParser();
+
+	/**
+	 * @brief Check if the buffer starts with a xid6 chunk
+	 * @return true if the magic string is present
+	 */
+	bool isValid() const;
+
+	/**
+	 * @brief Read the next item
+	 * @param item Receives the item, its data points into the buffer
+	 * @return false at the end of the chunk or on a truncated item
+	 */
+	bool readItem(Item &item);
+
+	/**
+	 * @brief Parse a whole xid6 chunk
+	 * @param data Start of the chunk, the "xid6" magic string
+	 * @param size Bytes available from data
+	 * @param tag Receives the known items
+	 * @return false if there is no xid6 chunk
+	 */
+	static bool parse(const byte *data, size_t size, ExtendedID666Tag &tag);
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "loopdetector.h"
+
+// STL includes
+#include <cstring>
+#include <vector>
+
+// LegacySPC includes
+#include "ram.h"
+#include "rampagetracker.h"
+
+namespace LegacySPC
+{
+
+typedef unsigned long long StateHash;
+
+static const StateHash HashMultiplier = 0x9E3779B97F4A7C15ULL;
+static const size_t InitialTableSize = 4096;
+
+static StateHash mix(StateHash hash)
+{
+	hash ^= hash >> 32;
+	hash *= HashMultiplier;
+	hash ^= hash >> 29;
+	return hash;
+}
+
+// Multiply-xorshift over 8 bytes at a time
+static StateHash hashBytes(const byte *data, size_t size, StateHash seed)
+{
+	StateHash hash = seed ^ (size * HashMultiplier);
+
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		StateHash value;
+		memcpy(&value, data + i, sizeof(value));
+		hash = (hash ^ value) * HashMultiplier;
+		hash ^= hash >> 32;
+	}
+	for(; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * HashMultiplier;
+		hash ^= hash >> 32;
+	}
+
+	return mix(hash);
+}
+
+/**
+ * @brief Open addressing table entry, a hash of 0 is a free slot
+ */
+struct SeenState
+{
+	StateHash hash;
+	long long time;
+};
+
+class LoopDetector::Private
+{
+public:
+	Private()
+	 : ram(0), tracker(0), ramHash(0), stateCount(0), loopStart(-1), loopLength(0)
+	{
+		memset(pageHashes, 0, sizeof(pageHashes));
+	}
+
+	StateHash hashPage(int page) const
+	{
+		return hashBytes(ram->data() + page * Ram::PageSize, Ram::PageSize, page);
+	}
+
+	void updatePages();
+	void grow();
+	// Find the entry of a hash, or the free slot where it goes
+	SeenState &find(StateHash hash);
+
+	Ram *ram;
+	// Leaves out the echo buffer
+	RamPageTracker *tracker;
+	StateHash pageHashes[Ram::PageCount];
+	// XOR of all the page hashes
+	StateHash ramHash;
+
+	std::vector<SeenState> table;
+	size_t stateCount;
+
+	long long loopStart;
+	long long loopLength;
+};
+
+void LoopDetector::Private::updatePages()
+{
+	const uint32 *dirtyPages = tracker->dirtyPages();
+	for(int i = 0; i < Ram::PageCount / 32; i++)
+	{
+		uint32 bits = dirtyPages[i];
+		while( bits )
+		{
+			int bit = 0;
+			while( !(bits & (1u << bit)) )
+			{
+				bit++;
+			}
+			bits &= ~(1u << bit);
+
+			int page = i * 32 + bit;
+			StateHash hash = hashPage(page);
+			ramHash ^= pageHashes[page] ^ hash;
+			pageHashes[page] = hash;
+		}
+	}
+	tracker->clearDirtyPages();
+}
+
+void LoopDetector::Private::grow()
+{
+	std::vector<SeenState> oldTable;
+	oldTable.swap(table);
+
+	SeenState empty = { 0, 0 };
+	table.assign(oldTable.empty() ? InitialTableSize : oldTable.size() * 2, empty);
+
+	for(size_t i = 0; i < oldTable.size(); i++)
+	{
+		if( oldTable[i].hash )
+		{
+			find(oldTable[i].hash) = oldTable[i];
+		}
+	}
+}
+
+SeenState &LoopDetector::Private::find(StateHash hash)
+{
+	size_t mask = table.size() - 1;
+	size_t slot = static_cast<size_t>(hash) & mask;
+	while( table[slot].hash && table[slot].hash != hash )
+	{
+		slot = (slot + 1) & mask;
+	}
+
+	return table[slot];
+}
+
+LoopDetector::LoopDetector()
+ : d(new Private)
+{
+}
+
+LoopDetector::~LoopDetector()
+{
+	delete d->tracker;
+	delete d;
+}
+
+void LoopDetector::reset(Ram *ram)
+{
+	d->ram = ram;
+	delete d->tracker;
+	d->tracker = new RamPageTracker(ram, false);
+
+	d->ramHash = 0;
+	for(int page = 0; page < Ram::PageCount; page++)
+	{
+		d->pageHashes[page] = d->hashPage(page);
+		d->ramHash ^= d->pageHashes[page];
+	}
+	d->tracker->clearDirtyPages();
+
+	d->table.clear();
+	d->stateCount = 0;
+	d->grow();
+
+	d->loopStart = -1;
+	d->loopLength = 0;
+}
+
+bool LoopDetector::addState(long long time, const byte *state, size_t size)
+{
+	d->updatePages();
+
+	StateHash hash = hashBytes(state, size, d->ramHash);
+	// 0 marks the free slots
+	if( !hash )
+	{
+		hash = 1;
+	}
+
+	SeenState &entry = d->find(hash);
+	if( entry.hash )
+	{
+		d->loopStart = entry.time;
+		d->loopLength = time - entry.time;
+		return true;
+	}
+
+	entry.hash = hash;
+	entry.time = time;
+	d->stateCount++;
+
+	// Keep the table at most half full
+	if( d->stateCount * 2 > d->table.size() )
+	{
+		d->grow();
+	}
+
+	return false;
+}
+
+long long LoopDetector::loopStart() const
+{
+	return d->loopStart;
+}
+
+long long LoopDetector::loopLength() const
+{
+	return d->loopLength;
+}
+
+size_t LoopDetector::stateCount() const
+{
+	return d->stateCount;
+}
+
+}
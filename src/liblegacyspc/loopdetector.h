@@ -0,0 +1,102 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_LOOPDETECTOR_H
+#define LEGACYSPC_LOOPDETECTOR_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+
+namespace LegacySPC
+{
+
+class Ram;
+
+/**
+ * @brief Find the first repeated emulation state
+ *
+ * The state given at each tick of the sound driver is hashed with
+ * the RAM and kept in a hash table. When a state comes back, the
+ * song loops from the time that state was first seen.
+ *
+ * The hash of each RAM page is kept, only the pages reported by a
+ * RamPageTracker are hashed again, so a tick costs what the driver
+ * wrote since the last one. The echo buffer, written by the DSP
+ * through Ram::data(), keeps the hash it had when last written by
+ * the CPU.
+ * States are compared by their 64-bit hash only.
+ *
+ * @see SpcRunner::findLoop()
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT LoopDetector
+{
+public:
+	/**
+	 * @brief Create a new instance of LoopDetector
+	 */
+	LoopDetector();
+	/**
+	 * @brief Destructor
+	 */
+	~LoopDetector();
+
+	/**
+	 * @brief Forget the states seen and hash the whole RAM
+	 *
+	 * @param ram RAM to follow, must stay valid until the next reset()
+	 * or the destruction of the detector
+	 */
+	void reset(Ram *ram);
+
+	/**
+	 * @brief Add the state at a tick and look for it in the previous ticks
+	 *
+	 * The pages written since the last state are hashed again.
+	 * @param time Time of the tick, in any unit growing with the song
+	 * @param state State not kept in RAM: registers, timers, ...
+	 * @param size Size of state in bytes
+	 * @return true if the same state was seen before
+	 */
+	bool addState(long long time, const byte *state, size_t size);
+
+	/**
+	 * @brief Get the time the repeated state was first seen
+	 * @return Start of the loop, -1 before addState() found one
+	 */
+	long long loopStart() const;
+
+	/**
+	 * @brief Get the time between the two identical states
+	 * @return Length of the loop, 0 before addState() found one
+	 */
+	long long loopLength() const;
+
+	/**
+	 * @brief Get the number of different states seen
+	 * @return States in the hash table
+	 */
+	size_t stateCount() const;
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
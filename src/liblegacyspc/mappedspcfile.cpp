@@ -0,0 +1,312 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "mappedspcfile.h"
+
+// STL includes
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fstream>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEGACYSPC_HAVE_MMAP
+#endif
+
+// LegacySPC includes
+#include "contenthasher.h"
+#include "extendedtagparser.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+static const char SpcMagicHeader[] = "SNES-SPC700 Sound File Data v0.30";
+
+// Offsets in the header
+enum HeaderOffsets
+{
+	ProgramCounterOffset = 0x25,
+	ARegisterOffset = 0x27,
+	XRegisterOffset = 0x28,
+	YRegisterOffset = 0x29,
+	ProgramStatusOffset = 0x2A,
+	StackPointerOffset = 0x2B,
+	ID666Offset = 0x2E
+};
+
+static std::string readString(const byte *data, int offset, int size)
+{
+	return std::string( reinterpret_cast<const char*>(data + offset), size );
+}
+
+class MappedSpcFile::Private
+{
+public:
+	Private()
+	 : data(0), size(0)
+	{}
+
+	const byte *data;
+	size_t size;
+#ifndef LEGACYSPC_HAVE_MMAP
+	std::vector<byte> buffer;
+#endif
+};
+
+MappedSpcFile::MappedSpcFile()
+ : d(new Private)
+{
+}
+
+MappedSpcFile::MappedSpcFile(const std::string &filename)
+ : d(new Private)
+{
+	open(filename);
+}
+
+MappedSpcFile::~MappedSpcFile()
+{
+	close();
+	delete d;
+}
+
+bool MappedSpcFile::open(const std::string &filename)
+{
+	close();
+
+	lDebug() << "Mapping file" << filename;
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	int descriptor = ::open(filename.c_str(), O_RDONLY);
+	if( descriptor < 0 )
+	{
+		return false;
+	}
+
+	struct stat status;
+	if( fstat(descriptor, &status) != 0 || status.st_size < DspRegistersOffset + DspRegistersSize )
+	{
+		::close(descriptor);
+		return false;
+	}
+
+	void *mapping = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// The mapping stays valid once the file is closed
+	::close(descriptor);
+	if( mapping == MAP_FAILED )
+	{
+		return false;
+	}
+
+	d->data = static_cast<const byte*>(mapping);
+	d->size = status.st_size;
+#else
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if( !file )
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	if( fileSize < DspRegistersOffset + DspRegistersSize )
+	{
+		return false;
+	}
+
+	d->buffer.resize( static_cast<size_t>(fileSize) );
+	file.seekg(0, std::ios::beg);
+	if( !file.read(reinterpret_cast<char*>(&d->buffer[0]), fileSize) )
+	{
+		d->buffer.clear();
+		return false;
+	}
+
+	d->data = &d->buffer[0];
+	d->size = d->buffer.size();
+#endif
+
+	// Do we really deal with a SPC file
+	if( !checkHeader(d->data) )
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedSpcFile::close()
+{
+	if( !d->data )
+	{
+		return;
+	}
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	munmap(const_cast<byte*>(d->data), d->size);
+#else
+	std::vector<byte>().swap(d->buffer);
+#endif
+
+	d->data = 0;
+	d->size = 0;
+}
+
+bool MappedSpcFile::isOpen() const
+{
+	return d->data != 0;
+}
+
+const byte *MappedSpcFile::data() const
+{
+	return d->data;
+}
+
+size_t MappedSpcFile::size() const
+{
+	return d->size;
+}
+
+ProcessorRegisters MappedSpcFile::processorRegisters() const
+{
+	return decodeProcessorRegisters(d->data);
+}
+
+const byte *MappedSpcFile::ramData() const
+{
+	return d->data + RamOffset;
+}
+
+const byte *MappedSpcFile::dspRegisters() const
+{
+	return d->data + DspRegistersOffset;
+}
+
+const byte *MappedSpcFile::extraRam() const
+{
+	if( d->size < ExtraRamOffset + ExtraRamSize )
+	{
+		return 0;
+	}
+
+	return d->data + ExtraRamOffset;
+}
+
+const byte *MappedSpcFile::id666Data() const
+{
+	return d->data + ID666Offset;
+}
+
+ID666Tag MappedSpcFile::id666Tag() const
+{
+	return decodeID666Tag(d->data);
+}
+
+ExtendedID666Tag MappedSpcFile::extendedTag() const
+{
+	ExtendedID666Tag tag;
+	if( d->size > ExtendedTagOffset )
+	{
+		ExtendedTagParser::parse(d->data + ExtendedTagOffset, d->size - ExtendedTagOffset, tag);
+	}
+
+	return tag;
+}
+
+unsigned long long MappedSpcFile::contentHash() const
+{
+	ContentHasher hasher;
+	// PC, A, X, Y, PSW and SP
+	hasher.add(d->data + ProgramCounterOffset, StackPointerOffset + 1 - ProgramCounterOffset);
+	hasher.add(ramData(), RamSize);
+	hasher.add(dspRegisters(), DspRegistersSize);
+	if( extraRam() )
+	{
+		hasher.add(extraRam(), ExtraRamSize);
+	}
+
+	return hasher.result();
+}
+
+bool MappedSpcFile::checkHeader(const byte *header)
+{
+	return memcmp(header, SpcMagicHeader, sizeof(SpcMagicHeader) - 1) == 0;
+}
+
+ProcessorRegisters MappedSpcFile::decodeProcessorRegisters(const byte *header)
+{
+	ProcessorRegisters registers;
+
+	registers.setProgramCounter( header[ProgramCounterOffset] | header[ProgramCounterOffset + 1] << 8 );
+	registers.setA( header[ARegisterOffset] );
+	registers.setX( header[XRegisterOffset] );
+	registers.setY( header[YRegisterOffset] );
+	registers.setProgramStatus( header[ProgramStatusOffset] );
+	registers.setStackPointer( header[StackPointerOffset] );
+
+	return registers;
+}
+
+ID666Tag MappedSpcFile::decodeID666Tag(const byte *header)
+{
+	ID666Tag tag;
+
+	tag.songTitle = readString(header, 0x2E, 32);
+	tag.gameTitle = readString(header, 0x4E, 32);
+	tag.dumperName = readString(header, 0x6E, 16);
+	tag.comment = readString(header, 0x7E, 32);
+	tag.dateDumped = readString(header, 0x9E, 11);
+
+	int extraOffset;
+	// Here we test if the first char is a digit or 0
+	// else, we are in binary mode
+	if( isdigit(header[0xA9]) || header[0xA9] == 0x00 )
+	{
+		tag.songLength = atoi( readString(header, 0xA9, 3).c_str() );
+		tag.fadeoutLength = atoi( readString(header, 0xAC, 5).c_str() );
+		extraOffset = 0xB1;
+	}
+	else
+	{
+		tag.isBinary = true;
+
+		std::stringstream dateStringStream;
+		dateStringStream << (header[0xA0] | header[0xA1] << 8) << "/" << (int)header[0x9F] << "/" << (int)header[0x9E];
+		tag.dateDumped = dateStringStream.str();
+
+		tag.songLength = header[0xA9] | header[0xAA] << 8;
+		tag.fadeoutLength = header[0xAC] | header[0xAD] << 8 | header[0xAE] << 16 | header[0xAF] << 24;
+		extraOffset = 0xB0;
+	}
+
+	tag.artistName = readString(header, extraOffset, 32);
+	tag.isDefaultChannelDisabled = header[extraOffset + 32] != 0;
+
+	// A digit in text tags, a number in binary tags
+	byte emulator = header[extraOffset + 33];
+	tag.emulatorIndex = isdigit(emulator) ? emulator - '0' : emulator;
+
+	return tag;
+}
+
+}
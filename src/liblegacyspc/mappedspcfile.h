@@ -0,0 +1,201 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_MAPPEDSPCFILE_H
+#define LEGACYSPC_MAPPEDSPCFILE_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+#include <processorregisters.h>
+#include <spcfile.h>
+
+// STL includes
+#include <cstddef>
+#include <string>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief SPC file mapped in memory
+ *
+ * The file is mapped read-only and its header is checked when
+ * opened. The RAM, the DSP registers, the extra RAM and the ID666
+ * tag are pointers into the mapping, nothing is copied until the
+ * caller copies it, like SpcFileMemoryLoader does straight into
+ * the emulator RAM.
+ *
+ * On systems without mmap(), the file is read in one go instead.
+ *
+ * @code
+LegacySPC::MappedSpcFile file("spcfile.spc");
+if( file.isOpen() )
+{
+	std::cout << file.id666Tag().songTitle << std::endl;
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT MappedSpcFile
+{
+public:
+	/**
+	 * @brief Layout of a SPC file
+	 */
+	enum Layout
+	{
+		HeaderSize = 0x100,
+		RamOffset = 0x100,
+		RamSize = 0x10000,
+		DspRegistersOffset = 0x10100,
+		DspRegistersSize = 128,
+		ExtraRamOffset = 0x101C0,
+		ExtraRamSize = 64,
+		ExtendedTagOffset = 0x10200
+	};
+
+	/**
+	 * @brief Create a new instance of MappedSpcFile
+	 *
+	 * To map a file, use open().
+	 */
+	MappedSpcFile();
+	/**
+	 * @brief Create a MappedSpcFile and map the file
+	 * @param filename SPC file to map
+	 */
+	MappedSpcFile(const std::string &filename);
+	/**
+	 * @brief Destructor, unmap the file
+	 */
+	~MappedSpcFile();
+
+	/**
+	 * @brief Map a SPC file
+	 *
+	 * The previous file is unmapped first.
+	 * @param filename SPC file to map
+	 * @return false if the file can't be read or is not a SPC file
+	 */
+	bool open(const std::string &filename);
+
+	/**
+	 * @brief Unmap the file, the pointers become invalid
+	 */
+	void close();
+
+	/**
+	 * @brief Check if a SPC file is mapped
+	 * @return true if open() succeeded
+	 */
+	bool isOpen() const;
+
+	/**
+	 * @brief Get the whole file
+	 * @return Start of the mapping, null when no file is mapped
+	 */
+	const byte *data() const;
+
+	/**
+	 * @brief Get the size of the file
+	 * @return Size in bytes
+	 */
+	size_t size() const;
+
+	/**
+	 * @brief Get the CPU registers
+	 * @return Registers stored in the header
+	 */
+	ProcessorRegisters processorRegisters() const;
+
+	/**
+	 * @brief Get the 64 KiB of RAM
+	 * @return RamSize bytes of the mapping
+	 */
+	const byte *ramData() const;
+
+	/**
+	 * @brief Get the DSP registers
+	 * @return DspRegistersSize bytes of the mapping
+	 */
+	const byte *dspRegisters() const;
+
+	/**
+	 * @brief Get the extra RAM, the IPL ROM area when it is hidden
+	 * @return ExtraRamSize bytes of the mapping, null if the file is too short
+	 */
+	const byte *extraRam() const;
+
+	/**
+	 * @brief Get the raw ID666 tag
+	 * @return Tag fields of the header, from offset 0x2E
+	 */
+	const byte *id666Data() const;
+
+	/**
+	 * @brief Decode the ID666 tag of the header
+	 * @return Tag, in text or binary format
+	 */
+	ID666Tag id666Tag() const;
+
+	/**
+	 * @brief Parse the extended ID666 tag following the SPC data
+	 * @return Extended tag, isPresent is false when the file has none
+	 */
+	ExtendedID666Tag extendedTag() const;
+
+	/**
+	 * @brief Hash the emulation state of the file
+	 *
+	 * Only the CPU registers, the RAM, the DSP registers and the
+	 * extra RAM are hashed, files differing only by their tags have
+	 * the same hash.
+	 * @return Hash of the state, see ContentHasher
+	 */
+	unsigned long long contentHash() const;
+
+	/**
+	 * @brief Check the magic string of a SPC header
+	 * @param header First HeaderSize bytes of a SPC file
+	 * @return true if it is the header of a SPC file
+	 */
+	static bool checkHeader(const byte *header);
+
+	/**
+	 * @brief Decode the CPU registers of a SPC header
+	 * @param header First HeaderSize bytes of a SPC file
+	 * @return Registers stored in the header
+	 */
+	static ProcessorRegisters decodeProcessorRegisters(const byte *header);
+
+	/**
+	 * @brief Decode the ID666 tag of a SPC header
+	 * @param header First HeaderSize bytes of a SPC file
+	 * @return Tag, in text or binary format
+	 */
+	static ID666Tag decodeID666Tag(const byte *header);
+
+private:
+	// Not copyable, the mapping has a single owner
+	MappedSpcFile(const MappedSpcFile &);
+	MappedSpcFile &operator=(const MappedSpcFile &);
+
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
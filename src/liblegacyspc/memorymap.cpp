@@ -17,21 +17,148 @@
 // LegacySPC includes
 #include "spccomponentmanager.h"
 #include "ram.h"
+#include "dsp.h"
+#include "processor.h"
+#include "spcstate.h"
 #include "legacyspc_debug.h"
 
 namespace LegacySPC
 {
 
+enum IORegisters
+{
+	ControlRegister = 0xF1,
+	DspAddressRegister = 0xF2,
+	DspDataRegister = 0xF3,
+	Port0Register = 0xF4,
+	Port3Register = 0xF7,
+	Timer0TargetRegister = 0xFA,
+	Timer2TargetRegister = 0xFC,
+	Counter0Register = 0xFD,
+	Counter2Register = 0xFF
+};
+
+static const int TimerCount = 3;
+static const int PortCount = 4;
+
+// CPU cycles for each tick of the timers, 8 kHz for timers 0
+// and 1, 64 kHz for timer 2.
+static const int TimerPeriods[TimerCount] = { 128, 128, 16 };
+
+/**
+ * @brief SPC700 timer, updated lazily from the CPU cycles
+ */
+struct Timer : public TimerState
+{
+	Timer()
+	{
+		enabled = false;
+		target = 0;
+		counter = 0;
+		reserved = 0;
+		divider = 0;
+		elapsed = 0;
+	}
+
+	void run(int cycles, int period)
+	{
+		elapsed += cycles;
+		int ticks = elapsed / period;
+		elapsed %= period;
+
+		if( !enabled || ticks == 0 )
+		{
+			return;
+		}
+
+		// A target of 0 counts 256 ticks
+		int realTarget = target ? target : 256;
+		divider += ticks;
+		counter = (counter + divider / realTarget) & 0x0F;
+		divider %= realTarget;
+	}
+};
+
 class MemoryMap::Private
 {
 public:
 	Private()
-	 : componentManager(0)
-	{}
-	
+	 : componentManager(0), timerCycles(0), tickReads(0)
+	{
+		for(int i = 0; i < PortCount; i++)
+		{
+			inputPorts[i] = 0;
+		}
+	}
+
+	int cycles() const
+	{
+		return componentManager->processor()->cycles();
+	}
+
+	/**
+	 * @brief Get the DSP sample matching the current CPU time
+	 */
+	int dspSampleTime() const
+	{
+		return componentManager->processor()->cycles() / Dsp::CyclesPerSample;
+	}
+
+	/**
+	 * @brief Bring the timers up to the given CPU time
+	 */
+	void updateTimers(int now)
+	{
+		int elapsed = now - timerCycles;
+		if( elapsed <= 0 )
+		{
+			return;
+		}
+
+		for(int i = 0; i < TimerCount; i++)
+		{
+			timers[i].run(elapsed, TimerPeriods[i]);
+		}
+		timerCycles = now;
+	}
+
+	void writeControl(byte value);
+
 	SpcComponentManager *componentManager;
+	Timer timers[TimerCount];
+	// CPU time the timers are up to
+	int timerCycles;
+	// Values written by the main CPU, read from $F4-$F7
+	byte inputPorts[PortCount];
+	unsigned int tickReads;
 };
 
+void MemoryMap::Private::writeControl(byte value)
+{
+	for(int i = 0; i < TimerCount; i++)
+	{
+		bool enabled = value & (1 << i);
+		// Enabling a timer restarts it
+		if( enabled && !timers[i].enabled )
+		{
+			timers[i].divider = 0;
+			timers[i].counter = 0;
+		}
+		timers[i].enabled = enabled;
+	}
+
+	if( value & 0x10 )
+	{
+		inputPorts[0] = 0;
+		inputPorts[1] = 0;
+	}
+	if( value & 0x20 )
+	{
+		inputPorts[2] = 0;
+		inputPorts[3] = 0;
+	}
+}
+
 MemoryMap::MemoryMap(SpcComponentManager *manager)
  : d(new Private)
 {
@@ -46,8 +173,39 @@ MemoryMap::~MemoryMap()
 byte MemoryMap::readByte(word address) const
 {
 	// FIXME: Finish
+	uint16 ioAddress = static_cast<uint16>(address);
+	if( ioAddress == DspDataRegister )
+	{
+		// The DSP only catches up for the registers it updates itself
+		byte dspAddress = d->componentManager->ram()->readByte(DspAddressRegister);
+		return d->componentManager->dsp()->readRegisterAt( d->dspSampleTime(), dspAddress );
+	}
+	else if( ioAddress >= Port0Register && ioAddress <= Port3Register )
+	{
+		return d->inputPorts[ioAddress - Port0Register];
+	}
+	else if( ioAddress >= Counter0Register && ioAddress <= Counter2Register )
+	{
+		d->updateTimers( d->cycles() );
+
+		Timer &timer = d->timers[ioAddress - Counter0Register];
+		byte counter = timer.counter;
+		timer.counter = 0;
+		if( counter )
+		{
+			d->tickReads++;
+		}
+		return counter;
+	}
+	else if( ioAddress == ControlRegister || (ioAddress >= Timer0TargetRegister && ioAddress <= Timer2TargetRegister) )
+	{
+		// Write only
+		return 0;
+	}
+
 	if( address <= 0xFFFF )
 	{
+		d->componentManager->dsp()->prepareRamRead( d->dspSampleTime(), ioAddress );
 		return d->componentManager->ram()->readByte(address);
 	}
 
@@ -67,7 +225,85 @@ word MemoryMap::readWord(word address) const
 void MemoryMap::writeByte(word address, byte value)
 {
 	// TODO: Finish
+	d->componentManager->dsp()->prepareRamWrite( d->dspSampleTime(), static_cast<uint16>(address) );
 	d->componentManager->ram()->writeByte( address, value);
+
+	if( static_cast<uint16>(address) == DspDataRegister )
+	{
+		// Applied by the DSP when it reaches the current time
+		byte dspAddress = d->componentManager->ram()->readByte(DspAddressRegister);
+		d->componentManager->dsp()->queueRegisterWrite( d->dspSampleTime(), dspAddress, value );
+	}
+	else if( static_cast<uint16>(address) == ControlRegister )
+	{
+		d->updateTimers( d->cycles() );
+		d->writeControl(value);
+	}
+	else if( static_cast<uint16>(address) >= Timer0TargetRegister && static_cast<uint16>(address) <= Timer2TargetRegister )
+	{
+		d->updateTimers( d->cycles() );
+		d->timers[static_cast<uint16>(address) - Timer0TargetRegister].target = value;
+	}
+}
+
+void MemoryMap::loadIoRegisters()
+{
+	Ram *ram = d->componentManager->ram();
+
+	byte control = ram->readByte(ControlRegister);
+	for(int i = 0; i < TimerCount; i++)
+	{
+		Timer &timer = d->timers[i];
+		timer.enabled = control & (1 << i);
+		timer.target = ram->readByte(Timer0TargetRegister + i);
+		timer.counter = ram->readByte(Counter0Register + i) & 0x0F;
+		timer.divider = 0;
+		timer.elapsed = 0;
+	}
+
+	for(int i = 0; i < PortCount; i++)
+	{
+		d->inputPorts[i] = ram->readByte(Port0Register + i);
+	}
+
+	d->timerCycles = d->cycles();
+}
+
+void MemoryMap::rebaseCycles(int cycles)
+{
+	d->updateTimers(cycles);
+	d->timerCycles -= cycles;
+}
+
+void MemoryMap::saveIoState(IoState &state) const
+{
+	for(int i = 0; i < TimerCount; i++)
+	{
+		state.timers[i] = d->timers[i];
+	}
+	state.timerCycles = d->timerCycles;
+	for(int i = 0; i < PortCount; i++)
+	{
+		state.inputPorts[i] = d->inputPorts[i];
+	}
+}
+
+void MemoryMap::restoreIoState(const IoState &state)
+{
+	for(int i = 0; i < TimerCount; i++)
+	{
+		static_cast<TimerState&>(d->timers[i]) = state.timers[i];
+	}
+	d->timerCycles = state.timerCycles;
+	for(int i = 0; i < PortCount; i++)
+	{
+		d->inputPorts[i] = state.inputPorts[i];
+	}
+}
+
+unsigned int MemoryMap::tickReads() const
+{
+	return d->tickReads;
 }
 
 void MemoryMap::writeWord(word address, word value)
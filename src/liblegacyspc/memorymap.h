@@ -25,6 +25,7 @@ namespace LegacySPC
 {
 
 class SpcComponentManager;
+struct IoState;
 
 /**
  * @brief MemoryMap is the frontend for all the
@@ -76,6 +77,48 @@ public:
 	 */
 	void writeBytes(word address, const std::vector<byte> &bytes);
 
+	/**
+	 * @brief Set the timers and the input ports from the RAM content
+	 *
+	 * Use after loading the RAM from a SPC file, which contains
+	 * the control register, the timer targets and counters and
+	 * the last values written by the main CPU to the ports.
+	 */
+	void loadIoRegisters();
+
+	/**
+	 * @brief Bring the timers up to the given CPU time and
+	 * move their time base back by the same amount
+	 *
+	 * Use when the processor cycle counter is moved back.
+	 * @param cycles CPU cycles removed from the processor counter
+	 */
+	void rebaseCycles(int cycles);
+
+	/**
+	 * @brief Save the timers and the input ports
+	 *
+	 * The other I/O registers are kept in RAM.
+	 * @param state Receives the state
+	 */
+	void saveIoState(IoState &state) const;
+
+	/**
+	 * @brief Restore the timers and the input ports saved by saveIoState()
+	 * @param state State to restore
+	 */
+	void restoreIoState(const IoState &state);
+
+	/**
+	 * @brief Get the number of timer counter reads that returned ticks
+	 *
+	 * Sound drivers poll a counter and run their sequencer once
+	 * for each read that is not 0, the count changes at each tick
+	 * of the driver.
+	 * @return Reads of a counter that was not 0, wraps around
+	 */
+	unsigned int tickReads() const;
+
 private:
 	class Private;
 	Private *d;
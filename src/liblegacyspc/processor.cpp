@@ -19,6 +19,7 @@
 #include "cpuopcodes.h"
 #include "spcrunner.h"
 #include "memorymap.h"
+#include "tracerecorder.h"
 #include "legacyspc_debug.h"
 
 namespace LegacySPC
@@ -35,11 +36,39 @@ struct MemBitData
 	byte bit;
 };
 
+/**
+ * @internal
+ * @brief Number of cycles taken by each opcode
+ *
+ * Conditional branches take 2 more cycles when the branch is taken.
+ */
+static const byte CycleTable[256] =
+{
+//	0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 4, 6, 8, // 0
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 6, 5, 2, 2, 4, 6, // 1
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 4, 5, 4, // 2
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 6, 5, 2, 2, 3, 8, // 3
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 4, 6, 6, // 4
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 4, 5, 2, 2, 4, 3, // 5
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 4, 5, 5, // 6
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2, 3, 6, // 7
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 6, 5, 4, 5, 2, 4, 5, // 8
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2,12, 5, // 9
+	3, 8, 4, 5, 3, 4, 3, 6, 2, 6, 4, 4, 5, 2, 4, 4, // A
+	2, 8, 4, 5, 4, 5, 5, 6, 5, 5, 5, 5, 2, 2, 3, 4, // B
+	3, 8, 4, 5, 4, 5, 4, 7, 2, 5, 6, 4, 5, 2, 4, 9, // C
+	2, 8, 4, 5, 5, 6, 6, 7, 4, 5, 5, 5, 2, 2, 6, 3, // D
+	2, 8, 4, 5, 3, 4, 3, 6, 2, 4, 5, 3, 4, 3, 4, 3, // E
+	2, 8, 4, 5, 4, 5, 5, 6, 3, 4, 5, 4, 2, 2, 4, 3  // F
+};
+
 class Processor::Private
 {
 public:
 	Private()
-	 : runner(0), regs(0), lastAddress(0)
+	 : runner(0), regs(0), lastAddress(0), cycles(0), halted(false),
+	   traceRecorder(0), traceRecord(0)
 	{
 		regs = new ProcessorRegisters;
 	}
@@ -52,8 +81,27 @@ public:
 	SpcRunner *runner;
 	ProcessorRegisters *regs;
 	word lastAddress;
+	// Advanced once the opcode is done, so it holds
+	// the start time of the opcode being processed
+	int cycles;
+	bool halted;
+
+	TraceRecorder *traceRecorder;
+	// Record of the instruction being processed, null when not recording
+	TraceRecord *traceRecord;
 };
 
+// Writes are kept over reads, the opcode and operands are not counted
+static inline void traceAccess(TraceRecord *record, TraceAccess type, word address, byte value)
+{
+	if( type == WriteAccess || record->accessType != WriteAccess )
+	{
+		record->accessType = type;
+		record->accessAddress = address;
+		record->accessValue = value;
+	}
+}
+
 Processor::Processor(SpcRunner *runner)
   : d(new Private)
 {
@@ -70,11 +118,57 @@ word Processor::lastAddress() const
 	return d->lastAddress;
 }
 
+int Processor::cycles() const
+{
+	return d->cycles;
+}
+
+void Processor::setCycles(int cycles)
+{
+	d->cycles = cycles;
+}
+
+bool Processor::isHalted() const
+{
+	return d->halted;
+}
+
+void Processor::setHalted(bool halted)
+{
+	d->halted = halted;
+}
+
+void Processor::setTraceRecorder(TraceRecorder *recorder)
+{
+	d->traceRecorder = recorder;
+}
+
+TraceRecorder *Processor::traceRecorder() const
+{
+	return d->traceRecorder;
+}
+
 void Processor::processOpcode()
 {
-	byte opcode = readByte();
+	if( d->traceRecorder )
+	{
+		ProcessorRegisters *regs = registers();
+		TraceRecord &record = d->traceRecorder->append();
+		record.cycle = d->traceRecorder->cycleBase() + d->cycles;
+		record.programCounter = regs->programCounter();
+		record.accessAddress = 0;
+		record.a = regs->A();
+		record.x = regs->X();
+		record.y = regs->Y();
+		record.stackPointer = regs->stackPointer();
+		record.programStatus = regs->programStatus();
+		record.accessValue = 0;
+		record.accessType = NoAccess;
+		record.reserved = 0;
+		d->traceRecord = &record;
+	}
 
-	lDebug() << "PC:" << registers()->programCounter() << "Opcode:" << opcode;
+	byte opcode = readByte();
 
 	switch(opcode)
 	{
@@ -1162,7 +1256,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isProgramStatusFlagSet(ZeroFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1171,7 +1265,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isProgramStatusFlagSet(ZeroFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1180,7 +1274,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isProgramStatusFlagSet(CarryFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1189,7 +1283,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isProgramStatusFlagSet(CarryFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1198,7 +1292,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isProgramStatusFlagSet(OverflowFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1207,7 +1301,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isProgramStatusFlagSet(OverflowFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1216,7 +1310,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isProgramStatusFlagSet(NegativeFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1225,7 +1319,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isProgramStatusFlagSet(NegativeFlag) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1235,7 +1329,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(0, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1245,7 +1339,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(1, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1255,7 +1349,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(2, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1265,7 +1359,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(3, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1275,7 +1369,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(4, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1285,7 +1379,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(5, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1295,7 +1389,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(6, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1305,7 +1399,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( !isBitSet(7, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1315,7 +1409,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(0, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1325,7 +1419,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(1, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1335,7 +1429,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(2, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1345,7 +1439,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(3, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1355,7 +1449,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(4, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1365,7 +1459,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(5, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1375,7 +1469,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(6, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1385,7 +1479,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( isBitSet(7, value) )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1395,7 +1489,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( registers()->A() != dpValue )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1405,7 +1499,7 @@ void Processor::processOpcode()
 			word newPc = decodeAddress(RelativeAddressing);
 			if( registers()->A() != dpValue )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1420,7 +1514,7 @@ void Processor::processOpcode()
 			
 			if( dpValue != 0 )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1431,7 +1525,7 @@ void Processor::processOpcode()
 			
 			if( registers()->Y() != 0 )
 			{
-				registers()->setProgramCounter( newPc );
+				takeBranch( newPc );
 			}
 			break;
 		}
@@ -1868,15 +1962,33 @@ void Processor::processOpcode()
 		case Nop:
 			break;
 		case Sleep:
-			// TODO:
-			break;
 		case Stop:
-			// TODO:
+		{
+			// Only a reset wakes the SPC700 up, keep executing the same opcode
+			word programCounter = registers()->programCounter();
+			registers()->setProgramCounter( --programCounter );
+			d->halted = true;
 			break;
+		}
 		default:
 			lLog() << "Unknow opcode" << opcode << "caught at" << registers()->programCounter()-1;
 			break;
 	}
+
+	d->cycles += CycleTable[opcode];
+
+	if( d->traceRecord )
+	{
+		d->traceRecord->opcode = opcode;
+		d->traceRecord = 0;
+		d->traceRecorder->commit();
+	}
+}
+
+void Processor::takeBranch(word address)
+{
+	registers()->setProgramCounter( address );
+	d->cycles += 2;
 }
 
 SpcRunner *Processor::runner() const
@@ -1901,7 +2013,13 @@ byte Processor::readByte(word address) const
 {
 	d->lastAddress = address;
 	
-	return runner()->memory()->readByte( address );
+	byte value = runner()->memory()->readByte( address );
+	if( d->traceRecord )
+	{
+		traceAccess(d->traceRecord, ReadAccess, address, value);
+	}
+
+	return value;
 }
 
 word Processor::readWord()
@@ -1919,7 +2037,13 @@ word Processor::readWord(word address) const
 {
 	d->lastAddress = address;
 	
-	return runner()->memory()->readWord( address );
+	word value = runner()->memory()->readWord( address );
+	if( d->traceRecord )
+	{
+		traceAccess(d->traceRecord, ReadAccess, address, value.lowByte());
+	}
+
+	return value;
 }
 
 void Processor::writeByte(word address, byte value)
@@ -1927,6 +2051,10 @@ void Processor::writeByte(word address, byte value)
 	d->lastAddress = address;
 	
 	runner()->memory()->writeByte(address, value);
+	if( d->traceRecord )
+	{
+		traceAccess(d->traceRecord, WriteAccess, address, value);
+	}
 }
 
 void Processor::writeWord(word address, word value)
@@ -1934,6 +2062,10 @@ void Processor::writeWord(word address, word value)
 	d->lastAddress = address;
 	
 	runner()->memory()->writeWord(address, value);
+	if( d->traceRecord )
+	{
+		traceAccess(d->traceRecord, WriteAccess, address, value.lowByte());
+	}
 }
 
 word Processor::directPageAddress(byte dpIndex) const
@@ -2186,8 +2318,6 @@ word Processor::decodeAddress(Processor::AddressingMode mode)
 			break;
 	}
 
-	lDebug() << "Result address:" << address;
-
 	return address;
 }
 
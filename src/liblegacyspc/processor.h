@@ -23,6 +23,7 @@ namespace LegacySPC
 {
 
 class SpcRunner;
+class TraceRecorder;
 struct MemBitData;
 
 /**
@@ -66,6 +67,55 @@ public:
 	 * @return last address
 	 */
 	word lastAddress() const;
+
+	/**
+	 * @brief Get the number of elapsed CPU cycles
+	 *
+	 * The counter is advanced when an opcode is done. While an
+	 * opcode is processed, it holds the time the opcode started.
+	 * @return Elapsed cycles since the counter was last set
+	 */
+	int cycles() const;
+
+	/**
+	 * @brief Set the CPU cycles counter
+	 *
+	 * Used by the emulation loop to rebase the counter.
+	 * @param cycles New counter value
+	 */
+	void setCycles(int cycles);
+
+	/**
+	 * @brief Check if the processor executed SLEEP or STOP
+	 *
+	 * A halted processor keeps executing the halting opcode,
+	 * the time still goes on.
+	 * @return true if the processor is halted
+	 */
+	bool isHalted() const;
+
+	/**
+	 * @brief Set the halted flag
+	 *
+	 * Used when loading a new state.
+	 * @param halted true if the processor is halted
+	 */
+	void setHalted(bool halted);
+
+	/**
+	 * @brief Record each instruction executed
+	 *
+	 * The recorder gets the cycles of the block from SpcRunner.
+	 * @param recorder Recorder, not owned, null to stop recording
+	 * @see SpcRunner::setTraceRecorder()
+	 */
+	void setTraceRecorder(TraceRecorder *recorder);
+
+	/**
+	 * @brief Get the recorder of the instructions
+	 * @return Recorder, null when not recording
+	 */
+	TraceRecorder *traceRecorder() const;
 	
 private:
 	enum AddressingMode
@@ -132,6 +182,14 @@ private:
 	 */
 	word readWord(word address) const;
 
+	/**
+	 * @internal
+	 * @brief Jump to the address of a taken conditional branch
+	 * and count the extra cycles
+	 * @param address Branch target address
+	 */
+	void takeBranch(word address);
+
 	/**
 	 * @internal
 	 * @brief Calcuate the address for a direct page access
@@ -15,6 +15,11 @@
 #include "ram.h"
 
 #include <legacyspc_debug.h>
+#include "rampagetracker.h"
+
+// STL includes
+#include <algorithm>
+#include <cstring>
 
 namespace LegacySPC
 {
@@ -25,12 +30,20 @@ public:
 	// TODO: Remplace with array with something better
 	// like a custom ByteArray class
 	std::vector<byte> ramData;
+	// One bit for each page written
+	uint32 dirtyPages[Ram::PageCount / 32];
+	// Pages written through data()
+	uint32 externalPages[Ram::PageCount / 32];
+	std::vector<RamPageTracker*> trackers;
 };
 
+static const int RamSize = Ram::Size;
+
 Ram::Ram()
  : d(new Private)
 {
-	d->ramData.reserve(0xFFFF);
+	d->ramData.resize(RamSize);
+	clearDirtyPages();
 }
 
 Ram::~Ram()
@@ -40,7 +53,14 @@ Ram::~Ram()
 
 void Ram::loadRam(const std::vector<byte> &data)
 {
-	d->ramData = data;
+	loadRam(data.empty() ? 0 : &data[0], data.size());
+}
+
+void Ram::loadRam(const byte *data, size_t size)
+{
+	// Keep the same storage, data() pointers must stay valid
+	std::copy( data, data + std::min<size_t>(size, RamSize), d->ramData.begin() );
+	memset(d->dirtyPages, 0xFF, sizeof(d->dirtyPages));
 }
 
 byte Ram::readByte(word address)
@@ -58,7 +78,45 @@ byte Ram::readByte(word address)
 
 void Ram::writeByte(word address, byte value)
 {
-	d->ramData[static_cast<uint16>(address)] = value;
+	uint16 ramAddress = static_cast<uint16>(address);
+	d->ramData[ramAddress] = value;
+	d->dirtyPages[ramAddress >> 13] |= 1u << ((ramAddress >> 8) & 31);
+}
+
+byte *Ram::data()
+{
+	return &d->ramData[0];
+}
+
+const uint32 *Ram::dirtyPages() const
+{
+	return d->dirtyPages;
+}
+
+void Ram::clearDirtyPages()
+{
+	for(size_t i = 0; i < d->trackers.size(); i++)
+	{
+		d->trackers[i]->addPages(d->dirtyPages, d->externalPages);
+	}
+
+	memset(d->dirtyPages, 0, sizeof(d->dirtyPages));
+	memset(d->externalPages, 0, sizeof(d->externalPages));
+}
+
+void Ram::markDirty(uint16 address)
+{
+	d->externalPages[address >> 13] |= 1u << ((address >> 8) & 31);
+}
+
+void Ram::addTracker(RamPageTracker *tracker)
+{
+	d->trackers.push_back(tracker);
+}
+
+void Ram::removeTracker(RamPageTracker *tracker)
+{
+	d->trackers.erase( std::remove(d->trackers.begin(), d->trackers.end(), tracker), d->trackers.end() );
 }
 
 }
@@ -24,6 +24,8 @@
 namespace LegacySPC
 {
 
+class RamPageTracker;
+
 /**
  * @brief Manage SPC700 RAM
  *
@@ -37,6 +39,13 @@ namespace LegacySPC
 class LEGACYSPC_EXPORT Ram
 {
 public:
+	enum
+	{
+		Size = 0x10000,
+		PageSize = 0x100,
+		PageCount = Size / PageSize
+	};
+
 	/**
 	 * @brief Constructor
 	 */
@@ -48,6 +57,13 @@ public:
 
 	void loadRam(const std::vector<byte> &data);
 
+	/**
+	 * @brief Load the RAM from a buffer, like a mapped SPC file
+	 * @param data Bytes to load from address 0
+	 * @param size Number of bytes, at most Size are loaded
+	 */
+	void loadRam(const byte *data, size_t size);
+
 	/**
 	 * @brief Read a byte from RAM
 	 * @param address Address to read from.
@@ -62,7 +78,48 @@ public:
 	 */
 	void writeByte(word address, byte value);
 
+	/**
+	 * @brief Get direct access to the RAM
+	 *
+	 * Used by components doing a lot of accesses, like the DSP.
+	 * The pointer stays valid for the lifetime of the Ram.
+	 * @return Pointer to the 64 KiB of RAM
+	 */
+	byte *data();
+
+	/**
+	 * @brief Get the pages written since the last clearDirtyPages()
+	 *
+	 * writeByte() and loadRam() mark the pages they write. Writes
+	 * done through data() are not tracked here, see markDirty().
+	 * Reading the pages of a RamPageTracker clears them too, use
+	 * a RamPageTracker for each consumer instead.
+	 * @return 256 bits in 8 words, bit 0 of the first word for page 0
+	 */
+	const uint32 *dirtyPages() const;
+
+	/**
+	 * @brief Mark all the pages as unchanged
+	 *
+	 * The pages are given to the RamPageTracker of this Ram first,
+	 * they are not lost for them.
+	 */
+	void clearDirtyPages();
+
+	/**
+	 * @brief Mark the page of a write done through data()
+	 *
+	 * Used by the DSP for the echo buffer. These pages are only
+	 * reported to the RamPageTracker following them.
+	 * @param address Address written
+	 */
+	void markDirty(uint16 address);
+
 private:
+	friend class RamPageTracker;
+	void addTracker(RamPageTracker *tracker);
+	void removeTracker(RamPageTracker *tracker);
+
 	class Private;
 	Private *d;
 };
@@ -0,0 +1,70 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "rampagetracker.h"
+
+// STL includes
+#include <cstring>
+
+namespace LegacySPC
+{
+
+RamPageTracker::RamPageTracker(Ram *ram, bool withExternalWrites)
+ : m_ram(ram), m_withExternalWrites(withExternalWrites)
+{
+	markAllDirty();
+	m_ram->addTracker(this);
+}
+
+RamPageTracker::~RamPageTracker()
+{
+	m_ram->removeTracker(this);
+}
+
+const uint32 *RamPageTracker::dirtyPages()
+{
+	// Hands the new pages to every tracker
+	m_ram->clearDirtyPages();
+	return m_pages;
+}
+
+bool RamPageTracker::isPageDirty(int page)
+{
+	return dirtyPages()[page >> 5] & (1u << (page & 31));
+}
+
+void RamPageTracker::clearDirtyPages()
+{
+	m_ram->clearDirtyPages();
+	memset(m_pages, 0, sizeof(m_pages));
+}
+
+void RamPageTracker::markAllDirty()
+{
+	memset(m_pages, 0xFF, sizeof(m_pages));
+}
+
+void RamPageTracker::addPages(const uint32 *pages, const uint32 *externalPages)
+{
+	for(int i = 0; i < Ram::PageCount / 32; i++)
+	{
+		m_pages[i] |= pages[i];
+		if( m_withExternalWrites )
+		{
+			m_pages[i] |= externalPages[i];
+		}
+	}
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_RAMPAGETRACKER_H
+#define LEGACYSPC_RAMPAGETRACKER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// LegacySPC includes
+#include "ram.h"
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Follow the RAM pages written, for one consumer
+ *
+ * Ram only sets a bit when a page is written. Each tracker keeps
+ * its own copy of the bits, gathered from the Ram when it reads
+ * them, so the loop detection, snapshots and a debugger view can
+ * each clear the pages they handled without hiding them from the
+ * others.
+ *
+ * Pages written through Ram::data() and reported by Ram::markDirty(),
+ * like the echo buffer written by the DSP, can be left out.
+ *
+ * @code
+LegacySPC::RamPageTracker tracker(ram);
+...
+const LegacySPC::uint32 *pages = tracker.dirtyPages();
+for(int page = 0; page < LegacySPC::Ram::PageCount; page++)
+{
+	if( pages[page >> 5] & (1u << (page & 31)) )
+	{
+		...
+	}
+}
+tracker.clearDirtyPages();
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT RamPageTracker
+{
+public:
+	/**
+	 * @brief Start following the pages of a RAM
+	 *
+	 * All the pages start as written.
+	 * @param ram RAM to follow, must outlive the tracker
+	 * @param withExternalWrites true to include the pages given to Ram::markDirty()
+	 */
+	explicit RamPageTracker(Ram *ram, bool withExternalWrites = true);
+	/**
+	 * @brief Stop following the RAM
+	 */
+	~RamPageTracker();
+
+	/**
+	 * @brief Get the pages written since the last clearDirtyPages()
+	 * @return 256 bits in 8 words, bit 0 of the first word for page 0
+	 */
+	const uint32 *dirtyPages();
+
+	/**
+	 * @brief Check if a page was written since the last clearDirtyPages()
+	 * @param page Page number, address / Ram::PageSize
+	 * @return true if the page was written
+	 */
+	bool isPageDirty(int page);
+
+	/**
+	 * @brief Mark all the pages as unchanged for this tracker
+	 */
+	void clearDirtyPages();
+
+	/**
+	 * @brief Mark all the pages as written for this tracker
+	 */
+	void markAllDirty();
+
+private:
+	friend class Ram;
+	void addPages(const uint32 *pages, const uint32 *externalPages);
+
+	Ram *m_ram;
+	bool m_withExternalWrites;
+	uint32 m_pages[Ram::PageCount / 32];
+};
+
+}
+
+#endif
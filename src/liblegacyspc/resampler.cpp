@@ -0,0 +1,490 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "resampler.h"
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEGACYSPC_RESAMPLER_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEGACYSPC_RESAMPLER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace LegacySPC
+{
+
+// Ratios that don't reduce to a small number of phases use the
+// nearest of this many phases.
+static const int MaxPhases = 1024;
+
+static const double Pi = 3.14159265358979323846;
+
+// Apply one phase of the filter to both channels
+typedef void (*FilterFunction)(const float *filter, const float *left, const float *right, int taps, float *output);
+
+/*
+ * The kernels give the same output bit for bit, whatever the host
+ * runs. Each sums the taps in 8 lanes, tap i in lane i % 8, with a
+ * multiply and an add rounded separately, never fused. The lanes are
+ * then added in a fixed order. Taps are always a multiple of 8.
+ */
+static inline float sumLanes(const float *lanes)
+{
+	return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+static void filterScalar(const float *filter, const float *left, const float *right, int taps, float *output)
+{
+	float sumLeft[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	float sumRight[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for(int i = 0; i < taps; i += 8)
+	{
+		for(int lane = 0; lane < 8; lane++)
+		{
+			sumLeft[lane] += filter[i + lane] * left[i + lane];
+			sumRight[lane] += filter[i + lane] * right[i + lane];
+		}
+	}
+
+	output[0] = sumLanes(sumLeft);
+	output[1] = sumLanes(sumRight);
+}
+
+#ifdef LEGACYSPC_RESAMPLER_SSE2
+// Lanes 0-3 hold the sums of lanes 0 and 4, 1 and 5, ... of sumLanes()
+static inline float horizontalSum(__m128 value)
+{
+	__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(value, shuffled);
+	shuffled = _mm_movehl_ps(shuffled, sums);
+	sums = _mm_add_ss(sums, shuffled);
+
+	return _mm_cvtss_f32(sums);
+}
+
+static void filterSse2(const float *filter, const float *left, const float *right, int taps, float *output)
+{
+	__m128 sumLeftLow = _mm_setzero_ps();
+	__m128 sumLeftHigh = _mm_setzero_ps();
+	__m128 sumRightLow = _mm_setzero_ps();
+	__m128 sumRightHigh = _mm_setzero_ps();
+	for(int i = 0; i < taps; i += 8)
+	{
+		__m128 low = _mm_loadu_ps(filter + i);
+		__m128 high = _mm_loadu_ps(filter + i + 4);
+		sumLeftLow = _mm_add_ps(sumLeftLow, _mm_mul_ps(low, _mm_loadu_ps(left + i)));
+		sumLeftHigh = _mm_add_ps(sumLeftHigh, _mm_mul_ps(high, _mm_loadu_ps(left + i + 4)));
+		sumRightLow = _mm_add_ps(sumRightLow, _mm_mul_ps(low, _mm_loadu_ps(right + i)));
+		sumRightHigh = _mm_add_ps(sumRightHigh, _mm_mul_ps(high, _mm_loadu_ps(right + i + 4)));
+	}
+
+	output[0] = horizontalSum( _mm_add_ps(sumLeftLow, sumLeftHigh) );
+	output[1] = horizontalSum( _mm_add_ps(sumRightLow, sumRightHigh) );
+}
+#endif
+
+#if defined(LEGACYSPC_RESAMPLER_AVX2) && defined(LEGACYSPC_RESAMPLER_SSE2)
+// Without FMA, the multiply and the add must not be fused
+__attribute__((target("avx2")))
+static void filterAvx2(const float *filter, const float *left, const float *right, int taps, float *output)
+{
+	__m256 sumLeft = _mm256_setzero_ps();
+	__m256 sumRight = _mm256_setzero_ps();
+	for(int i = 0; i < taps; i += 8)
+	{
+		__m256 coefficients = _mm256_loadu_ps(filter + i);
+		sumLeft = _mm256_add_ps(sumLeft, _mm256_mul_ps(coefficients, _mm256_loadu_ps(left + i)));
+		sumRight = _mm256_add_ps(sumRight, _mm256_mul_ps(coefficients, _mm256_loadu_ps(right + i)));
+	}
+
+	__m128 halfLeft = _mm_add_ps(_mm256_castps256_ps128(sumLeft), _mm256_extractf128_ps(sumLeft, 1));
+	__m128 halfRight = _mm_add_ps(_mm256_castps256_ps128(sumRight), _mm256_extractf128_ps(sumRight, 1));
+
+	output[0] = horizontalSum(halfLeft);
+	output[1] = horizontalSum(halfRight);
+}
+#endif
+
+static FilterFunction filterFunctionFor(Resampler::Kernel kernel)
+{
+	switch( kernel )
+	{
+		case Resampler::AutomaticKernel:
+#if defined(LEGACYSPC_RESAMPLER_AVX2) && defined(LEGACYSPC_RESAMPLER_SSE2)
+			if( filterFunctionFor(Resampler::Avx2Kernel) )
+			{
+				return filterAvx2;
+			}
+#endif
+#ifdef LEGACYSPC_RESAMPLER_SSE2
+			return filterSse2;
+#else
+			return filterScalar;
+#endif
+		case Resampler::ScalarKernel:
+			return filterScalar;
+		case Resampler::Sse2Kernel:
+#ifdef LEGACYSPC_RESAMPLER_SSE2
+			return filterSse2;
+#else
+			return 0;
+#endif
+		case Resampler::Avx2Kernel:
+#if defined(LEGACYSPC_RESAMPLER_AVX2) && defined(LEGACYSPC_RESAMPLER_SSE2)
+			__builtin_cpu_init();
+			if( __builtin_cpu_supports("avx2") )
+			{
+				return filterAvx2;
+			}
+#endif
+			return 0;
+	}
+
+	return 0;
+}
+
+static int greatestCommonDivisor(int a, int b)
+{
+	while( b != 0 )
+	{
+		int remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+
+	return a;
+}
+
+static void store(s16 *output, float value)
+{
+	int sample = static_cast<int>( value < 0.0f ? value - 0.5f : value + 0.5f );
+	if( sample > 32767 )
+	{
+		sample = 32767;
+	}
+	else if( sample < -32768 )
+	{
+		sample = -32768;
+	}
+
+	*output = static_cast<s16>(sample);
+}
+
+static void store(float *output, float value)
+{
+	*output = value * (1.0f / 32768.0f);
+}
+
+class Resampler::Private
+{
+public:
+	Private()
+	 : inputRate(32000), outputRate(32000), quality(MediumQuality),
+	   taps(0), phaseCount(0), interpolation(1), decimation(1),
+	   position(0), fraction(0), available(0),
+	   kernel(AutomaticKernel), filterFunction(filterScalar)
+	{}
+
+	void computeFilters();
+	template<typename T>
+	void read(T *output, int frames);
+
+	int inputRate;
+	int outputRate;
+	Quality quality;
+
+	int taps;
+	int phaseCount;
+	// Output frames advance the input by decimation / interpolation frames
+	int interpolation;
+	int decimation;
+	// phaseCount + 1 filters of taps coefficients, the last one
+	// is the first phase of the next input frame
+	std::vector<float> filters;
+
+	// Pending input, one buffer per channel
+	std::vector<float> left;
+	std::vector<float> right;
+	// First input frame used by the next output frame
+	int position;
+	// Position between two input frames, in 1 / interpolation
+	int fraction;
+	// Input frames in the buffers
+	int available;
+
+	Kernel kernel;
+	FilterFunction filterFunction;
+};
+
+void Resampler::Private::computeFilters()
+{
+	static const int QualityTaps[] = { 8, 16, 32 };
+	static const double QualityRolloff[] = { 0.80, 0.88, 0.94 };
+
+	taps = QualityTaps[quality];
+	phaseCount = interpolation < MaxPhases ? interpolation : MaxPhases;
+
+	// Cut below the lowest of the two Nyquist frequencies
+	double cutoff = QualityRolloff[quality];
+	if( outputRate == inputRate )
+	{
+		// A single phase on the input frames, the filter is the identity
+		cutoff = 1.0;
+	}
+	else if( outputRate < inputRate )
+	{
+		cutoff *= static_cast<double>(outputRate) / inputRate;
+	}
+
+	filters.resize((phaseCount + 1) * taps);
+	for(int phase = 0; phase <= phaseCount; phase++)
+	{
+		float *filter = &filters[phase * taps];
+		double offset = static_cast<double>(phase) / phaseCount;
+		double sum = 0.0;
+
+		for(int i = 0; i < taps; i++)
+		{
+			// Distance from the output frame, which sits between
+			// the taps / 2 - 1 and taps / 2 input frames
+			double distance = i - (taps / 2 - 1) - offset;
+			double x = cutoff * distance;
+			double sinc = x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+
+			// Blackman window over the taps
+			double w = distance / (taps / 2);
+			double window = 0.42 + 0.5 * std::cos(Pi * w) + 0.08 * std::cos(2.0 * Pi * w);
+
+			double value = sinc * window;
+			filter[i] = static_cast<float>(value);
+			sum += value;
+		}
+
+		// Unity gain for every phase
+		for(int i = 0; i < taps; i++)
+		{
+			filter[i] = static_cast<float>(filter[i] / sum);
+		}
+	}
+}
+
+Resampler::Resampler()
+ : d(new Private)
+{
+	setRates(d->inputRate, d->outputRate, d->quality);
+}
+
+Resampler::~Resampler()
+{
+	delete d;
+}
+
+Resampler::Resampler(const Resampler &other)
+ : d(new Private(*other.d))
+{
+}
+
+Resampler &Resampler::operator=(const Resampler &other)
+{
+	*d = *other.d;
+	return *this;
+}
+
+void Resampler::setRates(int inputRate, int outputRate, Quality quality)
+{
+	if( inputRate < 1 || outputRate < 1 )
+	{
+		return;
+	}
+
+	int divisor = greatestCommonDivisor(inputRate, outputRate);
+
+	d->inputRate = inputRate;
+	d->outputRate = outputRate;
+	d->quality = quality;
+	d->interpolation = outputRate / divisor;
+	d->decimation = inputRate / divisor;
+	d->filterFunction = filterFunctionFor(d->kernel);
+	d->computeFilters();
+
+	int capacity = maxInputFrames() + 2 * d->taps;
+	d->left.assign(capacity, 0.0f);
+	d->right.assign(capacity, 0.0f);
+
+	reset();
+}
+
+int Resampler::inputRate() const
+{
+	return d->inputRate;
+}
+
+int Resampler::outputRate() const
+{
+	return d->outputRate;
+}
+
+Resampler::Quality Resampler::quality() const
+{
+	return d->quality;
+}
+
+bool Resampler::setKernel(Kernel kernel)
+{
+	FilterFunction function = filterFunctionFor(kernel);
+	if( !function )
+	{
+		return false;
+	}
+
+	d->kernel = kernel;
+	d->filterFunction = function;
+	return true;
+}
+
+Resampler::Kernel Resampler::kernel() const
+{
+	return d->kernel;
+}
+
+bool Resampler::isPassthrough() const
+{
+	return d->inputRate == d->outputRate;
+}
+
+void Resampler::reset()
+{
+	// Start with the history of silence so that the first output
+	// frame is centered on the first input frame.
+	d->available = d->taps / 2 - 1;
+	d->position = 0;
+	d->fraction = 0;
+	std::fill(d->left.begin(), d->left.begin() + d->available, 0.0f);
+	std::fill(d->right.begin(), d->right.begin() + d->available, 0.0f);
+}
+
+int Resampler::inputFramesNeeded(int outputFrames) const
+{
+	if( outputFrames < 1 )
+	{
+		return 0;
+	}
+
+	// The last output frame needs the taps from its position
+	long long advance = d->fraction + static_cast<long long>(d->decimation) * (outputFrames - 1);
+	int needed = d->position + static_cast<int>(advance / d->interpolation) + d->taps - d->available;
+
+	return needed > 0 ? needed : 0;
+}
+
+int Resampler::maxInputFrames() const
+{
+	long long advance = (d->interpolation - 1) + static_cast<long long>(d->decimation) * (MaxOutputFrames - 1);
+	// When an output frame steps over more input frames than the
+	// taps, the next position can be past the pending input.
+	int skipped = (d->decimation + d->interpolation - 1) / d->interpolation;
+
+	return static_cast<int>(advance / d->interpolation) + d->taps + skipped;
+}
+
+void Resampler::pushInput(const s16 *input, int frames)
+{
+	int space = static_cast<int>(d->left.size()) - d->available;
+	if( frames > space )
+	{
+		frames = space;
+	}
+
+	float *left = &d->left[d->available];
+	float *right = &d->right[d->available];
+	for(int i = 0; i < frames; i++)
+	{
+		left[i] = input[i * 2];
+		right[i] = input[i * 2 + 1];
+	}
+
+	d->available += frames;
+}
+
+template<typename T>
+void Resampler::Private::read(T *output, int frames)
+{
+	const float *filterBank = &filters[0];
+	const float *leftInput = &left[0];
+	const float *rightInput = &right[0];
+	int inputPosition = position;
+	int inputFraction = fraction;
+	float sample[2];
+
+	for(int i = 0; i < frames; i++)
+	{
+		if( inputPosition + taps > available )
+		{
+			// Not enough input, should not happen with inputFramesNeeded()
+			break;
+		}
+
+		if( output )
+		{
+			// Nearest phase, phaseCount is the next input frame
+			int phase = phaseCount == interpolation ? inputFraction : static_cast<int>( (static_cast<long long>(inputFraction) * phaseCount + interpolation / 2) / interpolation );
+			filterFunction(filterBank + phase * taps, leftInput + inputPosition, rightInput + inputPosition, taps, sample);
+
+			store(&output[i * 2], sample[0]);
+			store(&output[i * 2 + 1], sample[1]);
+		}
+
+		inputFraction += decimation;
+		inputPosition += inputFraction / interpolation;
+		inputFraction %= interpolation;
+	}
+
+	// Move the frames still needed to the start of the buffers
+	int remaining = available - inputPosition;
+	if( remaining > 0 )
+	{
+		std::memmove(&left[0], &left[inputPosition], remaining * sizeof(float));
+		std::memmove(&right[0], &right[inputPosition], remaining * sizeof(float));
+		available = remaining;
+		position = 0;
+	}
+	else
+	{
+		// Next frame starts past the pending input
+		available = 0;
+		position = -remaining;
+	}
+	fraction = inputFraction;
+}
+
+void Resampler::readOutput(s16 *output, int frames)
+{
+	d->read(output, frames < MaxOutputFrames ? frames : MaxOutputFrames);
+}
+
+void Resampler::readOutput(float *output, int frames)
+{
+	d->read(output, frames < MaxOutputFrames ? frames : MaxOutputFrames);
+}
+
+}
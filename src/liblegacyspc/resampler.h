@@ -0,0 +1,200 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_RESAMPLER_H
+#define LEGACYSPC_RESAMPLER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Streaming polyphase resampler for stereo samples
+ *
+ * Convert the 32 kHz output of the DSP to another sample rate.
+ * The filter bank, a windowed sinc for each phase of the rate ratio,
+ * is computed by setRates(). After that, resampling does no allocation.
+ * The filters use SSE2 or AVX2 when the processor supports it,
+ * the output is the same bit for bit with every kernel.
+ *
+ * Usage is pull based: ask inputFramesNeeded() how many input frames
+ * are required for the output frames you want, push them with
+ * pushInput() and get the output with readOutput().
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT Resampler
+{
+public:
+	/**
+	 * @brief Quality of the filters, higher quality cost more taps
+	 */
+	enum Quality
+	{
+		LowQuality, ///< 8 taps
+		MediumQuality, ///< 16 taps
+		HighQuality ///< 32 taps
+	};
+
+	/**
+	 * @brief Code applying the filters, they all give the same output
+	 */
+	enum Kernel
+	{
+		AutomaticKernel, ///< Fastest kernel the processor supports
+		ScalarKernel, ///< Plain C++
+		Sse2Kernel, ///< SSE2, x86 only
+		Avx2Kernel ///< AVX2, x86 processors that support it
+	};
+
+	enum
+	{
+		/**
+		 * @brief Most output frames read at once
+		 */
+		MaxOutputFrames = 4096
+	};
+
+	/**
+	 * @brief Create a resampler that does not change the rate
+	 */
+	Resampler();
+	/**
+	 * @brief Destructor
+	 */
+	~Resampler();
+
+	/**
+	 * @brief Copy the rates and the pending input
+	 *
+	 * The copy goes on from the same point.
+	 * @param other Resampler to copy
+	 */
+	Resampler(const Resampler &other);
+
+	/**
+	 * @brief Copy the rates and the pending input
+	 * @param other Resampler to copy
+	 * @return This resampler
+	 */
+	Resampler &operator=(const Resampler &other);
+
+	/**
+	 * @brief Set the rates and compute the filter bank
+	 *
+	 * This also clears the resampler.
+	 * @param inputRate Input sample rate in Hz
+	 * @param outputRate Output sample rate in Hz
+	 * @param quality Quality of the filters
+	 */
+	void setRates(int inputRate, int outputRate, Quality quality = MediumQuality);
+
+	/**
+	 * @brief Get the input sample rate
+	 * @return Rate in Hz
+	 */
+	int inputRate() const;
+
+	/**
+	 * @brief Get the output sample rate
+	 * @return Rate in Hz
+	 */
+	int outputRate() const;
+
+	/**
+	 * @brief Get the quality of the filters
+	 * @return Quality
+	 */
+	Quality quality() const;
+
+	/**
+	 * @brief Choose the code applying the filters
+	 *
+	 * Only the speed changes, for tests and benchmarks.
+	 * @param kernel Kernel to use
+	 * @return false if the processor or the build doesn't support it
+	 */
+	bool setKernel(Kernel kernel);
+
+	/**
+	 * @brief Get the kernel chosen by setKernel()
+	 * @return Kernel
+	 */
+	Kernel kernel() const;
+
+	/**
+	 * @brief Check if the input and output rate are the same
+	 *
+	 * In that case, the samples don't need to go through the resampler.
+	 * @return true if the resampler does nothing
+	 */
+	bool isPassthrough() const;
+
+	/**
+	 * @brief Forget the pending input
+	 */
+	void reset();
+
+	/**
+	 * @brief Get the number of input frames to push before
+	 * reading the given number of output frames
+	 * @param outputFrames Output frames wanted, at most MaxOutputFrames
+	 * @return Input frames to push, can be 0
+	 */
+	int inputFramesNeeded(int outputFrames) const;
+
+	/**
+	 * @brief Get the most input frames inputFramesNeeded() can return
+	 * @return Frames
+	 */
+	int maxInputFrames() const;
+
+	/**
+	 * @brief Push input frames
+	 * @param input Interleaved left/right samples
+	 * @param frames Number of frames, at most inputFramesNeeded()
+	 */
+	void pushInput(const s16 *input, int frames);
+
+	/**
+	 * @brief Read resampled frames
+	 *
+	 * Enough input must have been pushed, see inputFramesNeeded().
+	 * @param output Interleaved left/right samples, can be null
+	 * to drop the frames
+	 * @param frames Number of frames, at most MaxOutputFrames
+	 */
+	void readOutput(s16 *output, int frames);
+
+	/**
+	 * @brief Read resampled frames as floating point samples
+	 *
+	 * Same as the 16-bit readOutput(), the samples are
+	 * from -1.0 to 1.0, without clipping.
+	 * @param output Interleaved left/right samples, can be null
+	 * to drop the frames
+	 * @param frames Number of frames, at most MaxOutputFrames
+	 */
+	void readOutput(float *output, int frames);
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "rewindbuffer.h"
+
+// STL includes
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// LegacySPC includes
+#include "compressedsnapshot.h"
+#include "ram.h"
+#include "snapshotcodec.h"
+#include "spcstate.h"
+
+namespace LegacySPC
+{
+
+// The registers, timers and DSP state follow the RAM
+static const size_t RestOffset = offsetof(SpcState, ram) + sizeof(SpcState::ram);
+static const size_t RestSize = sizeof(SpcState) - RestOffset;
+
+static byte *restOf(SpcState &state)
+{
+	return reinterpret_cast<byte*>(&state) + RestOffset;
+}
+
+static const byte *restOf(const SpcState &state)
+{
+	return reinterpret_cast<const byte*>(&state) + RestOffset;
+}
+
+static bool isPageSet(const uint32 *pages, int page)
+{
+	return pages[page >> 5] & (1u << (page & 31));
+}
+
+/**
+ * @internal
+ * @brief Point of the history
+ */
+struct RewindPoint
+{
+	long long position;
+	// Pages that changed since the previous point
+	uint32 pages[Ram::PageCount / 32];
+	// XOR with the previous point: the changed pages, then the
+	// rest of the state. Empty for the first point recorded.
+	std::vector<byte> delta;
+	// Empty when not a keyframe
+	CompressedSnapshot keyframe;
+
+	size_t size() const
+	{
+		return sizeof(RewindPoint) - sizeof(CompressedSnapshot) + delta.capacity() + keyframe.size();
+	}
+};
+
+class RewindBuffer::Private
+{
+public:
+	Private()
+	 : head(new SpcState), referenceRam(0),
+	   byteBudget(0), keyframeInterval(0), memoryUsed(0), sinceKeyframe(0)
+	{
+	}
+
+	~Private()
+	{
+		delete head;
+	}
+
+	// Turns the state of a point into the state of the point before,
+	// or the state of the point before into the state of the point.
+	bool applyDelta(const RewindPoint &point, SpcState &state) const;
+	void dropOldest();
+
+	std::deque<RewindPoint> points;
+	// State of the last point
+	SpcState *head;
+	const byte *referenceRam;
+
+	size_t byteBudget;
+	int keyframeInterval;
+	size_t memoryUsed;
+	// Points recorded since the last keyframe
+	int sinceKeyframe;
+
+	// Changed pages XORed together, kept to avoid allocations
+	mutable std::vector<byte> scratch;
+};
+
+bool RewindBuffer::Private::applyDelta(const RewindPoint &point, SpcState &state) const
+{
+	if( point.delta.empty() )
+	{
+		return false;
+	}
+
+	int pageCount = 0;
+	for(int page = 0; page < Ram::PageCount; page++)
+	{
+		if( isPageSet(point.pages, page) )
+		{
+			pageCount++;
+		}
+	}
+
+	const byte *input = &point.delta[0];
+	size_t inputSize = point.delta.size();
+
+	if( pageCount )
+	{
+		scratch.resize(pageCount * Ram::PageSize);
+		size_t used = SnapshotCodec::decode(input, inputSize, 0, &scratch[0], scratch.size());
+		if( !used )
+		{
+			return false;
+		}
+		input += used;
+		inputSize -= used;
+
+		const byte *changes = &scratch[0];
+		for(int page = 0; page < Ram::PageCount; page++)
+		{
+			if( isPageSet(point.pages, page) )
+			{
+				byte *ram = state.ram + page * Ram::PageSize;
+				for(int i = 0; i < Ram::PageSize; i++)
+				{
+					ram[i] ^= changes[i];
+				}
+				changes += Ram::PageSize;
+			}
+		}
+	}
+
+	scratch.resize(RestSize);
+	if( !SnapshotCodec::decode(input, inputSize, 0, &scratch[0], RestSize) )
+	{
+		return false;
+	}
+
+	byte *rest = restOf(state);
+	for(size_t i = 0; i < RestSize; i++)
+	{
+		rest[i] ^= scratch[i];
+	}
+
+	return true;
+}
+
+void RewindBuffer::Private::dropOldest()
+{
+	memoryUsed -= points.front().size();
+	points.pop_front();
+
+	// Nothing is restored before the oldest point
+	RewindPoint &oldest = points.front();
+	memoryUsed -= oldest.size();
+	std::vector<byte>().swap(oldest.delta);
+	memoryUsed += oldest.size();
+}
+
+RewindBuffer::RewindBuffer(size_t byteBudget, int keyframeInterval)
+ : d(new Private)
+{
+	d->byteBudget = byteBudget;
+	d->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+}
+
+RewindBuffer::~RewindBuffer()
+{
+	delete d;
+}
+
+void RewindBuffer::clear(const byte *referenceRam)
+{
+	d->points.clear();
+	d->referenceRam = referenceRam;
+	d->memoryUsed = 0;
+	d->sinceKeyframe = 0;
+}
+
+void RewindBuffer::record(const SpcState &state, const uint32 *dirtyPages)
+{
+	d->points.push_back( RewindPoint() );
+	RewindPoint &point = d->points.back();
+	point.position = state.position;
+	memset(point.pages, 0, sizeof(point.pages));
+
+	if( d->points.size() == 1 )
+	{
+		// Nothing before to compare with
+		point.keyframe.compress(state, d->referenceRam);
+		d->sinceKeyframe = 0;
+		memcpy(d->head, &state, sizeof(SpcState));
+	}
+	else
+	{
+		d->scratch.clear();
+		for(int page = 0; page < Ram::PageCount; page++)
+		{
+			if( !isPageSet(dirtyPages, page) )
+			{
+				continue;
+			}
+
+			const byte *ram = state.ram + page * Ram::PageSize;
+			byte *headRam = d->head->ram + page * Ram::PageSize;
+			if( memcmp(ram, headRam, Ram::PageSize) == 0 )
+			{
+				continue;
+			}
+
+			point.pages[page >> 5] |= 1u << (page & 31);
+			for(int i = 0; i < Ram::PageSize; i++)
+			{
+				d->scratch.push_back(ram[i] ^ headRam[i]);
+			}
+			memcpy(headRam, ram, Ram::PageSize);
+		}
+
+		if( !d->scratch.empty() )
+		{
+			SnapshotCodec::encode(&d->scratch[0], 0, d->scratch.size(), point.delta);
+		}
+		SnapshotCodec::encode(restOf(state), restOf(*d->head), RestSize, point.delta);
+		point.delta.shrink_to_fit();
+
+		memcpy(restOf(*d->head), restOf(state), RestSize);
+		d->head->position = state.position;
+
+		if( ++d->sinceKeyframe >= d->keyframeInterval )
+		{
+			point.keyframe.compress(state, d->referenceRam);
+			d->sinceKeyframe = 0;
+		}
+	}
+
+	d->memoryUsed += point.size();
+	while( d->memoryUsed > d->byteBudget && d->points.size() > 1 )
+	{
+		d->dropOldest();
+	}
+}
+
+int RewindBuffer::count() const
+{
+	return static_cast<int>( d->points.size() );
+}
+
+long long RewindBuffer::position(int index) const
+{
+	if( index < 0 || index >= count() )
+	{
+		return -1;
+	}
+
+	return d->points[index].position;
+}
+
+bool RewindBuffer::restore(int index, SpcState &state) const
+{
+	if( index < 0 || index >= count() )
+	{
+		return false;
+	}
+
+	// Start from the closest of the last point and the keyframes
+	// around the point
+	int last = count() - 1;
+	int start = last;
+	int distance = last - index;
+	for(int i = index; i >= 0 && index - i < distance; i--)
+	{
+		if( !d->points[i].keyframe.isEmpty() )
+		{
+			start = i;
+			distance = index - i;
+			break;
+		}
+	}
+	for(int i = index + 1; i < last && i - index < distance; i++)
+	{
+		if( !d->points[i].keyframe.isEmpty() )
+		{
+			start = i;
+			break;
+		}
+	}
+
+	if( start == last )
+	{
+		memcpy(&state, d->head, sizeof(SpcState));
+	}
+	else if( !d->points[start].keyframe.decompress(state, d->referenceRam) )
+	{
+		return false;
+	}
+
+	for(; start > index; start--)
+	{
+		if( !d->applyDelta(d->points[start], state) )
+		{
+			return false;
+		}
+	}
+	for(; start < index; start++)
+	{
+		if( !d->applyDelta(d->points[start + 1], state) )
+		{
+			return false;
+		}
+	}
+
+	state.position = d->points[index].position;
+	return true;
+}
+
+bool RewindBuffer::rewind(int index, SpcState &state)
+{
+	if( !restore(index, state) )
+	{
+		return false;
+	}
+
+	while( count() > index + 1 )
+	{
+		d->memoryUsed -= d->points.back().size();
+		d->points.pop_back();
+	}
+	memcpy(d->head, &state, sizeof(SpcState));
+
+	d->sinceKeyframe = 0;
+	for(int i = index; i >= 0 && d->points[i].keyframe.isEmpty(); i--)
+	{
+		d->sinceKeyframe++;
+	}
+
+	return true;
+}
+
+void RewindBuffer::setByteBudget(size_t byteBudget)
+{
+	d->byteBudget = byteBudget;
+	while( d->memoryUsed > d->byteBudget && d->points.size() > 1 )
+	{
+		d->dropOldest();
+	}
+}
+
+size_t RewindBuffer::byteBudget() const
+{
+	return d->byteBudget;
+}
+
+size_t RewindBuffer::memoryUsed() const
+{
+	return d->memoryUsed;
+}
+
+}
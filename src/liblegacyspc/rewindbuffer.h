@@ -0,0 +1,144 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_REWINDBUFFER_H
+#define LEGACYSPC_REWINDBUFFER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+
+namespace LegacySPC
+{
+
+struct SpcState;
+
+/**
+ * @brief History of emulation states within a memory budget
+ *
+ * Each point is stored as the XOR of its state with the previous
+ * point, for the RAM pages that changed and the rest of the state,
+ * compressed with SnapshotCodec. The XOR goes both ways, so the
+ * history is walked from the last point backward or from a
+ * keyframe, a CompressedSnapshot taken every few points, in either
+ * direction. Restoring a point applies at most half the keyframe
+ * interval of deltas.
+ *
+ * Recording only looks at the pages given as written, see
+ * RamPageTracker, and costs what the song changed since the last
+ * point. The oldest points are dropped to stay within the budget.
+ *
+ * The last state recorded is kept in full, these 64 KiB are not
+ * counted in the budget. Not thread-safe.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ * @see SpcRunner::setRewind()
+ */
+class LEGACYSPC_EXPORT RewindBuffer
+{
+public:
+	enum
+	{
+		DefaultByteBudget = 4 * 1024 * 1024,
+		DefaultKeyframeInterval = 32
+	};
+
+	/**
+	 * @brief Create an empty history
+	 * @param byteBudget Memory allowed for the points, in bytes
+	 * @param keyframeInterval Number of points between two keyframes
+	 */
+	explicit RewindBuffer(size_t byteBudget = DefaultByteBudget, int keyframeInterval = DefaultKeyframeInterval);
+	/**
+	 * @brief Destructor
+	 */
+	~RewindBuffer();
+
+	/**
+	 * @brief Forget all the points
+	 * @param referenceRam RAM the keyframes are compressed against,
+	 * like the RAM of the loaded file. Must stay valid and unchanged
+	 * until the next clear(), can be null.
+	 */
+	void clear(const byte *referenceRam);
+
+	/**
+	 * @brief Add a point after the last one
+	 * @param state State to record
+	 * @param dirtyPages Pages of state.ram written since the last
+	 * point, 256 bits in 8 words. All are compared for the first point.
+	 */
+	void record(const SpcState &state, const uint32 *dirtyPages);
+
+	/**
+	 * @brief Get the number of points
+	 * @return Points kept, the oldest is 0
+	 */
+	int count() const;
+
+	/**
+	 * @brief Get the position of a point
+	 * @param index Point from 0 to count() - 1
+	 * @return DSP samples since the file was loaded, -1 for an invalid index
+	 */
+	long long position(int index) const;
+
+	/**
+	 * @brief Rebuild the state of a point
+	 * @param index Point from 0 to count() - 1
+	 * @param state Receives the state
+	 * @return false if the index or the data is invalid
+	 */
+	bool restore(int index, SpcState &state) const;
+
+	/**
+	 * @brief Rebuild the state of a point and drop the ones after it
+	 *
+	 * Recording goes on from that point.
+	 * @param index Point from 0 to count() - 1
+	 * @param state Receives the state
+	 * @return false if the index or the data is invalid
+	 */
+	bool rewind(int index, SpcState &state);
+
+	/**
+	 * @brief Change the memory budget
+	 *
+	 * The oldest points are dropped at once when it is exceeded.
+	 * @param byteBudget Memory allowed for the points, in bytes
+	 */
+	void setByteBudget(size_t byteBudget);
+
+	/**
+	 * @brief Get the memory budget
+	 * @return Memory allowed for the points, in bytes
+	 */
+	size_t byteBudget() const;
+
+	/**
+	 * @brief Get the memory used by the points
+	 * @return Size in bytes, never more than byteBudget() with two points or more
+	 */
+	size_t memoryUsed() const;
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "ringbuffer.h"
+
+// STL includes
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace LegacySPC
+{
+
+static const int CacheLineSize = 64;
+
+class RingBuffer::Private
+{
+public:
+	Private(size_t capacity)
+	 : capacity(1), readPosition(0), writePosition(0), underruns(0), overruns(0)
+	{
+		while( this->capacity < capacity )
+		{
+			this->capacity <<= 1;
+		}
+		mask = this->capacity - 1;
+		samples.resize(this->capacity * 2);
+	}
+
+	std::vector<s16> samples;
+	size_t capacity;
+	size_t mask;
+
+	// Frames read and written since the start, they only grow.
+	// Each is written by a single thread, the padding keeps
+	// them on separate cache lines.
+	char readPadding[CacheLineSize];
+	std::atomic<size_t> readPosition;
+	char writePadding[CacheLineSize];
+	std::atomic<size_t> writePosition;
+	char counterPadding[CacheLineSize];
+
+	std::atomic<unsigned long> underruns;
+	std::atomic<unsigned long> overruns;
+};
+
+RingBuffer::RingBuffer(size_t capacity)
+ : d(new Private(capacity))
+{
+}
+
+RingBuffer::~RingBuffer()
+{
+	delete d;
+}
+
+size_t RingBuffer::capacity() const
+{
+	return d->capacity;
+}
+
+size_t RingBuffer::readAvailable() const
+{
+	size_t readPosition = d->readPosition.load(std::memory_order_relaxed);
+	return d->writePosition.load(std::memory_order_acquire) - readPosition;
+}
+
+size_t RingBuffer::writeAvailable() const
+{
+	size_t writePosition = d->writePosition.load(std::memory_order_relaxed);
+	return d->capacity - (writePosition - d->readPosition.load(std::memory_order_acquire));
+}
+
+size_t RingBuffer::write(const s16 *interleaved, size_t frames)
+{
+	size_t space = writeAvailable();
+	if( frames > space )
+	{
+		d->overruns.fetch_add(1, std::memory_order_relaxed);
+		frames = space;
+	}
+
+	size_t written = 0;
+	while( written < frames )
+	{
+		size_t region;
+		s16 *destination = writeRegion(region);
+		if( region > frames - written )
+		{
+			region = frames - written;
+		}
+
+		memcpy(destination, interleaved + written * 2, region * 2 * sizeof(s16));
+		commitWrite(region);
+		written += region;
+	}
+
+	return written;
+}
+
+s16 *RingBuffer::writeRegion(size_t &frames)
+{
+	size_t writePosition = d->writePosition.load(std::memory_order_relaxed);
+	size_t offset = writePosition & d->mask;
+	size_t space = d->capacity - (writePosition - d->readPosition.load(std::memory_order_acquire));
+	size_t untilEnd = d->capacity - offset;
+
+	frames = space < untilEnd ? space : untilEnd;
+	return &d->samples[offset * 2];
+}
+
+void RingBuffer::commitWrite(size_t frames)
+{
+	size_t writePosition = d->writePosition.load(std::memory_order_relaxed);
+	d->writePosition.store(writePosition + frames, std::memory_order_release);
+}
+
+size_t RingBuffer::read(s16 *interleaved, size_t frames)
+{
+	size_t readPosition = d->readPosition.load(std::memory_order_relaxed);
+	size_t available = d->writePosition.load(std::memory_order_acquire) - readPosition;
+	size_t count = frames < available ? frames : available;
+
+	size_t offset = readPosition & d->mask;
+	size_t first = d->capacity - offset;
+	if( first > count )
+	{
+		first = count;
+	}
+	memcpy(interleaved, &d->samples[offset * 2], first * 2 * sizeof(s16));
+	memcpy(interleaved + first * 2, &d->samples[0], (count - first) * 2 * sizeof(s16));
+
+	d->readPosition.store(readPosition + count, std::memory_order_release);
+
+	if( count < frames )
+	{
+		memset(interleaved + count * 2, 0, (frames - count) * 2 * sizeof(s16));
+		d->underruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return count;
+}
+
+unsigned long RingBuffer::underruns() const
+{
+	return d->underruns.load(std::memory_order_relaxed);
+}
+
+unsigned long RingBuffer::overruns() const
+{
+	return d->overruns.load(std::memory_order_relaxed);
+}
+
+void RingBuffer::clear()
+{
+	d->readPosition.store(0);
+	d->writePosition.store(0);
+	d->underruns.store(0);
+	d->overruns.store(0);
+}
+
+}
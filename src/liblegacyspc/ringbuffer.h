@@ -0,0 +1,132 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_RINGBUFFER_H
+#define LEGACYSPC_RINGBUFFER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Lock-free ring buffer of stereo frames
+ *
+ * One thread writes, the producer, and one thread reads, the consumer.
+ * No lock is used; the consumer side is wait-free and can be called
+ * from a realtime audio callback.
+ *
+ * The producer can write directly in the ring with writeRegion() and
+ * commitWrite() to avoid a copy.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT RingBuffer
+{
+public:
+	/**
+	 * @brief Create a ring buffer
+	 * @param capacity Frames the ring can hold, rounded up to a power of two
+	 */
+	RingBuffer(size_t capacity);
+	/**
+	 * @brief Destructor
+	 */
+	~RingBuffer();
+
+	/**
+	 * @brief Get the number of frames the ring can hold
+	 * @return Frames
+	 */
+	size_t capacity() const;
+
+	/**
+	 * @brief Get the number of frames ready to be read
+	 * @return Frames
+	 */
+	size_t readAvailable() const;
+
+	/**
+	 * @brief Get the number of frames that can be written
+	 * @return Frames
+	 */
+	size_t writeAvailable() const;
+
+	/**
+	 * @brief Write frames, producer side
+	 *
+	 * The frames that don't fit are dropped and counted as an overrun.
+	 * @param interleaved Interleaved left/right samples
+	 * @param frames Number of frames
+	 * @return Number of frames written
+	 */
+	size_t write(const s16 *interleaved, size_t frames);
+
+	/**
+	 * @brief Get the free space to write in place, producer side
+	 *
+	 * The region is contiguous, it stops at the end of the ring.
+	 * @param frames Set to the number of frames of the region
+	 * @return Start of the region, interleaved left/right samples
+	 */
+	s16 *writeRegion(size_t &frames);
+
+	/**
+	 * @brief Publish frames written in the region, producer side
+	 * @param frames Number of frames, at most the size of the region
+	 */
+	void commitWrite(size_t frames);
+
+	/**
+	 * @brief Read frames, consumer side
+	 *
+	 * Wait-free. When less frames are available than asked, the
+	 * rest of the buffer is filled with silence and an underrun is counted.
+	 * @param interleaved Interleaved left/right output
+	 * @param frames Number of frames wanted
+	 * @return Number of frames read from the ring
+	 */
+	size_t read(s16 *interleaved, size_t frames);
+
+	/**
+	 * @brief Get the number of reads that were short of frames
+	 * @return Underrun count
+	 */
+	unsigned long underruns() const;
+
+	/**
+	 * @brief Get the number of writes that were short of space
+	 * @return Overrun count
+	 */
+	unsigned long overruns() const;
+
+	/**
+	 * @brief Empty the ring and reset the counters
+	 *
+	 * Neither the producer nor the consumer must use the ring meanwhile.
+	 */
+	void clear();
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "snapshotcodec.h"
+
+// STL includes
+#include <cstring>
+
+namespace LegacySPC
+{
+
+/*
+ * A token starts with a byte: the type in the 2 low bits, the
+ * length in the 6 others. A length of 0 there means the length
+ * follows as a variable-length number, 7 bits per byte, low bits
+ * first. Repeat tokens end with the byte to repeat, literal tokens
+ * with the bytes, match tokens with the distance to copy from.
+ */
+enum TokenType
+{
+	ZeroRun = 0,
+	RepeatRun = 1,
+	Literal = 2,
+	Match = 3
+};
+
+// Shorter runs and matches are cheaper as literals
+static const size_t MinZeroRun = 3;
+static const size_t MinRepeatRun = 4;
+static const size_t MinMatch = 5;
+static const size_t MaxInlineLength = 63;
+static const int HashBits = 12;
+
+static void writeNumber(std::vector<byte> &output, size_t value)
+{
+	while( value >= 0x80 )
+	{
+		output.push_back( static_cast<byte>(value | 0x80) );
+		value >>= 7;
+	}
+	output.push_back( static_cast<byte>(value) );
+}
+
+static bool readNumber(const byte *input, size_t inputSize, size_t &position, size_t &value)
+{
+	value = 0;
+	for(int shift = 0; shift < 64; shift += 7)
+	{
+		if( position >= inputSize )
+		{
+			return false;
+		}
+
+		byte current = input[position++];
+		value |= static_cast<size_t>(current & 0x7F) << shift;
+		if( !(current & 0x80) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void writeToken(std::vector<byte> &output, TokenType type, size_t length)
+{
+	if( length <= MaxInlineLength )
+	{
+		output.push_back( static_cast<byte>(type | length << 2) );
+	}
+	else
+	{
+		output.push_back( static_cast<byte>(type) );
+		writeNumber(output, length);
+	}
+}
+
+static void writeLiteral(std::vector<byte> &output, const byte *data, size_t length)
+{
+	if( length )
+	{
+		writeToken(output, Literal, length);
+		output.insert(output.end(), data, data + length);
+	}
+}
+
+static unsigned int read32(const byte *data)
+{
+	unsigned int value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static unsigned int hash32(unsigned int value)
+{
+	return (value * 2654435761U) >> (32 - HashBits);
+}
+
+void SnapshotCodec::encode(const byte *data, const byte *reference, size_t size, std::vector<byte> &output)
+{
+	std::vector<byte> delta(data, data + size);
+	if( reference )
+	{
+		for(size_t i = 0; i < size; i++)
+		{
+			delta[i] ^= reference[i];
+		}
+	}
+	const byte *x = size ? &delta[0] : 0;
+
+	// Last position + 1 of each hashed 4 bytes, 0 when none
+	size_t table[1 << HashBits];
+	memset(table, 0, sizeof(table));
+
+	size_t literalStart = 0;
+	size_t i = 0;
+	while( i < size )
+	{
+		size_t end = i + 1;
+		while( end < size && x[end] == x[i] )
+		{
+			end++;
+		}
+
+		size_t run = end - i;
+		if( (x[i] == 0 && (run >= MinZeroRun || end == size)) || run >= MinRepeatRun )
+		{
+			writeLiteral(output, x + literalStart, i - literalStart);
+			if( x[i] == 0 )
+			{
+				writeToken(output, ZeroRun, run);
+			}
+			else
+			{
+				writeToken(output, RepeatRun, run);
+				output.push_back(x[i]);
+			}
+
+			i = end;
+			literalStart = i;
+			continue;
+		}
+
+		if( i + 4 <= size )
+		{
+			unsigned int hash = hash32( read32(x + i) );
+			size_t candidate = table[hash];
+			table[hash] = i + 1;
+
+			if( candidate && read32(x + candidate - 1) == read32(x + i) )
+			{
+				size_t from = candidate - 1;
+				size_t length = 4;
+				while( i + length < size && x[from + length] == x[i + length] )
+				{
+					length++;
+				}
+
+				if( length >= MinMatch )
+				{
+					writeLiteral(output, x + literalStart, i - literalStart);
+					writeToken(output, Match, length);
+					writeNumber(output, i - from);
+
+					i += length;
+					literalStart = i;
+					continue;
+				}
+			}
+		}
+
+		i++;
+	}
+
+	writeLiteral(output, x + literalStart, size - literalStart);
+}
+
+size_t SnapshotCodec::decode(const byte *input, size_t inputSize, const byte *reference, byte *data, size_t size)
+{
+	size_t position = 0;
+	size_t written = 0;
+	while( written < size )
+	{
+		if( position >= inputSize )
+		{
+			return 0;
+		}
+
+		byte token = input[position++];
+		TokenType type = static_cast<TokenType>(token & 0x03);
+		size_t length = token >> 2;
+		if( !length && (!readNumber(input, inputSize, position, length) || !length) )
+		{
+			return 0;
+		}
+		if( length > size - written )
+		{
+			return 0;
+		}
+
+		switch( type )
+		{
+			case ZeroRun:
+				memset(data + written, 0, length);
+				break;
+			case RepeatRun:
+				if( position >= inputSize )
+				{
+					return 0;
+				}
+				memset(data + written, input[position++], length);
+				break;
+			case Literal:
+				if( length > inputSize - position )
+				{
+					return 0;
+				}
+				memcpy(data + written, input + position, length);
+				position += length;
+				break;
+			case Match:
+			{
+				size_t distance;
+				if( !readNumber(input, inputSize, position, distance) || !distance || distance > written )
+				{
+					return 0;
+				}
+				// Byte by byte, the match can overlap what it writes
+				for(size_t i = 0; i < length; i++)
+				{
+					data[written + i] = data[written + i - distance];
+				}
+				break;
+			}
+		}
+		written += length;
+	}
+
+	if( reference )
+	{
+		for(size_t i = 0; i < size; i++)
+		{
+			data[i] ^= reference[i];
+		}
+	}
+
+	return position;
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SNAPSHOTCODEC_H
+#define LEGACYSPC_SNAPSHOTCODEC_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+#include <vector>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Delta and LZ/RLE compression of emulator memory
+ *
+ * The data is first XORed with a reference of the same size, the
+ * unchanged bytes become zeros. The result is then stored as runs
+ * of zeros, runs of a repeated byte, matches of earlier bytes and
+ * literals, each with a variable-length size.
+ *
+ * It is made for the RAM of a song compared to the RAM of its
+ * file: most of it is unchanged or filled, and the encoding is a
+ * single pass with a small hash table.
+ *
+ * The encoded stream doesn't store the size of the data, the caller
+ * knows it. Streams can be concatenated, decode() tells where each
+ * ends.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SnapshotCodec
+{
+public:
+	/**
+	 * @brief Encode data
+	 * @param data Data to encode
+	 * @param reference Data of the same size to compare with, null for none
+	 * @param size Number of bytes
+	 * @param output Receives the encoded stream, appended
+	 */
+	static void encode(const byte *data, const byte *reference, size_t size, std::vector<byte> &output);
+
+	/**
+	 * @brief Decode data
+	 * @param input Encoded stream
+	 * @param inputSize Bytes available in input
+	 * @param reference Reference given to encode()
+	 * @param data Receives the data
+	 * @param size Number of bytes to decode, as given to encode()
+	 * @return Bytes of input used, 0 if the stream is invalid
+	 */
+	static size_t decode(const byte *input, size_t inputSize, const byte *reference, byte *data, size_t size);
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 // LegacySPC includes
 #include "ram.h"
+#include "dsp.h"
 #include "processor.h"
 #include "spcrunner.h"
 
@@ -31,14 +32,17 @@ public:
 
 		processor = new Processor(runner);
 		ram = new Ram;
+		dsp = new Dsp(ram);
 	}
 	~Private()
 	{
+		delete dsp;
 		delete processor;
 		delete ram;
 	}
 
 	Ram *ram;
+	Dsp *dsp;
 	SpcRunner *runner;
 	Processor *processor;
 };
@@ -68,4 +72,9 @@ Processor* SpcComponentManager::processor() const
 	return d->processor;
 }
 
+Dsp* SpcComponentManager::dsp() const
+{
+	return d->dsp;
+}
+
 }
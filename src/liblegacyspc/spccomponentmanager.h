@@ -19,6 +19,7 @@ namespace LegacySPC
 {
 
 class Ram;
+class Dsp;
 class Processor;
 class SpcRunner;
 
@@ -49,6 +50,8 @@ public:
 
 	Processor* processor() const;
 
+	Dsp* dsp() const;
+
 private:
 	class Private;
 	Private *d;
@@ -15,6 +15,8 @@
 #include "spcfile.h"
 
 // STL Includes
+#include <atomic>
+#include <utility>
 
 // Local includes
 #include "processorregisters.h"
@@ -27,54 +29,95 @@ class SpcFile::Private
 {
 public:
 	Private()
-	 : refCounting(1)
+	 : refCounting(1), contentHash(0)
 	{}
 
-	void copy(Private *other)
+	void copy(Private *other, bool copyRamData)
 	{
 		tag = other->tag;
+		extendedTag = other->extendedTag;
 		regs = other->regs;
-		ramData = other->ramData;
+		if( copyRamData )
+		{
+			ramData = other->ramData;
+		}
 		dspRegisters = other->dspRegisters;
+		contentHash = other->contentHash;
 	}
 
-	int refCounting;
+	void ref()
+	{
+		refCounting.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Delete the data when the last reference is released
+	void deref()
+	{
+		if( refCounting.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+		{
+			lDebug() << "Deleting SpcFile data";
+			delete this;
+		}
+	}
+
+	// Data of the empty SpcFiles, its own reference keeps it alive.
+	// Never deleted, SpcFiles can be destroyed after the statics.
+	static Private *sharedEmpty()
+	{
+		static Private *empty = new Private;
+		empty->ref();
+		return empty;
+	}
+
+	std::atomic<int> refCounting;
 	ID666Tag tag;
+	ExtendedID666Tag extendedTag;
 	ProcessorRegisters regs;
 	std::vector<byte> ramData;
 	std::vector<byte> dspRegisters;
+	unsigned long long contentHash;
 };
 
 SpcFile::SpcFile()
- : d(new Private)
+ : d(Private::sharedEmpty())
 {}
 
 SpcFile::~SpcFile()
 {
-	if(!--d->refCounting)
-	{
-		lDebug() << "Deleting SpcFile data";
-		delete d;
-	}
+	d->deref();
 }
 
 SpcFile::SpcFile(const SpcFile &copy)
  : d(copy.d)
 {
-	d->refCounting++;
+	d->ref();
 }
 
-const SpcFile &SpcFile::operator=(const SpcFile &other)
+SpcFile &SpcFile::operator=(const SpcFile &other)
 {
-	if( this == &other )
-		return *this;
+	// Referenced first, in case both share the same data
+	other.d->ref();
+	d->deref();
+	d = other.d;
 
-	this->d = other.d;
+	return *this;
+}
+
+SpcFile::SpcFile(SpcFile &&other)
+ : d(other.d)
+{
+	other.d = Private::sharedEmpty();
+}
+
+SpcFile &SpcFile::operator=(SpcFile &&other)
+{
+	// The old data is released with other
+	std::swap(d, other.d);
 
 	return *this;
 }
 
-ID666Tag &SpcFile::id666Tag() const
+const ID666Tag &SpcFile::id666Tag() const
 {
 	return d->tag;
 }
@@ -86,7 +129,19 @@ void SpcFile::setID666Tag(const ID666Tag &tag)
 	d->tag = tag;
 }
 
-ProcessorRegisters &SpcFile::processorRegisters() const
+const ExtendedID666Tag &SpcFile::extendedTag() const
+{
+	return d->extendedTag;
+}
+
+void SpcFile::setExtendedTag(const ExtendedID666Tag &tag)
+{
+	detach();
+
+	d->extendedTag = tag;
+}
+
+const ProcessorRegisters &SpcFile::processorRegisters() const
 {
 	return d->regs;
 }
@@ -98,19 +153,26 @@ void SpcFile::setProcessorRegisters(const ProcessorRegisters &registers)
 	d->regs = registers;
 }
 
-std::vector<byte> &SpcFile::ramData() const
+const std::vector<byte> &SpcFile::ramData() const
 {
 	return d->ramData;
 }
 
 void SpcFile::setRamData(const std::vector<byte> &ramData)
 {
-	detach();
+	detach(false);
 
 	d->ramData = ramData;
 }
 
-std::vector<byte> &SpcFile::dspRegisters() const
+void SpcFile::setRamData(const byte *data, size_t size)
+{
+	detach(false);
+
+	d->ramData.assign(data, data + size);
+}
+
+const std::vector<byte> &SpcFile::dspRegisters() const
 {
 	return d->dspRegisters;
 }
@@ -122,20 +184,32 @@ void SpcFile::setDspRegisters(const std::vector<byte> &dspRegisters)
 	d->dspRegisters = dspRegisters;
 }
 
-void SpcFile::detach()
+unsigned long long SpcFile::contentHash() const
 {
-	//lDebug();
+	return d->contentHash;
+}
 
-	Private *olderPrivate = d;
+void SpcFile::setContentHash(unsigned long long hash)
+{
+	detach();
 
-	d = new Private;
-	d->copy(olderPrivate);
+	d->contentHash = hash;
+}
 
-	if( !--olderPrivate->refCounting )
+void SpcFile::detach(bool copyRamData)
+{
+	// Only this instance uses the data, modify it in place
+	if( d->refCounting.load(std::memory_order_acquire) == 1 )
 	{
-		//lDebug() << "Deleting olderPrivate";
-		delete olderPrivate;
+		return;
 	}
+
+	Private *olderPrivate = d;
+
+	d = new Private;
+	d->copy(olderPrivate, copyRamData);
+
+	olderPrivate->deref();
 }
 
 }
@@ -93,8 +93,82 @@ struct ID666Tag
 	bool isBinary;
 };
 
+/**
+ * @brief Extended ID666 tag, stored in chunks after the SPC data
+ *
+ * Only the items found in the file are set, the others keep their
+ * default value. The lengths are in ticks of 1/64000 second.
+ * @see ExtendedTagParser
+ */
+struct ExtendedID666Tag
+{
+	ExtendedID666Tag()
+	 : isPresent(false), dateDumped(0), emulatorIndex(0), ostDisc(0), ostTrack(0),
+	   copyrightYear(0), introLength(0), loopLength(0), endLength(0), fadeLength(0),
+	   mutedVoices(0), loopCount(0), mixingLevel(0)
+	{}
+
+	enum
+	{
+		TicksPerSecond = 64000
+	};
+
+	/**
+	 * @brief Get the length to play before the fadeout
+	 * @return intro + loop * loopCount + end, in ticks. A loop
+	 * count of 0 plays the loop once.
+	 */
+	long long playLength() const
+	{
+		return introLength + static_cast<long long>(loopLength) * (loopCount ? loopCount : 1) + endLength;
+	}
+
+	/**
+	 * @brief Is there a xid6 chunk in the file ?
+	 */
+	bool isPresent;
+
+	std::string songTitle;
+	std::string gameTitle;
+	std::string artistName;
+	std::string dumperName;
+	std::string comment;
+	/**
+	 * @brief Official soundtrack title
+	 */
+	std::string ostTitle;
+	std::string publisherName;
+	/**
+	 * @brief Date the SPC was dumped, as yyyymmdd
+	 */
+	int dateDumped;
+	int emulatorIndex;
+	int ostDisc;
+	/**
+	 * @brief Track number in the upper byte, optional letter in the lower byte
+	 */
+	int ostTrack;
+	int copyrightYear;
+
+	int introLength;
+	int loopLength;
+	int endLength;
+	int fadeLength;
+	/**
+	 * @brief Voices to mute, bit 0 for voice 0
+	 */
+	byte mutedVoices;
+	/**
+	 * @brief Number of times to play the loop, 0 when unset
+	 */
+	int loopCount;
+	/**
+	 * @brief Preamp level
+	 */
+	int mixingLevel;
+};
+
 // TODO: Get/set Extra RAM
-// TODO: Extended ID666 Tag based on chunk
 /**
  * @brief Contain all data of a SPC file
  *
@@ -103,8 +177,12 @@ struct ID666Tag
  *
  * To load a SPC file, use SpcFileLoader.
  *
- * SpcFile is implicit shared, but not thread-safe because the
- * ref-counting is not thread aware.
+ * SpcFile is implicit shared: copies share the data until one
+ * of them is modified, then only the modified one is copied.
+ * The reference count is atomic, so copies of a SpcFile can be
+ * used and destroyed by different threads, but a single SpcFile
+ * instance must not be modified by two threads at once. Moving a
+ * SpcFile doesn't touch the data, the moved-from SpcFile is empty.
  *
  * @author Michaël Larouche <larouche@kde.org>
  */
@@ -131,13 +209,26 @@ public:
 	 * @param other Other SpcFile
 	 * @return current SpcFile instance reference
 	 */
-	const SpcFile &operator=(const SpcFile &other);
+	SpcFile &operator=(const SpcFile &other);
+
+	/**
+	 * @brief Take the data of another SpcFile
+	 * @param other SpcFile to move, empty afterwards
+	 */
+	SpcFile(SpcFile &&other);
+
+	/**
+	 * @brief Take the data of another SpcFile
+	 * @param other SpcFile to move, empty afterwards
+	 * @return current SpcFile instance reference
+	 */
+	SpcFile &operator=(SpcFile &&other);
 
 	/**
 	 * @brief Get the ID666 Tag
 	 * @return ID666 Tag
 	 */
-	ID666Tag &id666Tag() const;
+	const ID666Tag &id666Tag() const;
 
 	/**
 	 * @brief Set the ID666 Tag
@@ -145,11 +236,23 @@ public:
 	 */
 	void setID666Tag(const ID666Tag &tag);
 
+	/**
+	 * @brief Get the extended ID666 Tag
+	 * @return Extended tag, isPresent is false when the file has none
+	 */
+	const ExtendedID666Tag &extendedTag() const;
+
+	/**
+	 * @brief Set the extended ID666 Tag
+	 * @param tag ExtendedID666Tag instance
+	 */
+	void setExtendedTag(const ExtendedID666Tag &tag);
+
 	/**
 	 * @brief Get the Processor registers
 	 * @return ProcessorRegisters instance
 	 */
-	ProcessorRegisters &processorRegisters() const;
+	const ProcessorRegisters &processorRegisters() const;
 
 	/**
 	 * @brief Set the registers values for the CPU
@@ -161,7 +264,7 @@ public:
 	 * @brief Get the ram data
 	 * @return a vector of bytes containing the RAM data
 	 */
-	std::vector<byte> &ramData() const;
+	const std::vector<byte> &ramData() const;
 
 	/**
 	 * @brief Set the RAM data read from the SPC file
@@ -169,11 +272,18 @@ public:
 	 */
 	void setRamData(const std::vector<byte> &ramData);
 
+	/**
+	 * @brief Set the RAM data from a buffer
+	 * @param data Start of the RAM data
+	 * @param size Number of bytes
+	 */
+	void setRamData(const byte *data, size_t size);
+
 	/**
 	 * @brief Get the DSP registers
 	 * @return byte vector containing DSP registers
 	 */
-	std::vector<byte> &dspRegisters() const;
+	const std::vector<byte> &dspRegisters() const;
 	
 	/**
 	 * @brief Set the DSP registers
@@ -181,11 +291,30 @@ public:
 	 */
 	void setDspRegisters(const std::vector<byte> &dspRegisters);
 
+	/**
+	 * @brief Get the hash of the emulation state
+	 *
+	 * Set by SpcFileLoader, see MappedSpcFile::contentHash(). Files
+	 * differing only by their tags have the same hash. The hash is
+	 * not updated when the registers or the RAM are changed.
+	 * @return Hash, 0 when unknown
+	 */
+	unsigned long long contentHash() const;
+
+	/**
+	 * @brief Set the hash of the emulation state
+	 * @param hash Hash, 0 when unknown
+	 */
+	void setContentHash(unsigned long long hash);
+
 private:
 	/**
 	 * @brief Detach the instance from the shared one when modified
+	 *
+	 * Nothing is copied when the data is not shared.
+	 * @param copyRamData false when the caller replaces the RAM data
 	 */
-	void detach();
+	void detach(bool copyRamData = true);
 
 private:
 	class Private;
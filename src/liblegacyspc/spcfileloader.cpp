@@ -15,14 +15,20 @@
 #include "spcfileloader.h"
 
 // STL includes
-#include <fstream>
+#include <utility>
 #include <vector>
-#include <cstdlib>
-#include <sstream>
-#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Local includes
-#include "processorregisters.h"
+#include "extendedtagparser.h"
+#include "mappedspcfile.h"
 #include "spcfile.h"
 #include "types.h"
 #include "legacyspc_debug.h"
@@ -32,7 +38,56 @@ using namespace std;
 namespace LegacySPC
 {
 
-static const char SpcMagicHeader[] = "SNES-SPC700 Sound File Data v0.30";
+// Larger xid6 chunks are cut, the tags are at most a few KiB
+static const size_t MaxExtendedTagSize = 0x10000;
+
+// Read the header with a single read, then the xid6 chunk when
+// asked for and present
+static bool readTags(const std::string &filename, byte *header, vector<byte> *extendedData)
+{
+#if defined(_WIN32) || defined(_WIN64)
+	ifstream file(filename.c_str(), ios::in | ios::binary);
+	if( !file.read(reinterpret_cast<char*>(header), MappedSpcFile::HeaderSize) )
+	{
+		return false;
+	}
+
+	if( extendedData && MappedSpcFile::checkHeader(header) )
+	{
+		extendedData->resize(MaxExtendedTagSize);
+		file.seekg(MappedSpcFile::ExtendedTagOffset);
+		file.read(reinterpret_cast<char*>(&(*extendedData)[0]), MaxExtendedTagSize);
+		extendedData->resize( file.gcount() > 0 ? static_cast<size_t>(file.gcount()) : 0 );
+	}
+#else
+	int descriptor = ::open(filename.c_str(), O_RDONLY);
+	if( descriptor < 0 )
+	{
+		return false;
+	}
+
+	ssize_t readSize = pread(descriptor, header, MappedSpcFile::HeaderSize, 0);
+
+	struct stat status;
+	if( readSize == MappedSpcFile::HeaderSize && extendedData && MappedSpcFile::checkHeader(header) &&
+	    fstat(descriptor, &status) == 0 && status.st_size > MappedSpcFile::ExtendedTagOffset )
+	{
+		size_t size = static_cast<size_t>(status.st_size - MappedSpcFile::ExtendedTagOffset);
+		extendedData->resize( size < MaxExtendedTagSize ? size : MaxExtendedTagSize );
+
+		ssize_t extendedSize = pread(descriptor, &(*extendedData)[0], extendedData->size(), MappedSpcFile::ExtendedTagOffset);
+		extendedData->resize( extendedSize > 0 ? static_cast<size_t>(extendedSize) : 0 );
+	}
+
+	::close(descriptor);
+	if( readSize != MappedSpcFile::HeaderSize )
+	{
+		return false;
+	}
+#endif
+
+	return MappedSpcFile::checkHeader(header);
+}
 
 class SpcFileLoader::Private
 {
@@ -41,15 +96,8 @@ public:
 	 : failed(false)
 	{}
 
-	ifstream fileLoader;
 	bool failed;
 	SpcFile spcFile;
-
-	bool checkMagicHeader();
-	void readRegisters();
-	void readRamData();
-	void readID666Tag();
-	void readDspRegisters();
 };
 
 // TODO: Maybe add a type to check error types
@@ -58,10 +106,10 @@ SpcFileLoader::SpcFileLoader()
 {
 }
 
-SpcFileLoader::SpcFileLoader(const std::string &filename)
+SpcFileLoader::SpcFileLoader(const std::string &filename, LoadMode mode)
  : d(new Private)
 {
-	open(filename);
+	open(filename, mode);
 }
 
 SpcFileLoader::~SpcFileLoader()
@@ -69,40 +117,52 @@ SpcFileLoader::~SpcFileLoader()
 	delete d;
 }
 
-void SpcFileLoader::open(const std::string &filename)
+void SpcFileLoader::open(const std::string &filename, LoadMode mode)
 {
 	lDebug() << "Loading file" << filename;
 
-	d->fileLoader.open(filename.c_str(), ios::in | ios::binary);
-
-	// Does the fileLoader failed to open
-	if( !d->fileLoader )
+	if( mode == TagOnly )
 	{
-		setFailed();
+		byte header[MappedSpcFile::HeaderSize];
+		vector<byte> extendedData;
+		if( !readTags(filename, header, &extendedData) )
+		{
+			setFailed();
+			return;
+		}
+
+		ExtendedID666Tag extendedTag;
+		if( !extendedData.empty() )
+		{
+			ExtendedTagParser::parse(&extendedData[0], extendedData.size(), extendedTag);
+		}
+
+		d->spcFile.setProcessorRegisters( MappedSpcFile::decodeProcessorRegisters(header) );
+		d->spcFile.setID666Tag( MappedSpcFile::decodeID666Tag(header) );
+		d->spcFile.setExtendedTag(extendedTag);
 		return;
 	}
 
-	// Do we really deal with a SPC file
-	if( !d->checkMagicHeader() )
+	// Check the header and map the file
+	MappedSpcFile file(filename);
+	if( !file.isOpen() )
 	{
 		setFailed();
 		return;
 	}
 
-	// Read SPC700 registers
-	d->readRegisters();
-
-	// Read ID666 Tag
-	d->readID666Tag();
+	d->spcFile.setProcessorRegisters( file.processorRegisters() );
+	d->spcFile.setID666Tag( file.id666Tag() );
+	d->spcFile.setExtendedTag( file.extendedTag() );
+	d->spcFile.setDspRegisters( vector<byte>(file.dspRegisters(), file.dspRegisters() + MappedSpcFile::DspRegistersSize) );
 
-	// Read RAM data
-	d->readRamData();
+	// Streamed over the mapping without a buffer, the RAM copy
+	// below then reads the pages the hash brought in cache
+	d->spcFile.setContentHash( file.contentHash() );
 
-	// Read DSP registers
-	d->readDspRegisters();
-
-	// Close file
-	d->fileLoader.close();
+	// The SpcFile is not shared yet, the setters modify it in place.
+	// This is the only copy of the RAM, from the mapping to the SpcFile.
+	d->spcFile.setRamData( file.ramData(), MappedSpcFile::RamSize );
 }
 
 bool SpcFileLoader::operator!()
@@ -115,211 +175,36 @@ void SpcFileLoader::setFailed()
 	d->failed = true;
 }
 
-SpcFile SpcFileLoader::spcFile() const
+SpcFile SpcFileLoader::spcFile() const &
 {
 	return d->spcFile;
 }
 
-bool SpcFileLoader::Private::checkMagicHeader()
+SpcFile SpcFileLoader::spcFile() &&
 {
-	char header[34];
-
-	fileLoader.get(header, 34);
-
-	lDebug() << "Read magic header:" << string(header);
-
-	if( memcmp(header,SpcMagicHeader,34) == 0 )
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	return std::move(d->spcFile);
 }
 
-void SpcFileLoader::Private::readRegisters()
+bool SpcFileLoader::readTag(const std::string &filename, ID666Tag &tag, ExtendedID666Tag *extendedTag)
 {
-	fileLoader.seekg(0x25);
-	
-	ProcessorRegisters readRegisters;
-
-	word PC;
-	byte A, X, Y, PSW, SP;
-
-	// Read PC
-	fileLoader.read( reinterpret_cast<char*>(&PC), sizeof(unsigned short) );
-	// Read A
-	fileLoader >> A;
-	// Read X
-	fileLoader >> X;
-	// Read Y
-	fileLoader >> Y;
-	// Read PSW
-	fileLoader >> PSW;
-	// Read SP
-	fileLoader >> SP;
-
-	readRegisters.setA( A );
-	readRegisters.setX( X );
-	readRegisters.setY( Y );
-	readRegisters.setProgramStatus( PSW );
-	readRegisters.setProgramCounter( PC );
-	readRegisters.setStackPointer( SP );
-
-	// Set registers to the SpcFile
-	spcFile.setProcessorRegisters( readRegisters );
-}
-
-void SpcFileLoader::Private::readRamData()
-{
-	fileLoader.seekg(0x100);
-
-	static const int ramSize = 0xFFFF;
-
-	// Reserver the vector for the whole RAM
-	std::vector<byte> readRamData;
-	readRamData.reserve(ramSize);
-
-	byte *rawReadData = new byte[ramSize];
-	fileLoader.read((char*)rawReadData, ramSize);
-
-	// Fill the vector with the raw data
-	for(int i=0; i<ramSize; i++)
+	byte header[MappedSpcFile::HeaderSize];
+	vector<byte> extendedData;
+	if( !readTags(filename, header, extendedTag ? &extendedData : 0) )
 	{
-		readRamData.push_back(rawReadData[i]);
-	}
-	// Doesn't compile
-	//readRamData.insert( rawReadData, rawReadData + sizeof(rawReadData) / sizeof(byte) );
-
-	// Set the ram data into SpcFile
-	spcFile.setRamData( readRamData );
-
-	delete[] rawReadData;
-}
-
-void SpcFileLoader::Private::readID666Tag()
-{
-	fileLoader.seekg(0x2E);
-
-	char stringBuffer[33];
-
-	ID666Tag readTag;
-
-	// Read song title
-	fileLoader.read(stringBuffer, 32);
-	readTag.songTitle = string(stringBuffer, 32);
-
-	// Read game title
-	fileLoader.read(stringBuffer, 32);
-	readTag.gameTitle = string(stringBuffer, 32);
-
-	// Read name of dumper
-	fileLoader.read(stringBuffer, 16);
-	readTag.dumperName = string(stringBuffer, 16);
-
-	// Read comments
-	fileLoader.read(stringBuffer, 32);
-	readTag.comment = string(stringBuffer, 32);
-
-	// Read date
-	fileLoader.read(stringBuffer, 11);
-	readTag.dateDumped = string(stringBuffer, 11);
-
-	// Read song length
-	string tempLength;
-	fileLoader.read(stringBuffer, 3);
-	
-	// Here we test if the first char is a digit or 0
-	// else, we are in binary mode
-	if( isdigit(stringBuffer[0]) || stringBuffer[0] == 0x00 )
-	{
-		lDebug() << "Text format";
-		tempLength = string(stringBuffer, 3);
-		lDebug() << "Song length:" << tempLength;
-		readTag.songLength = atoi(tempLength.c_str());
-	
-		// Read fadeout length
-		fileLoader.read(stringBuffer, 5);
-		tempLength = string(stringBuffer, 5);
-		lDebug() << "Fadeout length:" << tempLength;
-		readTag.fadeoutLength = atoi(tempLength.c_str());
-	}
-	else
-	{
-		lDebug() << "Binary format";
-		// Binary format
-		readTag.isBinary = true;
-		// Read date in binary
-		fileLoader.seekg(0x9E, ios_base::beg);
-		char date, month;
-		word year;
-		
-		fileLoader.get(date);
-		fileLoader.get(month);
-		fileLoader.read(reinterpret_cast<char*>(&year), sizeof(year));
-
-		lDebug() << "Date:" << (int)date;
-		lDebug() << "Month:" << (int)month;
-		lDebug() << "Year:" << year;
-		stringstream dateStringStream;
-		dateStringStream << year << "/" << (int)month << "/" << (int)date;
-		readTag.dateDumped = dateStringStream.str();
-
-		// Read song length in binary
-		fileLoader.seekg(0xA9);
-		fileLoader.read(reinterpret_cast<char*>(&readTag.songLength), sizeof(word));
-
-		// Pass padding byte of the song length
-		fileLoader.seekg(1, ios_base::cur);
-
-		// Read fadeout length in binary
-		fileLoader.read( reinterpret_cast<char *>(&readTag.fadeoutLength), 4 );
+		return false;
 	}
 
-	// Read artist name
-	fileLoader.read(stringBuffer, 32);
-	readTag.artistName = string(stringBuffer, 32);
-
-	// Read isDefaultChannelDisabled
-	char tempChannel;
-	fileLoader >> tempChannel;
-	readTag.isDefaultChannelDisabled = static_cast<bool>(tempChannel);
-
-	// Read Emulator identifier
-	char tempEmulatorIdent;
-	fileLoader >> tempEmulatorIdent;
-
-	readTag.emulatorIndex = atoi(&tempEmulatorIdent);
-
-	spcFile.setID666Tag( readTag );
-}
-
-void SpcFileLoader::Private::readDspRegisters()
-{
-	fileLoader.seekg(0x10100);
-
-	static const int dspRegistersSize = 128;
-
-	// Reserver the vector for the whole RAM
-	std::vector<byte> readDspRegisters;
-	readDspRegisters.reserve(dspRegistersSize);
-
-	byte *rawReadData = new byte[dspRegistersSize];
-	fileLoader.read((char*)rawReadData, dspRegistersSize);
-
-	// Fill the vector with the raw data
-	for(int i=0; i<dspRegistersSize; i++)
+	tag = MappedSpcFile::decodeID666Tag(header);
+	if( extendedTag )
 	{
-		readDspRegisters.push_back( rawReadData[i] );
+		*extendedTag = ExtendedID666Tag();
+		if( !extendedData.empty() )
+		{
+			ExtendedTagParser::parse(&extendedData[0], extendedData.size(), *extendedTag);
+		}
 	}
-	// Doesn't compile
-	//readRamData.insert( rawReadData, rawReadData + sizeof(rawReadData) / sizeof(byte) );
-
-	// Set the ram data into SpcFile
-	spcFile.setDspRegisters( readDspRegisters );
 
-	delete[] rawReadData;
+	return true;
 }
 
 }
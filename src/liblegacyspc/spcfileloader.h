@@ -24,6 +24,8 @@ namespace LegacySPC
 {
 
 class SpcFile;
+struct ExtendedID666Tag;
+struct ID666Tag;
 
 /**
  * @brief Load a SPC file from disk
@@ -37,11 +39,26 @@ if( !spcLoader )
 SpcFile file = spcLoader.spcFile();
  * @endcode
  *
+ * To index a library, only the header needs to be read, use
+ * the TagOnly mode or readTag().
+ *
+ * A full load also hashes the emulation state, see
+ * SpcFile::contentHash(). The TagOnly mode leaves the hash to 0.
+ *
  * @author Michaël Larouche <larouche@kde.org>
  */
 class LEGACYSPC_EXPORT SpcFileLoader
 {
 public:
+	/**
+	 * @brief What to read from the file
+	 */
+	enum LoadMode
+	{
+		FullLoad, ///< Everything, the SpcFile can be run
+		TagOnly ///< The header and the xid6 chunk only: CPU registers and tags, without RAM or DSP registers
+	};
+
 	/**
 	 * @brief Create a new instance of SpcFileLoader.
 	 *
@@ -53,8 +70,9 @@ public:
 	 *
 	 * With this constructor, you don't need to call open().
 	 * @param filename SPC file to open
+	 * @param mode What to read from the file
 	 */
-	SpcFileLoader(const std::string &filename);
+	SpcFileLoader(const std::string &filename, LoadMode mode = FullLoad);
 
 	/**
 	 * @brief Destructor
@@ -64,8 +82,9 @@ public:
 	/**
 	 * @brief Open and read the SPC file content
 	 * @param file SPC File to open
+	 * @param mode What to read from the file
 	 */
-	void open(const std::string &filename);
+	void open(const std::string &filename, LoadMode mode = FullLoad);
 
 	/**
 	 * @brief Check if the file loading failed
@@ -75,9 +94,31 @@ public:
 
 	/**
 	 * @brief Get the SpcFile with the data loaded from the file
+	 * @return SpcFile instance, sharing its data with the loader
+	 */
+	SpcFile spcFile() const &;
+
+	/**
+	 * @brief Take the SpcFile out of a temporary loader
+	 *
+	 * Used for SpcFileLoader(filename).spcFile() and
+	 * std::move(loader).spcFile(), the data is moved, not shared.
 	 * @return SpcFile instance
 	 */
-	SpcFile spcFile() const;
+	SpcFile spcFile() &&;
+
+	/**
+	 * @brief Read only the tags of a SPC file
+	 *
+	 * The header is read with a single read, and the xid6 chunk
+	 * with a second one when asked for and present. The RAM is
+	 * never touched. Safe to call from many threads at once.
+	 * @param filename SPC file to read
+	 * @param tag Receives the tag
+	 * @param extendedTag Receives the extended tag, can be null
+	 * @return false if the file can't be read or is not a SPC file
+	 */
+	static bool readTag(const std::string &filename, ID666Tag &tag, ExtendedID666Tag *extendedTag = 0);
 
 private:
 	/**
@@ -16,9 +16,11 @@
 
 // LegacySPC includes
 #include "spcfile.h"
-#include "spcfileloader.h"
+#include "mappedspcfile.h"
 #include "spccomponentmanager.h"
 #include "processor.h"
+#include "dsp.h"
+#include "ram.h"
 #include "memorymap.h"
 #include "spcrunner.h"
 
@@ -32,9 +34,31 @@ public:
 	 : componentManager(0)
 	{}
 
+	void load(const ProcessorRegisters &registers, const byte *ramData, size_t ramSize,
+	          const byte *dspRegisters, size_t dspRegisterCount);
+
 	SpcComponentManager *componentManager;
 };
 
+void SpcFileMemoryLoader::Private::load(const ProcessorRegisters &registers, const byte *ramData, size_t ramSize,
+                                        const byte *dspRegisters, size_t dspRegisterCount)
+{
+	// Load CPU registers
+	componentManager->processor()->registers()->loadRegisters( registers );
+
+	// Load RAM data, directly in Ram so the I/O registers
+	// don't react to the bytes written.
+	componentManager->ram()->loadRam( ramData, ramSize );
+
+	// Load DSP registers
+	componentManager->dsp()->loadRegisters( dspRegisters, dspRegisterCount );
+
+	// Restart the time and load the timers and ports from RAM
+	componentManager->processor()->setCycles(0);
+	componentManager->processor()->setHalted(false);
+	componentManager->runner()->memory()->loadIoRegisters();
+}
+
 SpcFileMemoryLoader::SpcFileMemoryLoader(SpcComponentManager *manager)
  : d(new Private)
 {
@@ -53,21 +77,43 @@ SpcComponentManager* SpcFileMemoryLoader::component() const
 
 bool SpcFileMemoryLoader::loadSpcFile(const std::string &filename)
 {
-	SpcFileLoader loader(filename);
-	if( !loader )
+	MappedSpcFile file(filename);
+	if( !file.isOpen() )
 	{
 		return false;
 	}
 
-	SpcFile fileToLoad = loader.spcFile();
+	return loadSpcFile(file);
+}
 
-	// Load CPU registers
-	component()->processor()->registers()->loadRegisters( fileToLoad.processorRegisters() );
+bool SpcFileMemoryLoader::loadSpcFile(const SpcFile &fileToLoad)
+{
+	const std::vector<byte> &ramData = fileToLoad.ramData();
+	const std::vector<byte> &dspRegisters = fileToLoad.dspRegisters();
 
-	// Load RAM data FIXME: Use MemoryMap or Ram directly ?
-	component()->runner()->memory()->writeBytes( 0, fileToLoad.ramData() );
+	// Files read with only their tag have no RAM to run
+	if( ramData.size() != MappedSpcFile::RamSize || dspRegisters.size() != MappedSpcFile::DspRegistersSize )
+	{
+		return false;
+	}
+
+	d->load( fileToLoad.processorRegisters(),
+	         &ramData[0], ramData.size(),
+	         &dspRegisters[0], dspRegisters.size() );
+
+	return true;
+}
+
+bool SpcFileMemoryLoader::loadSpcFile(const MappedSpcFile &file)
+{
+	if( !file.isOpen() )
+	{
+		return false;
+	}
 
-	// TODO: Load DSP registers
+	d->load( file.processorRegisters(),
+	         file.ramData(), MappedSpcFile::RamSize,
+	         file.dspRegisters(), MappedSpcFile::DspRegistersSize );
 
 	return true;
 }
@@ -20,7 +20,9 @@
 namespace LegacySPC
 {
 
+class MappedSpcFile;
 class SpcComponentManager;
+class SpcFile;
 
 /**
  * @brief Load a SpcFile into memory
@@ -47,6 +49,21 @@ public:
 	 */
 	bool loadSpcFile(const std::string &filename);
 
+	/**
+	 * @brief Load an already read SPC file in memory
+	 * @param file SpcFile to load
+	 * @return false if the file has no complete RAM and DSP registers, like a tag only file
+	 */
+	bool loadSpcFile(const SpcFile &file);
+
+	/**
+	 * @brief Load a mapped SPC file in memory
+	 *
+	 * The RAM is copied straight from the mapping.
+	 * @param file Mapped SPC file to load
+	 */
+	bool loadSpcFile(const MappedSpcFile &file);
+
 private:
 	/**
 	 * @internal
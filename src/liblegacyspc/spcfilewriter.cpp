@@ -0,0 +1,200 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "spcfilewriter.h"
+
+// STL includes
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+// LegacySPC includes
+#include "dsp.h"
+#include "mappedspcfile.h"
+#include "spcfile.h"
+#include "spcrunner.h"
+#include "spcstate.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+static const char SpcMagicHeader[] = "SNES-SPC700 Sound File Data v0.30";
+
+// Offsets in the header
+enum HeaderOffsets
+{
+	TagTypeOffset = 0x23,
+	MinorVersionOffset = 0x24,
+	ProgramCounterOffset = 0x25,
+	ARegisterOffset = 0x27,
+	XRegisterOffset = 0x28,
+	YRegisterOffset = 0x29,
+	ProgramStatusOffset = 0x2A,
+	StackPointerOffset = 0x2B
+};
+
+// I/O registers in RAM
+enum IoRegisters
+{
+	ControlRegister = 0xF1,
+	Port0Register = 0xF4,
+	Timer0TargetRegister = 0xFA,
+	Counter0Register = 0xFD,
+	ExtraRamAddress = 0xFFC0
+};
+
+// Copy a string in a fixed-size field padded with nulls
+static void writeString(std::vector<byte> &data, int offset, int size, const std::string &text)
+{
+	memcpy(&data[offset], text.c_str(), text.size() < static_cast<size_t>(size) ? text.size() : size);
+}
+
+static std::string toString(int value)
+{
+	std::stringstream stream;
+	stream << value;
+	return stream.str();
+}
+
+// Write a number in a text field, clamped to the digits the field holds
+static void writeNumber(std::vector<byte> &data, int offset, int size, int value)
+{
+	int maximum = 9;
+	for(int i = 1; i < size; i++)
+	{
+		maximum = maximum * 10 + 9;
+	}
+
+	writeString(data, offset, size, toString(value < maximum ? value : maximum));
+}
+
+class SpcFileWriter::Private
+{
+public:
+	ID666Tag tag;
+};
+
+SpcFileWriter::SpcFileWriter()
+ : d(new Private)
+{
+}
+
+SpcFileWriter::~SpcFileWriter()
+{
+	delete d;
+}
+
+void SpcFileWriter::setID666Tag(const ID666Tag &tag)
+{
+	d->tag = tag;
+}
+
+bool SpcFileWriter::write(const std::string &filename, const SpcRunner &runner) const
+{
+	// Too large for the stack
+	std::unique_ptr<SpcState> state(new SpcState);
+	runner.saveState(*state);
+
+	return write(filename, *state);
+}
+
+bool SpcFileWriter::write(const std::string &filename, const SpcState &state) const
+{
+	lDebug() << "Writing SPC file" << filename;
+
+	std::vector<byte> data = encode(state, d->tag);
+
+	std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+	file.close();
+
+	return !file.fail();
+}
+
+std::vector<byte> SpcFileWriter::encode(const SpcState &state, const ID666Tag &tag)
+{
+	std::vector<byte> data(MappedSpcFile::ExtendedTagOffset, 0);
+
+	memcpy(&data[0], SpcMagicHeader, sizeof(SpcMagicHeader) - 1);
+	data[0x21] = 26;
+	data[0x22] = 26;
+	// 26 when the header has an ID666 tag
+	data[TagTypeOffset] = 26;
+	data[MinorVersionOffset] = 30;
+
+	data[ProgramCounterOffset] = state.processor.programCounter & 0xFF;
+	data[ProgramCounterOffset + 1] = state.processor.programCounter >> 8;
+	data[ARegisterOffset] = state.processor.a;
+	data[XRegisterOffset] = state.processor.x;
+	data[YRegisterOffset] = state.processor.y;
+	data[ProgramStatusOffset] = state.processor.programStatus;
+	data[StackPointerOffset] = state.processor.stackPointer;
+
+	// Text tag
+	writeString(data, 0x2E, 32, tag.songTitle);
+	writeString(data, 0x4E, 32, tag.gameTitle);
+	writeString(data, 0x6E, 16, tag.dumperName);
+	writeString(data, 0x7E, 32, tag.comment);
+	writeString(data, 0x9E, 11, tag.dateDumped);
+	if( tag.songLength > 0 )
+	{
+		writeNumber(data, 0xA9, 3, tag.songLength);
+	}
+	if( tag.fadeoutLength > 0 )
+	{
+		writeNumber(data, 0xAC, 5, tag.fadeoutLength);
+	}
+	writeString(data, 0xB1, 32, tag.artistName);
+	data[0xD1] = tag.isDefaultChannelDisabled ? 1 : 0;
+	data[0xD2] = static_cast<byte>('0' + tag.emulatorIndex);
+
+	// The I/O registers hold the state the loader reads back
+	byte *ram = &data[MappedSpcFile::RamOffset];
+	memcpy(ram, state.ram, MappedSpcFile::RamSize);
+
+	byte control = ram[ControlRegister] & ~0x07;
+	for(int i = 0; i < 3; i++)
+	{
+		const TimerState &timer = state.io.timers[i];
+		if( timer.enabled )
+		{
+			control |= 1 << i;
+		}
+		ram[Timer0TargetRegister + i] = timer.target;
+		// Only 4 bits are used, keep the others as loaded
+		ram[Counter0Register + i] = (ram[Counter0Register + i] & 0xF0) | (timer.counter & 0x0F);
+	}
+	ram[ControlRegister] = control;
+	memcpy(ram + Port0Register, state.io.inputPorts, sizeof(state.io.inputPorts));
+
+	// As seen by the CPU, the pending writes included, except the
+	// registers the DSP updates itself which are only current in
+	// the live registers
+	byte *dspRegisters = &data[MappedSpcFile::DspRegistersOffset];
+	memcpy(dspRegisters, state.dsp.writtenRegisters, MappedSpcFile::DspRegistersSize);
+	for(int voice = 0; voice < Dsp::VoiceCount; voice++)
+	{
+		dspRegisters[(voice << 4) + Dsp::EnvelopeX] = state.dsp.registers[(voice << 4) + Dsp::EnvelopeX];
+		dspRegisters[(voice << 4) + Dsp::OutputX] = state.dsp.registers[(voice << 4) + Dsp::OutputX];
+	}
+	dspRegisters[Dsp::EndX] = state.dsp.registers[Dsp::EndX];
+
+	memcpy(&data[MappedSpcFile::ExtraRamOffset], state.ram + ExtraRamAddress, MappedSpcFile::ExtraRamSize);
+
+	return data;
+}
+
+}
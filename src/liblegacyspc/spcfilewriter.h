@@ -0,0 +1,109 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SPCFILEWRITER_H
+#define LEGACYSPC_SPCFILEWRITER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+namespace LegacySPC
+{
+
+class SpcRunner;
+struct ID666Tag;
+struct SpcState;
+
+/**
+ * @brief Write the state of a SpcRunner to a SPC file
+ *
+ * The file is a standard SPC file with a text ID666 tag, any
+ * player can load it. The CPU registers, the RAM and the DSP
+ * registers as seen by the CPU are saved, and the timers and the
+ * ports are stored in their I/O registers like a dump would.
+ *
+ * The internal state of the DSP voices and the timer dividers have
+ * no place in a SPC file, so a written file restarts the song from
+ * the saved point, close but not equal to the running song. Use
+ * SpcStateFile to save the exact state.
+ *
+ * @code
+LegacySPC::SpcFileWriter writer;
+writer.setID666Tag(tag);
+if( !writer.write("checkpoint.spc", runner) )
+{
+	std::cerr << "Can't write checkpoint.spc" << std::endl;
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SpcFileWriter
+{
+public:
+	/**
+	 * @brief Create a new instance of SpcFileWriter, with an empty tag
+	 */
+	SpcFileWriter();
+	/**
+	 * @brief Destructor
+	 */
+	~SpcFileWriter();
+
+	/**
+	 * @brief Set the tag written in the files
+	 * @param tag ID666 tag, written in text format. The lengths
+	 * are clamped to 999 seconds and 99999 milliseconds.
+	 */
+	void setID666Tag(const ID666Tag &tag);
+
+	/**
+	 * @brief Write the current state of a runner
+	 * @param filename Path of the SPC file
+	 * @param runner Runner to save
+	 * @return false if the file can't be written
+	 */
+	bool write(const std::string &filename, const SpcRunner &runner) const;
+
+	/**
+	 * @brief Write a saved state
+	 * @param filename Path of the SPC file
+	 * @param state State to save
+	 * @return false if the file can't be written
+	 */
+	bool write(const std::string &filename, const SpcState &state) const;
+
+	/**
+	 * @brief Build the content of a SPC file
+	 * @param state State to save
+	 * @param tag ID666 tag of the file
+	 * @return File content, MappedSpcFile::ExtendedTagOffset bytes
+	 */
+	static std::vector<byte> encode(const SpcState &state, const ID666Tag &tag);
+
+private:
+	SpcFileWriter(const SpcFileWriter &);
+	SpcFileWriter &operator=(const SpcFileWriter &);
+
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,630 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "spcindex.h"
+
+// STL includes
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEGACYSPC_HAVE_MMAP
+#endif
+
+// LegacySPC includes
+#include "mappedspcfile.h"
+#include "spcfile.h"
+#include "threadpool.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+static const char IndexMagic[] = "LSPCINDX";
+
+/*
+ * Index file, all the numbers are little-endian:
+ *
+ * Header: magic, version, record count, pool offset and pool size,
+ * then 8 reserved bytes.
+ * Records: content hash, then the pool offsets of the path, song
+ * title, game title and artist name, then the song and fadeout
+ * lengths in milliseconds.
+ * Pool: null terminated strings, an empty string first.
+ */
+enum IndexLayout
+{
+	IndexVersion = 1,
+	IndexHeaderSize = 32,
+	VersionOffset = 8,
+	CountOffset = 12,
+	PoolOffsetOffset = 16,
+	PoolSizeOffset = 20,
+	RecordSize = 32,
+	PathOffset = 8,
+	SongTitleOffset = 12,
+	GameTitleOffset = 16,
+	ArtistNameOffset = 20,
+	SongLengthOffset = 24,
+	FadeoutLengthOffset = 28
+};
+
+static unsigned int read32(const byte *data)
+{
+	return data[0] | data[1] << 8 | data[2] << 16 | static_cast<unsigned int>(data[3]) << 24;
+}
+
+static unsigned long long read64(const byte *data)
+{
+	return read32(data) | static_cast<unsigned long long>( read32(data + 4) ) << 32;
+}
+
+static void write32(std::vector<char> &buffer, size_t offset, unsigned int value)
+{
+	for(int i = 0; i < 4; i++)
+	{
+		buffer[offset + i] = static_cast<char>(value >> (i * 8));
+	}
+}
+
+static void write64(std::vector<char> &buffer, size_t offset, unsigned long long value)
+{
+	write32(buffer, offset, static_cast<unsigned int>(value));
+	write32(buffer, offset + 4, static_cast<unsigned int>(value >> 32));
+}
+
+// The ID666 fields are padded with nulls or spaces
+static std::string trimmed(const std::string &text)
+{
+	std::string result( text.c_str() );
+	std::string::size_type end = result.find_last_not_of(' ');
+	result.erase(end == std::string::npos ? 0 : end + 1);
+	return result;
+}
+
+// needle is already lower case
+static bool containsText(const char *haystack, const std::string &needle)
+{
+	for(; *haystack; haystack++)
+	{
+		size_t i = 0;
+		while( i < needle.size() && haystack[i] && tolower( static_cast<unsigned char>(haystack[i]) ) == needle[i] )
+		{
+			i++;
+		}
+		if( i == needle.size() )
+		{
+			return true;
+		}
+	}
+
+	return needle.empty();
+}
+
+static bool hasSpcExtension(const std::string &name)
+{
+	if( name.size() < 4 )
+	{
+		return false;
+	}
+
+	std::string extension = name.substr(name.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".spc";
+}
+
+/**
+ * @internal
+ * @brief Tags of a file being indexed
+ */
+struct IndexedFile
+{
+	IndexedFile()
+	 : valid(false), contentHash(0), songLength(0), fadeoutLength(0)
+	{}
+
+	bool valid;
+	unsigned long long contentHash;
+	std::string path;
+	std::string songTitle;
+	std::string gameTitle;
+	std::string artistName;
+	int songLength;
+	int fadeoutLength;
+
+	bool operator<(const IndexedFile &other) const
+	{
+		return contentHash < other.contentHash || (contentHash == other.contentHash && path < other.path);
+	}
+};
+
+static void indexFile(const std::string &path, IndexedFile &result)
+{
+	MappedSpcFile file(path);
+	if( !file.isOpen() )
+	{
+		return;
+	}
+
+	ID666Tag tag = file.id666Tag();
+	ExtendedID666Tag extendedTag = file.extendedTag();
+
+	result.valid = true;
+	result.contentHash = file.contentHash();
+	result.path = path;
+	result.songTitle = trimmed( extendedTag.songTitle.empty() ? tag.songTitle : extendedTag.songTitle );
+	result.gameTitle = trimmed( extendedTag.gameTitle.empty() ? tag.gameTitle : extendedTag.gameTitle );
+	result.artistName = trimmed( extendedTag.artistName.empty() ? tag.artistName : extendedTag.artistName );
+
+	// In milliseconds, the xid6 tag counts ticks
+	const int ticksPerMillisecond = ExtendedID666Tag::TicksPerSecond / 1000;
+	result.songLength = extendedTag.playLength() > 0 ? static_cast<int>( extendedTag.playLength() / ticksPerMillisecond ) : tag.songLength * 1000;
+	result.fadeoutLength = extendedTag.fadeLength > 0 ? extendedTag.fadeLength / ticksPerMillisecond : tag.fadeoutLength;
+}
+
+/**
+ * @internal
+ * @brief Strings of the index, each distinct string stored once
+ */
+class StringPool
+{
+public:
+	StringPool()
+	 : data(1, '\0')
+	{
+		offsets[std::string()] = 0;
+	}
+
+	unsigned int add(const std::string &text)
+	{
+		std::map<std::string, unsigned int>::iterator it = offsets.find(text);
+		if( it != offsets.end() )
+		{
+			return it->second;
+		}
+
+		unsigned int offset = static_cast<unsigned int>( data.size() );
+		data.insert(data.end(), text.begin(), text.end());
+		data.push_back('\0');
+		offsets[text] = offset;
+		return offset;
+	}
+
+	std::vector<char> data;
+
+private:
+	std::map<std::string, unsigned int> offsets;
+};
+
+class SpcIndex::Private
+{
+public:
+	Private()
+	 : data(0), size(0), count(0), pool(0), poolSize(0)
+	{}
+
+	const byte *record(int index) const
+	{
+		return data + IndexHeaderSize + static_cast<size_t>(index) * RecordSize;
+	}
+
+	const char *string(const byte *record, int offset) const
+	{
+		unsigned int poolOffset = read32(record + offset);
+		return poolOffset < poolSize ? pool + poolOffset : "";
+	}
+
+	const byte *data;
+	size_t size;
+	int count;
+	const char *pool;
+	size_t poolSize;
+#ifndef LEGACYSPC_HAVE_MMAP
+	std::vector<byte> buffer;
+#endif
+};
+
+SpcIndex::SpcIndex()
+ : d(new Private)
+{
+}
+
+SpcIndex::SpcIndex(const std::string &filename)
+ : d(new Private)
+{
+	open(filename);
+}
+
+SpcIndex::~SpcIndex()
+{
+	close();
+	delete d;
+}
+
+bool SpcIndex::open(const std::string &filename)
+{
+	close();
+
+	lDebug() << "Mapping index" << filename;
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	int descriptor = ::open(filename.c_str(), O_RDONLY);
+	if( descriptor < 0 )
+	{
+		return false;
+	}
+
+	struct stat status;
+	if( fstat(descriptor, &status) != 0 || status.st_size < IndexHeaderSize )
+	{
+		::close(descriptor);
+		return false;
+	}
+
+	void *mapping = mmap(0, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+	::close(descriptor);
+	if( mapping == MAP_FAILED )
+	{
+		return false;
+	}
+
+	d->data = static_cast<const byte*>(mapping);
+	d->size = status.st_size;
+#else
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if( !file )
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	if( fileSize < IndexHeaderSize )
+	{
+		return false;
+	}
+
+	d->buffer.resize( static_cast<size_t>(fileSize) );
+	file.seekg(0, std::ios::beg);
+	if( !file.read(reinterpret_cast<char*>(&d->buffer[0]), fileSize) )
+	{
+		d->buffer.clear();
+		return false;
+	}
+
+	d->data = &d->buffer[0];
+	d->size = d->buffer.size();
+#endif
+
+	size_t count = read32(d->data + CountOffset);
+	size_t poolOffset = read32(d->data + PoolOffsetOffset);
+	size_t poolSize = read32(d->data + PoolSizeOffset);
+
+	// The pool must end with a null, so every string ends in the mapping
+	if( memcmp(d->data, IndexMagic, 8) != 0 || read32(d->data + VersionOffset) != IndexVersion ||
+	    poolOffset < IndexHeaderSize + count * RecordSize || poolSize == 0 ||
+	    poolOffset > d->size || poolSize > d->size - poolOffset || d->data[poolOffset + poolSize - 1] != 0 )
+	{
+		close();
+		return false;
+	}
+
+	d->count = static_cast<int>(count);
+	d->pool = reinterpret_cast<const char*>(d->data + poolOffset);
+	d->poolSize = poolSize;
+
+	return true;
+}
+
+void SpcIndex::close()
+{
+	if( !d->data )
+	{
+		return;
+	}
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	munmap(const_cast<byte*>(d->data), d->size);
+#else
+	std::vector<byte>().swap(d->buffer);
+#endif
+
+	d->data = 0;
+	d->size = 0;
+	d->count = 0;
+	d->pool = 0;
+	d->poolSize = 0;
+}
+
+bool SpcIndex::isOpen() const
+{
+	return d->data != 0;
+}
+
+int SpcIndex::count() const
+{
+	return d->count;
+}
+
+SpcIndexEntry SpcIndex::entry(int index) const
+{
+	SpcIndexEntry entry;
+	if( index < 0 || index >= d->count )
+	{
+		return entry;
+	}
+
+	const byte *record = d->record(index);
+	entry.contentHash = read64(record);
+	entry.path = d->string(record, PathOffset);
+	entry.songTitle = d->string(record, SongTitleOffset);
+	entry.gameTitle = d->string(record, GameTitleOffset);
+	entry.artistName = d->string(record, ArtistNameOffset);
+	entry.songLength = static_cast<int>( read32(record + SongLengthOffset) );
+	entry.fadeoutLength = static_cast<int>( read32(record + FadeoutLengthOffset) );
+
+	return entry;
+}
+
+int SpcIndex::find(unsigned long long contentHash) const
+{
+	// First record with a hash not lower than contentHash
+	int low = 0;
+	int high = d->count;
+	while( low < high )
+	{
+		int middle = low + (high - low) / 2;
+		if( read64( d->record(middle) ) < contentHash )
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low < d->count && read64( d->record(low) ) == contentHash ? low : -1;
+}
+
+std::vector<int> SpcIndex::search(const std::string &text) const
+{
+	std::string needle = text;
+	std::transform(needle.begin(), needle.end(), needle.begin(), ::tolower);
+
+	// Each distinct string is compared once, then the records only
+	// check if their strings matched
+	std::vector<bool> matched(d->poolSize, false);
+	for(size_t offset = 0; offset < d->poolSize; offset += strlen(d->pool + offset) + 1)
+	{
+		matched[offset] = containsText(d->pool + offset, needle);
+	}
+
+	std::vector<int> found;
+	for(int i = 0; i < d->count; i++)
+	{
+		const byte *record = d->record(i);
+		const int offsets[] = { SongTitleOffset, GameTitleOffset, ArtistNameOffset };
+		for(int j = 0; j < 3; j++)
+		{
+			unsigned int poolOffset = read32(record + offsets[j]);
+			if( poolOffset < d->poolSize && matched[poolOffset] )
+			{
+				found.push_back(i);
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+int SpcIndex::build(const std::vector<std::string> &files, const std::string &filename, int threadCount)
+{
+	// Each task writes only its own result
+	std::vector<IndexedFile> indexed(files.size());
+	{
+		ThreadPool pool(threadCount);
+		for(size_t i = 0; i < files.size(); i++)
+		{
+			const std::string *path = &files[i];
+			IndexedFile *result = &indexed[i];
+			pool.submit( [path, result]() { indexFile(*path, *result); } );
+		}
+		pool.wait();
+	}
+
+	indexed.erase( std::remove_if(indexed.begin(), indexed.end(), [](const IndexedFile &file) { return !file.valid; }), indexed.end() );
+	std::sort(indexed.begin(), indexed.end());
+
+	StringPool strings;
+	std::vector<char> buffer(IndexHeaderSize + indexed.size() * RecordSize, '\0');
+	for(size_t i = 0; i < indexed.size(); i++)
+	{
+		const IndexedFile &file = indexed[i];
+		size_t record = IndexHeaderSize + i * RecordSize;
+
+		write64(buffer, record, file.contentHash);
+		write32(buffer, record + PathOffset, strings.add(file.path));
+		write32(buffer, record + SongTitleOffset, strings.add(file.songTitle));
+		write32(buffer, record + GameTitleOffset, strings.add(file.gameTitle));
+		write32(buffer, record + ArtistNameOffset, strings.add(file.artistName));
+		write32(buffer, record + SongLengthOffset, file.songLength);
+		write32(buffer, record + FadeoutLengthOffset, file.fadeoutLength);
+	}
+
+	memcpy(&buffer[0], IndexMagic, 8);
+	write32(buffer, VersionOffset, IndexVersion);
+	write32(buffer, CountOffset, static_cast<unsigned int>( indexed.size() ));
+	write32(buffer, PoolOffsetOffset, static_cast<unsigned int>( buffer.size() ));
+	write32(buffer, PoolSizeOffset, static_cast<unsigned int>( strings.data.size() ));
+	buffer.insert(buffer.end(), strings.data.begin(), strings.data.end());
+
+	std::string temporaryFilename = filename + ".tmp";
+	{
+		std::ofstream file(temporaryFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if( !file.write(&buffer[0], buffer.size()) || !file.flush() )
+		{
+			file.close();
+			std::remove( temporaryFilename.c_str() );
+			return -1;
+		}
+	}
+
+#if defined(_WIN32) || defined(_WIN64)
+	std::remove( filename.c_str() );
+#endif
+	if( std::rename(temporaryFilename.c_str(), filename.c_str()) != 0 )
+	{
+		std::remove( temporaryFilename.c_str() );
+		return -1;
+	}
+
+	return static_cast<int>( indexed.size() );
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static void findFiles(const std::string &directory, std::vector<std::string> &files)
+{
+	WIN32_FIND_DATAA findData;
+	HANDLE handle = FindFirstFileA( (directory + "\\*").c_str(), &findData );
+	if( handle == INVALID_HANDLE_VALUE )
+	{
+		return;
+	}
+
+	do
+	{
+		std::string name = findData.cFileName;
+		if( name == "." || name == ".." )
+		{
+			continue;
+		}
+
+		if( findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+		{
+			findFiles(directory + "\\" + name, files);
+		}
+		else if( hasSpcExtension(name) )
+		{
+			files.push_back(directory + "\\" + name);
+		}
+	}
+	while( FindNextFileA(handle, &findData) );
+
+	FindClose(handle);
+}
+
+std::vector<std::string> SpcIndex::findSpcFiles(const std::string &path)
+{
+	std::vector<std::string> files;
+
+	DWORD attributes = GetFileAttributesA( path.c_str() );
+	if( attributes == INVALID_FILE_ATTRIBUTES )
+	{
+		return files;
+	}
+
+	if( attributes & FILE_ATTRIBUTE_DIRECTORY )
+	{
+		findFiles(path, files);
+		std::sort(files.begin(), files.end());
+	}
+	else
+	{
+		files.push_back(path);
+	}
+
+	return files;
+}
+#else
+static void findFiles(const std::string &directory, std::vector<std::string> &files)
+{
+	DIR *handle = opendir( directory.c_str() );
+	if( !handle )
+	{
+		return;
+	}
+
+	while( struct dirent *item = readdir(handle) )
+	{
+		std::string name = item->d_name;
+		if( name == "." || name == ".." )
+		{
+			continue;
+		}
+
+		std::string path = directory + "/" + name;
+		// Symbolic links to directories are not followed, they can loop
+		struct stat status;
+		if( lstat(path.c_str(), &status) != 0 )
+		{
+			continue;
+		}
+
+		if( S_ISDIR(status.st_mode) )
+		{
+			findFiles(path, files);
+		}
+		else if( hasSpcExtension(name) && (S_ISREG(status.st_mode) ||
+		         (S_ISLNK(status.st_mode) && stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode))) )
+		{
+			files.push_back(path);
+		}
+	}
+
+	closedir(handle);
+}
+
+std::vector<std::string> SpcIndex::findSpcFiles(const std::string &path)
+{
+	std::vector<std::string> files;
+
+	struct stat status;
+	if( stat(path.c_str(), &status) != 0 )
+	{
+		return files;
+	}
+
+	if( S_ISDIR(status.st_mode) )
+	{
+		std::string directory = path;
+		while( directory.size() > 1 && directory[directory.size() - 1] == '/' )
+		{
+			directory.erase(directory.size() - 1);
+		}
+		findFiles(directory, files);
+		std::sort(files.begin(), files.end());
+	}
+	else
+	{
+		files.push_back(path);
+	}
+
+	return files;
+}
+#endif
+
+}
@@ -0,0 +1,189 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SPCINDEX_H
+#define LEGACYSPC_SPCINDEX_H
+
+#include <legacyspc_export.h>
+
+// STL includes
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief A SPC file of an index
+ *
+ * The strings point into the mapped index, they stay valid
+ * until the SpcIndex is closed.
+ */
+struct SpcIndexEntry
+{
+	SpcIndexEntry()
+	 : contentHash(0), path(""), songTitle(""), gameTitle(""), artistName(""),
+	   songLength(0), fadeoutLength(0)
+	{}
+
+	/**
+	 * @brief Hash of the emulation state, see MappedSpcFile::contentHash()
+	 */
+	unsigned long long contentHash;
+	/**
+	 * @brief Path of the SPC file, as given to build()
+	 */
+	const char *path;
+	const char *songTitle;
+	const char *gameTitle;
+	const char *artistName;
+	/**
+	 * @brief Milliseconds to play before the fadeout, 0 if unknown
+	 */
+	int songLength;
+	/**
+	 * @brief Fadeout in milliseconds, 0 if unknown
+	 */
+	int fadeoutLength;
+};
+
+/**
+ * @brief Index of a SPC library
+ *
+ * build() reads the tags of many SPC files in parallel and writes
+ * an index file. The index has fixed-size records sorted by content
+ * hash, and a pool of the strings, each distinct title, game and
+ * artist stored once.
+ *
+ * The index file is mapped read-only when opened, nothing is parsed:
+ * entry() reads a record in place, find() is a binary search on the
+ * hashes and search() scans the pool once, then the records.
+ *
+ * Titles come from the xid6 tag when present, its strings are not
+ * cut to 32 characters, else from the ID666 tag.
+ *
+ * @code
+LegacySPC::SpcIndex::build( LegacySPC::SpcIndex::findSpcFiles("music/"), "music.idx" );
+
+LegacySPC::SpcIndex index("music.idx");
+std::vector<int> found = index.search("kong");
+for(size_t i = 0; i < found.size(); i++)
+{
+	std::cout << index.entry(found[i]).path << std::endl;
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SpcIndex
+{
+public:
+	/**
+	 * @brief Create a new instance of SpcIndex
+	 *
+	 * To map an index file, use open().
+	 */
+	SpcIndex();
+	/**
+	 * @brief Create a SpcIndex and map the index file
+	 * @param filename Index file to map
+	 */
+	SpcIndex(const std::string &filename);
+	/**
+	 * @brief Destructor, unmap the index file
+	 */
+	~SpcIndex();
+
+	/**
+	 * @brief Map an index file
+	 *
+	 * The previous index is closed first.
+	 * @param filename Index file to map
+	 * @return false if the file can't be read or is not a valid index
+	 */
+	bool open(const std::string &filename);
+
+	/**
+	 * @brief Unmap the index file, the entries become invalid
+	 */
+	void close();
+
+	/**
+	 * @brief Check if an index file is mapped
+	 * @return true if open() succeeded
+	 */
+	bool isOpen() const;
+
+	/**
+	 * @brief Get the number of SPC files in the index
+	 * @return Entry count
+	 */
+	int count() const;
+
+	/**
+	 * @brief Get an entry
+	 * @param index Entry index, from 0 to count() - 1
+	 * @return Entry, the entries are sorted by content hash
+	 */
+	SpcIndexEntry entry(int index) const;
+
+	/**
+	 * @brief Find the entries of a content hash
+	 *
+	 * The entries with the same hash follow each other.
+	 * @param contentHash Hash to find
+	 * @return Index of the first entry with this hash, -1 if none
+	 */
+	int find(unsigned long long contentHash) const;
+
+	/**
+	 * @brief Find the entries with a title, game or artist containing a text
+	 * @param text Text to find, ASCII letters are compared case-insensitively
+	 * @return Entry indexes, in order
+	 */
+	std::vector<int> search(const std::string &text) const;
+
+	/**
+	 * @brief Index SPC files and write the index file
+	 *
+	 * The files which are not SPC files are skipped. The index file
+	 * is written next to the destination and renamed over it, so an
+	 * index mapped by another process stays valid.
+	 * @param files SPC files to index
+	 * @param filename Index file to write
+	 * @param threadCount Number of threads reading the files, 0 for one per core
+	 * @return Number of indexed files, -1 if the index can't be written
+	 */
+	static int build(const std::vector<std::string> &files, const std::string &filename, int threadCount = 0);
+
+	/**
+	 * @brief Find the SPC files of a directory tree
+	 * @param path Directory walked recursively, or a single file
+	 * @return Paths of the files with a .spc extension, sorted
+	 */
+	static std::vector<std::string> findSpcFiles(const std::string &path);
+
+private:
+	// Not copyable, the mapping has a single owner
+	SpcIndex(const SpcIndex &);
+	SpcIndex &operator=(const SpcIndex &);
+
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
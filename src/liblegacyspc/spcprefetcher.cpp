@@ -0,0 +1,164 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "spcprefetcher.h"
+
+// STL includes
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+// LegacySPC includes
+#include "spcfile.h"
+#include "spcfileloader.h"
+#include "spcrunner.h"
+#include "threadpool.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+class SpcLoadHandle::Private
+{
+public:
+	Private()
+	 : status(Pending), runner(0)
+	{}
+
+	void finish(Status result)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Released after the runner and the file, for status()
+		status.store(result, std::memory_order_release);
+		finished.notify_all();
+	}
+
+	std::atomic<int> status;
+	SpcRunner *runner;
+	std::string filename;
+	SpcFile file;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+
+SpcLoadHandle::SpcLoadHandle()
+{
+}
+
+SpcLoadHandle::Status SpcLoadHandle::status() const
+{
+	if( !d )
+	{
+		return Invalid;
+	}
+
+	return static_cast<Status>( d->status.load(std::memory_order_acquire) );
+}
+
+bool SpcLoadHandle::isReady() const
+{
+	Status current = status();
+	return current == Loaded || current == Failed;
+}
+
+bool SpcLoadHandle::wait() const
+{
+	if( !d )
+	{
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(d->mutex);
+	while( d->status.load(std::memory_order_acquire) == Pending )
+	{
+		d->finished.wait(lock);
+	}
+
+	return d->status.load(std::memory_order_acquire) == Loaded;
+}
+
+SpcRunner *SpcLoadHandle::runner() const
+{
+	return d ? d->runner : 0;
+}
+
+SpcFile SpcLoadHandle::spcFile() const
+{
+	if( status() != Loaded )
+	{
+		return SpcFile();
+	}
+
+	return d->file;
+}
+
+class SpcPrefetcher::Private
+{
+public:
+	Private(int threadCount)
+	 : pool(threadCount)
+	{}
+
+	static void load(SpcLoadHandle::Private *handle);
+
+	ThreadPool pool;
+};
+
+void SpcPrefetcher::Private::load(SpcLoadHandle::Private *handle)
+{
+	SpcFileLoader loader(handle->filename);
+	if( !loader || !handle->runner )
+	{
+		handle->finish(SpcLoadHandle::Failed);
+		return;
+	}
+
+	handle->file = std::move(loader).spcFile();
+	handle->finish( handle->runner->loadSpcFile(handle->file) ? SpcLoadHandle::Loaded : SpcLoadHandle::Failed );
+}
+
+SpcPrefetcher::SpcPrefetcher(int threadCount)
+ : d(new Private(threadCount > 0 ? threadCount : 1))
+{
+}
+
+SpcPrefetcher::~SpcPrefetcher()
+{
+	// The pool waits for its tasks
+	delete d;
+}
+
+SpcLoadHandle SpcPrefetcher::load(const std::string &filename, SpcRunner *runner)
+{
+	lDebug() << "Prefetching" << filename;
+
+	SpcLoadHandle handle;
+	handle.d = std::make_shared<SpcLoadHandle::Private>();
+	handle.d->runner = runner;
+	handle.d->filename = filename;
+
+	// The task keeps the handle alive when the caller drops it
+	std::shared_ptr<SpcLoadHandle::Private> state = handle.d;
+	d->pool.submit( [state]() { Private::load( state.get() ); } );
+
+	return handle;
+}
+
+void SpcPrefetcher::wait()
+{
+	d->pool.wait();
+}
+
+}
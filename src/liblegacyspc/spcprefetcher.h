@@ -0,0 +1,163 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SPCPREFETCHER_H
+#define LEGACYSPC_SPCPREFETCHER_H
+
+#include <legacyspc_export.h>
+
+// STL includes
+#include <memory>
+#include <string>
+
+namespace LegacySPC
+{
+
+class SpcFile;
+class SpcRunner;
+
+/**
+ * @brief Result of a SpcPrefetcher::load() to come
+ *
+ * Copies of a handle share the same load. status() and isReady()
+ * never block nor lock, they can be called from an audio thread.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SpcLoadHandle
+{
+public:
+	/**
+	 * @brief State of the load
+	 */
+	enum Status
+	{
+		Invalid, ///< Handle not returned by load()
+		Pending, ///< Still reading or loading the file
+		Loaded, ///< The runner is ready to run the file
+		Failed ///< The file can't be read or is not a SPC file
+	};
+
+	/**
+	 * @brief Create an invalid handle
+	 */
+	SpcLoadHandle();
+
+	/**
+	 * @brief Get the state of the load, without waiting
+	 * @return Status
+	 */
+	Status status() const;
+
+	/**
+	 * @brief Check if the load is over, without waiting
+	 * @return true once loaded or failed
+	 */
+	bool isReady() const;
+
+	/**
+	 * @brief Wait until the load is over
+	 *
+	 * Don't call from a task of the same SpcPrefetcher.
+	 * @return true if the runner is loaded
+	 */
+	bool wait() const;
+
+	/**
+	 * @brief Get the runner being loaded
+	 *
+	 * Don't use it before the load is over.
+	 * @return Runner given to load()
+	 */
+	SpcRunner *runner() const;
+
+	/**
+	 * @brief Get the file loaded in the runner, for its tags
+	 * @return SpcFile, empty until loaded
+	 */
+	SpcFile spcFile() const;
+
+private:
+	friend class SpcPrefetcher;
+
+	class Private;
+	std::shared_ptr<Private> d;
+};
+
+/**
+ * @brief Load SPC files in SpcRunners in the background
+ *
+ * A small pool of I/O threads reads the files with SpcFileLoader
+ * and loads them in runners allocated by the caller. For gapless
+ * playback, the next track is loaded while the current one plays,
+ * the audio thread only swaps runners once the load is ready:
+ *
+ * @code
+LegacySPC::SpcPrefetcher prefetcher;
+LegacySPC::SpcRunner *current = new LegacySPC::SpcRunner;
+LegacySPC::SpcRunner *next = new LegacySPC::SpcRunner;
+current->loadSpcFile("track1.spc");
+LegacySPC::SpcLoadHandle handle = prefetcher.load("track2.spc", next);
+
+// In the audio callback, at the end of track 1
+if( handle.status() == LegacySPC::SpcLoadHandle::Loaded )
+{
+	std::swap(current, next);
+}
+ * @endcode
+ *
+ * The runner of a pending load must not be used nor destroyed.
+ * The destructor waits for the pending loads.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SpcPrefetcher
+{
+public:
+	/**
+	 * @brief Create the prefetcher and start its threads
+	 * @param threadCount Number of I/O threads
+	 */
+	SpcPrefetcher(int threadCount = 1);
+	/**
+	 * @brief Wait for the pending loads and stop the threads
+	 */
+	~SpcPrefetcher();
+
+	/**
+	 * @brief Load a SPC file in a runner in the background
+	 *
+	 * The runner keeps its settings, like the output sample rate.
+	 * @param filename SPC file to load
+	 * @param runner Runner to load the file in
+	 * @return Handle to follow the load
+	 */
+	SpcLoadHandle load(const std::string &filename, SpcRunner *runner);
+
+	/**
+	 * @brief Wait until all the pending loads are over
+	 */
+	void wait();
+
+private:
+	SpcPrefetcher(const SpcPrefetcher &);
+	SpcPrefetcher &operator=(const SpcPrefetcher &);
+
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
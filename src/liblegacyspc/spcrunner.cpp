@@ -15,9 +15,30 @@
 #include "spcrunner.h"
  
 // LegacySPC includes
+#include "compressedsnapshot.h"
 #include "memorymap.h"
 #include "spccomponentmanager.h"
 #include "spcfilememoryloader.h"
+#include "dsp.h"
+#include "loopdetector.h"
+#include "processor.h"
+#include "ram.h"
+#include "rampagetracker.h"
+#include "rewindbuffer.h"
+#include "ringbuffer.h"
+#include "tracerecorder.h"
+#include "spcstate.h"
+#include "threadpool.h"
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace LegacySPC
 {
@@ -26,7 +47,13 @@ class SpcRunner::Private
 {
 public:
 	Private(SpcRunner *parent)
-	 : memory(0), componentManager(0)
+	 : parent(parent), memory(0), componentManager(0), blockSize(DefaultBlockSize),
+	   dspOutput(Resampler::MaxOutputFrames * 2),
+	   position(0),
+	   silenceSamples(0), silenceThreshold(0), haltDetection(false),
+	   silentSamples(0), endReason(NotEnded),
+	   renderAheadRing(0), renderAheadLatency(0), renderingAhead(false), renderAheadOverruns(0),
+	   rewindBuffer(0), rewindTracker(0), rewindState(0), rewindInterval(0), nextRewindPosition(0)
 	{
 		componentManager = new SpcComponentManager(parent);
 
@@ -35,14 +62,382 @@ public:
 
 	~Private()
 	{
+		stopRewind();
+		delete renderAheadRing;
 		delete componentManager;
 		delete memory;
 	}
 	
+	void emulate(s16 *buffer, int sampleCount);
+	void emulate(float *buffer, int sampleCount);
+	template<typename T>
+	int output(T *buffer, int frameCount);
+	void detectEnd(const s16 *buffer, int sampleCount);
+	bool emulateTicks(LoopDetector &detector, int sampleCount);
+	size_t saveTickState(byte *state) const;
+	void renderAhead();
+	bool loaded(bool success, SpcRunner *runner);
+	void recordRewindPoint();
+	void stopRewind();
+
+	SpcRunner *parent;
 	MemoryMap *memory;
 	SpcComponentManager *componentManager;
+	int blockSize;
+	Resampler resampler;
+	// DSP samples waiting for the resampler or the float conversion
+	std::vector<s16> dspOutput;
+	// DSP samples generated since the file was loaded
+	long long position;
+	// State right after loading, for seeking backward. Shared with
+	// the forks, it is never changed once saved.
+	std::shared_ptr<SpcState> initialState;
+
+	// End detection, 0 samples disable the silence detection
+	int silenceSamples;
+	int silenceThreshold;
+	bool haltDetection;
+	int silentSamples;
+	EndReason endReason;
+
+	RingBuffer *renderAheadRing;
+	size_t renderAheadLatency;
+	std::atomic<bool> renderingAhead;
+	// Refills that found the ring empty
+	std::atomic<unsigned long> renderAheadOverruns;
+	std::thread renderAheadThread;
+
+	RewindBuffer *rewindBuffer;
+	RamPageTracker *rewindTracker;
+	// Scratch state for recording and rewinding
+	SpcState *rewindState;
+	// In DSP samples
+	long long rewindInterval;
+	long long nextRewindPosition;
 };
 
+void SpcRunner::Private::emulate(s16 *buffer, int sampleCount)
+{
+	Processor *processor = componentManager->processor();
+	Dsp *dsp = componentManager->dsp();
+
+	while( sampleCount > 0 )
+	{
+		int samples = sampleCount < blockSize ? sampleCount : blockSize;
+		int blockCycles = samples * Dsp::CyclesPerSample;
+
+		TraceRecorder *traceRecorder = processor->traceRecorder();
+		if( traceRecorder )
+		{
+			traceRecorder->setCycleBase(position * Dsp::CyclesPerSample);
+		}
+
+		// Run the CPU for the whole block, its DSP writes are
+		// queued with their time and the DSP only catches up
+		// when the CPU reads what the DSP updates.
+		dsp->beginBlock(buffer, samples);
+		while( processor->cycles() < blockCycles )
+		{
+			processor->processOpcode();
+		}
+		dsp->endBlock();
+
+		// Keep the cycles run past the block for the next one
+		memory->rebaseCycles(blockCycles);
+		processor->setCycles( processor->cycles() - blockCycles );
+
+		detectEnd(buffer, samples);
+
+		if( buffer )
+		{
+			buffer += samples * 2;
+		}
+		sampleCount -= samples;
+		position += samples;
+
+		if( rewindBuffer && position >= nextRewindPosition && !dsp->isStateOnly() )
+		{
+			recordRewindPoint();
+		}
+	}
+}
+
+void SpcRunner::Private::emulate(float *buffer, int sampleCount)
+{
+	while( sampleCount > 0 )
+	{
+		int samples = sampleCount < Resampler::MaxOutputFrames ? sampleCount : Resampler::MaxOutputFrames;
+		emulate(&dspOutput[0], samples);
+
+		for(int i = 0; i < samples * 2; i++)
+		{
+			buffer[i] = dspOutput[i] * (1.0f / 32768.0f);
+		}
+
+		buffer += samples * 2;
+		sampleCount -= samples;
+	}
+}
+
+void SpcRunner::Private::detectEnd(const s16 *buffer, int sampleCount)
+{
+	if( endReason != NotEnded )
+	{
+		return;
+	}
+
+	if( haltDetection && componentManager->processor()->isHalted() )
+	{
+		endReason = ProcessorHalted;
+		return;
+	}
+
+	// Only generated output can be checked
+	if( !silenceSamples || !buffer )
+	{
+		return;
+	}
+
+	for(int i = 0; i < sampleCount * 2; i += 2)
+	{
+		if( std::abs(buffer[i]) > silenceThreshold || std::abs(buffer[i + 1]) > silenceThreshold )
+		{
+			silentSamples = 0;
+		}
+		else if( ++silentSamples >= silenceSamples )
+		{
+			endReason = SilenceDetected;
+			return;
+		}
+	}
+}
+
+// State not kept in RAM, as seen by the CPU
+size_t SpcRunner::Private::saveTickState(byte *state) const
+{
+	Processor *processor = componentManager->processor();
+	const ProcessorRegisters *registers = processor->registers();
+	Dsp *dsp = componentManager->dsp();
+	size_t size = 0;
+
+	word programCounter = registers->programCounter();
+	state[size++] = programCounter.lowByte();
+	state[size++] = programCounter.highByte();
+	state[size++] = registers->A();
+	state[size++] = registers->X();
+	state[size++] = registers->Y();
+	state[size++] = registers->stackPointer();
+	state[size++] = registers->programStatus();
+
+	// The phase of the timers, the absolute time is left out
+	IoState io;
+	memory->saveIoState(io);
+	state[size++] = static_cast<byte>( processor->cycles() - io.timerCycles );
+	for(int i = 0; i < 3; i++)
+	{
+		state[size++] = io.timers[i].enabled;
+		state[size++] = io.timers[i].target;
+		state[size++] = static_cast<byte>( io.timers[i].divider );
+		state[size++] = io.timers[i].counter;
+		state[size++] = static_cast<byte>( io.timers[i].elapsed );
+	}
+	for(int i = 0; i < 4; i++)
+	{
+		state[size++] = io.inputPorts[i];
+	}
+
+	// The registers updated by the DSP itself are left out,
+	// they would make the DSP catch up
+	int sampleTime = processor->cycles() / Dsp::CyclesPerSample;
+	for(int address = 0; address < Dsp::RegisterCount; address++)
+	{
+		int voiceRegister = address & 0x0F;
+		if( voiceRegister != Dsp::EnvelopeX && voiceRegister != Dsp::OutputX && address != Dsp::EndX )
+		{
+			state[size++] = dsp->readRegisterAt(sampleTime, address);
+		}
+	}
+
+	return size;
+}
+
+bool SpcRunner::Private::emulateTicks(LoopDetector &detector, int sampleCount)
+{
+	Processor *processor = componentManager->processor();
+	Dsp *dsp = componentManager->dsp();
+	unsigned int tickReads = memory->tickReads();
+	byte state[256];
+	bool found = false;
+
+	while( sampleCount > 0 && !found )
+	{
+		int samples = sampleCount < blockSize ? sampleCount : blockSize;
+		int blockCycles = samples * Dsp::CyclesPerSample;
+
+		TraceRecorder *traceRecorder = processor->traceRecorder();
+		if( traceRecorder )
+		{
+			traceRecorder->setCycleBase(position * Dsp::CyclesPerSample);
+		}
+
+		// Same as emulate(), with a look at the state after
+		// each opcode reading a tick from a timer counter
+		dsp->beginBlock(0, samples);
+		while( processor->cycles() < blockCycles )
+		{
+			processor->processOpcode();
+
+			if( memory->tickReads() != tickReads && !found )
+			{
+				tickReads = memory->tickReads();
+
+				long long time = position * Dsp::CyclesPerSample + processor->cycles();
+				found = detector.addState( time, state, saveTickState(state) );
+			}
+		}
+		dsp->endBlock();
+
+		memory->rebaseCycles(blockCycles);
+		processor->setCycles( processor->cycles() - blockCycles );
+
+		sampleCount -= samples;
+		position += samples;
+	}
+
+	return found;
+}
+
+template<typename T>
+int SpcRunner::Private::output(T *buffer, int frameCount)
+{
+	// Emulate in chunks so the end of the song is noticed soon enough
+	int done = 0;
+	while( done < frameCount && endReason == NotEnded )
+	{
+		int frames = frameCount - done < Resampler::MaxOutputFrames ? frameCount - done : Resampler::MaxOutputFrames;
+		T *chunk = buffer ? buffer + done * 2 : 0;
+
+		if( resampler.isPassthrough() )
+		{
+			emulate(chunk, frames);
+		}
+		else
+		{
+			// Emulate just enough DSP samples for the chunk
+			int needed = resampler.inputFramesNeeded(frames);
+			if( needed > 0 )
+			{
+				emulate(&dspOutput[0], needed);
+				resampler.pushInput(&dspOutput[0], needed);
+			}
+			resampler.readOutput(chunk, frames);
+		}
+
+		done += frames;
+	}
+
+	// Silence after the end of the song
+	if( buffer )
+	{
+		std::fill(buffer + done * 2, buffer + frameCount * 2, T(0));
+	}
+
+	return done;
+}
+
+void SpcRunner::Private::renderAhead()
+{
+	// Frames rendered at once, small enough to refill the ring often
+	const size_t ChunkFrames = 1024;
+
+	// Look at the ring a few times per latency period
+	long long pollMicroseconds = static_cast<long long>(renderAheadLatency) * 250000 / resampler.outputRate();
+	if( pollMicroseconds < 500 )
+	{
+		pollMicroseconds = 500;
+	}
+
+	bool started = false;
+	while( renderingAhead.load(std::memory_order_acquire) )
+	{
+		size_t ready = renderAheadRing->readAvailable();
+		if( ready >= renderAheadLatency )
+		{
+			std::this_thread::sleep_for( std::chrono::microseconds(pollMicroseconds) );
+			continue;
+		}
+
+		// Everything rendered was read before the worker came back,
+		// it fell behind the latency target
+		if( ready == 0 && started )
+		{
+			renderAheadOverruns.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Render in place in the ring
+		size_t frames;
+		s16 *region = renderAheadRing->writeRegion(frames);
+		size_t wanted = renderAheadLatency - ready;
+		if( frames > wanted )
+		{
+			frames = wanted;
+		}
+		if( frames > ChunkFrames )
+		{
+			frames = ChunkFrames;
+		}
+
+		output(region, static_cast<int>(frames));
+		renderAheadRing->commitWrite(frames);
+		started = true;
+	}
+}
+
+bool SpcRunner::Private::loaded(bool success, SpcRunner *runner)
+{
+	resampler.reset();
+	position = 0;
+	silentSamples = 0;
+	endReason = NotEnded;
+
+	if( success )
+	{
+		if( !initialState || initialState.use_count() > 1 )
+		{
+			initialState.reset(new SpcState);
+		}
+		runner->saveState(*initialState);
+	}
+
+	if( rewindBuffer )
+	{
+		rewindBuffer->clear(initialState ? initialState->ram : 0);
+		rewindTracker->markAllDirty();
+		nextRewindPosition = 0;
+	}
+
+	return success;
+}
+
+void SpcRunner::Private::recordRewindPoint()
+{
+	parent->saveState(*rewindState);
+	rewindBuffer->record(*rewindState, rewindTracker->dirtyPages());
+	rewindTracker->clearDirtyPages();
+
+	nextRewindPosition = position + rewindInterval;
+}
+
+void SpcRunner::Private::stopRewind()
+{
+	delete rewindTracker;
+	delete rewindBuffer;
+	delete rewindState;
+	rewindTracker = 0;
+	rewindBuffer = 0;
+	rewindState = 0;
+}
+
 SpcRunner::SpcRunner()
  : d(new Private(this))
 {
@@ -50,6 +445,7 @@ SpcRunner::SpcRunner()
 
 SpcRunner::~SpcRunner()
 {
+	stopRenderAhead();
 	delete d;
 }
 
@@ -62,13 +458,578 @@ bool SpcRunner::loadSpcFile(const std::string &filename)
 {
 	SpcFileMemoryLoader loader(d->componentManager);
 
-	return loader.loadSpcFile(filename);
+	return d->loaded( loader.loadSpcFile(filename), this );
+}
+
+bool SpcRunner::loadSpcFile(const SpcFile &file)
+{
+	SpcFileMemoryLoader loader(d->componentManager);
+
+	return d->loaded( loader.loadSpcFile(file), this );
+}
+
+bool SpcRunner::loadSpcFile(const MappedSpcFile &file)
+{
+	SpcFileMemoryLoader loader(d->componentManager);
+
+	return d->loaded( loader.loadSpcFile(file), this );
+}
+
+size_t SpcRunner::render(s16 *interleaved, size_t frames)
+{
+	size_t rendered = 0;
+	while( frames > 0 )
+	{
+		int chunk = frames < MaxBlockSize ? static_cast<int>(frames) : MaxBlockSize;
+		rendered += d->output(interleaved, chunk);
+
+		if( interleaved )
+		{
+			interleaved += chunk * 2;
+		}
+		frames -= chunk;
+	}
+
+	return rendered;
+}
+
+size_t SpcRunner::render(float *interleaved, size_t frames)
+{
+	size_t rendered = 0;
+	while( frames > 0 )
+	{
+		int chunk = frames < MaxBlockSize ? static_cast<int>(frames) : MaxBlockSize;
+		rendered += d->output(interleaved, chunk);
+
+		interleaved += chunk * 2;
+		frames -= chunk;
+	}
+
+	return rendered;
+}
+
+void SpcRunner::renderParallel(s16 *interleaved, size_t frames, int checkpointInterval, int threadCount)
+{
+	Dsp *dsp = d->componentManager->dsp();
+	bool passthrough = d->resampler.isPassthrough();
+
+	// Same DSP samples as a serial render
+	size_t samples = frames;
+	if( !passthrough )
+	{
+		samples = d->resampler.inputFramesNeeded( static_cast<int>(frames) );
+	}
+
+	size_t segmentSamples = checkpointInterval > 0 ? static_cast<size_t>(checkpointInterval) * Dsp::SampleRate : static_cast<size_t>(Dsp::SampleRate);
+	size_t segmentCount = (samples + segmentSamples - 1) / segmentSamples;
+	if( segmentCount < 2 || (passthrough && !interleaved) )
+	{
+		// Nothing to split
+		render(interleaved, frames);
+		return;
+	}
+
+	std::vector<s16> dspSamples;
+	s16 *target = interleaved;
+	if( !passthrough )
+	{
+		dspSamples.resize(samples * 2);
+		target = &dspSamples[0];
+	}
+
+	// Sized once, the workers keep pointers to the checkpoints
+	std::vector<SpcState> checkpoints(segmentCount);
+	byte muted = mutedVoices();
+	{
+		ThreadPool pool(threadCount);
+
+		// The fast pass runs the CPU with a DSP that only keeps its
+		// state, each segment is rendered as soon as its checkpoint is
+		// taken while the fast pass continues.
+		dsp->setStateOnly(true);
+		for(size_t i = 0; i < segmentCount; i++)
+		{
+			size_t start = i * segmentSamples;
+			int count = static_cast<int>( samples - start < segmentSamples ? samples - start : segmentSamples );
+			const SpcState *checkpoint = &checkpoints[i];
+			saveState(checkpoints[i]);
+
+			pool.submit( [checkpoint, muted, target, start, count]()
+			{
+				SpcRunner worker;
+				worker.setMutedVoices(muted);
+				worker.restoreState(*checkpoint);
+				worker.d->emulate(target + start * 2, count);
+			} );
+
+			d->emulate(static_cast<s16*>(0), count);
+		}
+		dsp->setStateOnly(false);
+
+		pool.wait();
+	}
+
+	if( passthrough )
+	{
+		return;
+	}
+
+	// The resampler runs in order over the whole output
+	const s16 *input = &dspSamples[0];
+	while( frames > 0 )
+	{
+		int chunk = frames < Resampler::MaxOutputFrames ? static_cast<int>(frames) : Resampler::MaxOutputFrames;
+		int needed = d->resampler.inputFramesNeeded(chunk);
+		if( needed > 0 )
+		{
+			d->resampler.pushInput(input, needed);
+			input += needed * 2;
+		}
+		d->resampler.readOutput(interleaved, chunk);
+
+		if( interleaved )
+		{
+			interleaved += chunk * 2;
+		}
+		frames -= chunk;
+	}
+}
+
+void SpcRunner::saveState(SpcState &state) const
+{
+	Processor *processor = d->componentManager->processor();
+	ProcessorRegisters *registers = processor->registers();
+
+	state.position = d->position;
+	memcpy(state.ram, d->componentManager->ram()->data(), sizeof(state.ram));
+
+	state.processor.programCounter = registers->programCounter();
+	state.processor.a = registers->A();
+	state.processor.x = registers->X();
+	state.processor.y = registers->Y();
+	state.processor.stackPointer = registers->stackPointer();
+	state.processor.programStatus = registers->programStatus();
+	state.processor.reserved = 0;
+	state.processor.cycles = processor->cycles();
+
+	d->memory->saveIoState(state.io);
+	d->componentManager->dsp()->saveState(state.dsp);
+}
+
+void SpcRunner::restoreState(const SpcState &state)
+{
+	Processor *processor = d->componentManager->processor();
+	ProcessorRegisters *registers = processor->registers();
+
+	d->position = state.position;
+	// Marks all the pages as written
+	d->componentManager->ram()->loadRam(state.ram, sizeof(state.ram));
+
+	registers->setProgramCounter(state.processor.programCounter);
+	registers->setA(state.processor.a);
+	registers->setX(state.processor.x);
+	registers->setY(state.processor.y);
+	registers->setStackPointer(state.processor.stackPointer);
+	registers->setProgramStatus(state.processor.programStatus);
+	processor->setCycles(state.processor.cycles);
+
+	processor->setHalted(false);
+
+	d->memory->restoreIoState(state.io);
+	d->componentManager->dsp()->restoreState(state.dsp);
+
+	d->resampler.reset();
+	d->silentSamples = 0;
+	d->endReason = NotEnded;
+	d->nextRewindPosition = d->position + d->rewindInterval;
+}
+
+void SpcRunner::saveSnapshot(CompressedSnapshot &snapshot) const
+{
+	// Too large for the stack
+	std::unique_ptr<SpcState> state(new SpcState);
+	saveState(*state);
+
+	snapshot.compress(*state, d->initialState ? d->initialState->ram : 0);
+}
+
+bool SpcRunner::restoreSnapshot(const CompressedSnapshot &snapshot)
+{
+	std::unique_ptr<SpcState> state(new SpcState);
+	if( !snapshot.decompress(*state, d->initialState ? d->initialState->ram : 0) )
+	{
+		return false;
+	}
+
+	restoreState(*state);
+	return true;
+}
+
+SpcRunner *SpcRunner::fork() const
+{
+	SpcRunner *runner = new SpcRunner;
+	runner->setBlockSize(d->blockSize);
+	runner->setMutedVoices( mutedVoices() );
+	runner->d->silenceSamples = d->silenceSamples;
+	runner->d->silenceThreshold = d->silenceThreshold;
+	runner->d->haltDetection = d->haltDetection;
+
+	std::unique_ptr<SpcState> state(new SpcState);
+	saveState(*state);
+	runner->restoreState(*state);
+	runner->d->initialState = d->initialState;
+
+	// Goes on from the same point, restoreState() started over
+	runner->d->resampler = d->resampler;
+	runner->d->dspOutput.resize( d->dspOutput.size() );
+	runner->d->silentSamples = d->silentSamples;
+	runner->d->endReason = d->endReason;
+
+	return runner;
+}
+
+bool SpcRunner::seek(int milliseconds)
+{
+	if( !d->initialState || milliseconds < 0 )
+	{
+		return false;
+	}
+
+	long long target = static_cast<long long>(milliseconds) * Dsp::SampleRate / 1000;
+	if( target < d->position )
+	{
+		restoreState(*d->initialState);
+	}
+
+	d->silentSamples = 0;
+	d->endReason = NotEnded;
+
+	Dsp *dsp = d->componentManager->dsp();
+	dsp->setStateOnly(true);
+	while( d->position < target )
+	{
+		long long remaining = target - d->position;
+		d->emulate( static_cast<s16*>(0), remaining < MaxBlockSize ? static_cast<int>(remaining) : MaxBlockSize );
+	}
+	dsp->setStateOnly(false);
+
+	d->resampler.reset();
+	return true;
+}
+
+void SpcRunner::setSilenceDetection(int milliseconds, int threshold)
+{
+	d->silenceSamples = milliseconds > 0 ? milliseconds * (Dsp::SampleRate / 1000) : 0;
+	d->silenceThreshold = threshold;
+	d->silentSamples = 0;
+}
+
+void SpcRunner::setHaltDetection(bool enabled)
+{
+	d->haltDetection = enabled;
+}
+
+SpcRunner::EndReason SpcRunner::endReason() const
+{
+	return d->endReason;
+}
+
+bool SpcRunner::findLoop(int maxSeconds, int &introLength, int &loopLength)
+{
+	// Too large for the stack
+	std::unique_ptr<SpcState> start(new SpcState);
+	saveState(*start);
+	// restoreState() starts the output over, what follows must not change
+	Resampler resampler(d->resampler);
+	int silentSamples = d->silentSamples;
+	EndReason endReason = d->endReason;
+	long long nextRewindPosition = d->nextRewindPosition;
+
+	LoopDetector detector;
+	detector.reset( d->componentManager->ram() );
+
+	long long target = d->position + static_cast<long long>(maxSeconds) * Dsp::SampleRate;
+	bool found = false;
+
+	Dsp *dsp = d->componentManager->dsp();
+	dsp->setStateOnly(true);
+	while( !found && d->position < target )
+	{
+		long long remaining = target - d->position;
+		found = d->emulateTicks( detector, remaining < MaxBlockSize ? static_cast<int>(remaining) : MaxBlockSize );
+	}
+	dsp->setStateOnly(false);
+
+	restoreState(*start);
+	d->resampler = resampler;
+	d->silentSamples = silentSamples;
+	d->endReason = endReason;
+	d->nextRewindPosition = nextRewindPosition;
+
+	if( found )
+	{
+		// Ticks are timed in CPU cycles
+		const long long cyclesPerSecond = Dsp::SampleRate * Dsp::CyclesPerSample;
+		introLength = static_cast<int>( detector.loopStart() * 1000 / cyclesPerSecond );
+		loopLength = static_cast<int>( detector.loopLength() * 1000 / cyclesPerSecond );
+	}
+
+	return found;
+}
+
+void SpcRunner::setRewind(int intervalMilliseconds, size_t byteBudget)
+{
+	d->stopRewind();
+	if( intervalMilliseconds <= 0 )
+	{
+		d->rewindInterval = 0;
+		return;
+	}
+
+	d->rewindBuffer = new RewindBuffer(byteBudget);
+	d->rewindBuffer->clear(d->initialState ? d->initialState->ram : 0);
+	d->rewindTracker = new RamPageTracker(d->componentManager->ram());
+	d->rewindState = new SpcState;
+	d->rewindInterval = static_cast<long long>(intervalMilliseconds) * Dsp::SampleRate / 1000;
+	// The current position is the first point
+	d->nextRewindPosition = d->position;
+}
+
+int SpcRunner::rewindPointCount() const
+{
+	return d->rewindBuffer ? d->rewindBuffer->count() : 0;
+}
+
+int SpcRunner::rewindPointPosition(int index) const
+{
+	if( !d->rewindBuffer || index < 0 || index >= d->rewindBuffer->count() )
+	{
+		return -1;
+	}
+
+	return static_cast<int>( d->rewindBuffer->position(index) * 1000 / Dsp::SampleRate );
+}
+
+bool SpcRunner::rewind(int index)
+{
+	if( !d->rewindBuffer || !d->rewindBuffer->rewind(index, *d->rewindState) )
+	{
+		return false;
+	}
+
+	restoreState(*d->rewindState);
+	// The buffer holds this state already
+	d->rewindTracker->clearDirtyPages();
+
+	return true;
+}
+
+bool SpcRunner::stepBack()
+{
+	if( !d->rewindBuffer )
+	{
+		return false;
+	}
+
+	int index = d->rewindBuffer->count() - 1;
+	if( index >= 0 && d->rewindBuffer->position(index) >= d->position )
+	{
+		index--;
+	}
+
+	return rewind(index);
+}
+
+void SpcRunner::setTraceRecorder(TraceRecorder *recorder)
+{
+	d->componentManager->processor()->setTraceRecorder(recorder);
+}
+
+TraceRecorder *SpcRunner::traceRecorder() const
+{
+	return d->componentManager->processor()->traceRecorder();
+}
+
+int SpcRunner::position() const
+{
+	return static_cast<int>( d->position * 1000 / Dsp::SampleRate );
+}
+
+bool SpcRunner::startRenderAhead(size_t latencyFrames)
+{
+	if( d->renderingAhead.load() || latencyFrames == 0 )
+	{
+		return false;
+	}
+
+	if( !d->renderAheadRing || d->renderAheadRing->capacity() < latencyFrames )
+	{
+		delete d->renderAheadRing;
+		d->renderAheadRing = new RingBuffer(latencyFrames);
+	}
+	d->renderAheadRing->clear();
+	d->renderAheadLatency = latencyFrames;
+	d->renderAheadOverruns.store(0);
+
+	d->renderingAhead.store(true, std::memory_order_release);
+	d->renderAheadThread = std::thread(&SpcRunner::Private::renderAhead, d);
+
+	return true;
+}
+
+void SpcRunner::stopRenderAhead()
+{
+	if( !d->renderingAhead.load() )
+	{
+		return;
+	}
+
+	d->renderingAhead.store(false, std::memory_order_release);
+	d->renderAheadThread.join();
+}
+
+bool SpcRunner::isRenderingAhead() const
+{
+	return d->renderingAhead.load(std::memory_order_acquire);
+}
+
+size_t SpcRunner::readRenderedAhead(s16 *interleaved, size_t frames)
+{
+	if( !d->renderAheadRing )
+	{
+		for(size_t i = 0; i < frames * 2; i++)
+		{
+			interleaved[i] = 0;
+		}
+		return 0;
+	}
+
+	return d->renderAheadRing->read(interleaved, frames);
+}
+
+size_t SpcRunner::renderedAheadAvailable() const
+{
+	return d->renderAheadRing ? d->renderAheadRing->readAvailable() : 0;
+}
+
+unsigned long SpcRunner::renderAheadUnderruns() const
+{
+	return d->renderAheadRing ? d->renderAheadRing->underruns() : 0;
+}
+
+unsigned long SpcRunner::renderAheadOverruns() const
+{
+	return d->renderAheadOverruns.load(std::memory_order_relaxed);
 }
 
 bool SpcRunner::run()
 {
-	// TODO
-	return false;
+	if( !d->initialState || (!d->silenceSamples && !d->haltDetection) )
+	{
+		return false;
+	}
+
+	// The silence is only checked on rendered samples
+	s16 buffer[Resampler::MaxOutputFrames * 2];
+	while( d->endReason == NotEnded )
+	{
+		render(buffer, Resampler::MaxOutputFrames);
+	}
+
+	return true;
+}
+
+void SpcRunner::setVoiceMuted(int voice, bool muted)
+{
+	if( voice < 0 || voice >= Dsp::VoiceCount )
+	{
+		return;
+	}
+
+	byte mask = mutedVoices();
+	if( muted )
+	{
+		mask |= 1 << voice;
+	}
+	else
+	{
+		mask &= ~(1 << voice);
+	}
+
+	setMutedVoices(mask);
+}
+
+bool SpcRunner::isVoiceMuted(int voice) const
+{
+	if( voice < 0 || voice >= Dsp::VoiceCount )
+	{
+		return false;
+	}
+
+	return mutedVoices() & (1 << voice);
+}
+
+void SpcRunner::soloVoice(int voice)
+{
+	if( voice < 0 || voice >= Dsp::VoiceCount )
+	{
+		return;
+	}
+
+	setMutedVoices( static_cast<byte>(~(1 << voice)) );
+}
+
+void SpcRunner::setMutedVoices(byte mask)
+{
+	d->componentManager->dsp()->setMutedVoices(mask);
+}
+
+byte SpcRunner::mutedVoices() const
+{
+	return d->componentManager->dsp()->mutedVoices();
+}
+
+void SpcRunner::setStemBuffers(const StemBuffers *buffers)
+{
+	d->componentManager->dsp()->setStemBuffers(buffers);
+}
+
+void SpcRunner::setBlockSize(int sampleCount)
+{
+	if( sampleCount < 1 )
+	{
+		sampleCount = 1;
+	}
+	else if( sampleCount > MaxBlockSize )
+	{
+		sampleCount = MaxBlockSize;
+	}
+
+	d->blockSize = sampleCount;
+}
+
+int SpcRunner::blockSize() const
+{
+	return d->blockSize;
+}
+
+void SpcRunner::setOutputSampleRate(int rate, Resampler::Quality quality)
+{
+	if( rate < 1 )
+	{
+		return;
+	}
+
+	d->resampler.setRates(Dsp::SampleRate, rate, quality);
+	if( d->resampler.maxInputFrames() > Resampler::MaxOutputFrames )
+	{
+		d->dspOutput.resize( d->resampler.maxInputFrames() * 2 );
+	}
+}
+
+int SpcRunner::outputSampleRate() const
+{
+	return d->resampler.outputRate();
 }
 
 SpcComponentManager *SpcRunner::componentManager() const
@@ -16,15 +16,24 @@
 #define LEGACYSPC_SPCRUNNER_H
 
 #include <legacyspc_export.h>
+#include <types.h>
+#include <resampler.h>
 
 // STL includes
+#include <cstddef>
 #include <string>
 
 namespace LegacySPC
 {
 
+class CompressedSnapshot;
+class MappedSpcFile;
 class MemoryMap;
 class SpcComponentManager;
+class SpcFile;
+class TraceRecorder;
+struct SpcState;
+struct StemBuffers;
 
  /**
   * @brief Main emulation loop manager
@@ -41,6 +50,16 @@ class SpcComponentManager;
 class LEGACYSPC_EXPORT SpcRunner
 {
 public:
+	/**
+	 * @brief Reason the song ended early
+	 */
+	enum EndReason
+	{
+		NotEnded, ///< The song is still playing
+		SilenceDetected, ///< The output stayed silent for the configured length
+		ProcessorHalted ///< The CPU executed SLEEP or STOP
+	};
+
 	/**
 	 * @brief Constructor
 	 */
@@ -65,16 +84,412 @@ public:
 	 */
 	bool loadSpcFile(const std::string &filename);
 
+	/**
+	 * @brief Load a SPC file already read by SpcFileLoader
+	 * @param file SpcFile to run
+	 * @return false if the loading has failed, or if the file
+	 * was read without its RAM by SpcFileLoader::TagOnly
+	 */
+	bool loadSpcFile(const SpcFile &file);
+
+	/**
+	 * @brief Load a SPC file mapped by MappedSpcFile
+	 *
+	 * The RAM is copied once, from the mapping to the emulator.
+	 * @param file Mapped SPC file to run
+	 * @return false if the loading has failed
+	 */
+	bool loadSpcFile(const MappedSpcFile &file);
+
  	/**
  	 * @brief Execute the emulation loop
  	 *
  	 * Load an SPC buffer into memory before
  	 * using this method.
  	 *
- 	 * @return false if execution failed.
+ 	 * The song is rendered until its end is detected and the output
+ 	 * is dropped. Enable the silence or the halt detection first,
+ 	 * a song that never ends keeps this method running.
+ 	 * @return false if no file is loaded or no end detection is enabled.
+ 	 * @see setSilenceDetection(), setHaltDetection(), endReason()
  	 */
  	bool run();
 
+	/**
+	 * @brief Render the next frames of the song
+	 *
+	 * The emulation advances exactly far enough to fill the buffer,
+	 * the CPU cycles run past the end and the resampler position carry
+	 * over to the next call. Rendering in many small calls gives the
+	 * same output as one large call. Nothing is allocated or locked.
+	 *
+	 * Once the end of the song is detected, the rest of the buffer
+	 * is filled with silence.
+	 * @param interleaved Interleaved left/right output, can be null
+	 * to advance without keeping the output.
+	 * @param frames Number of stereo frames at the output sample rate
+	 * @return Number of frames rendered before the end of the song
+	 * @see setSilenceDetection(), setHaltDetection()
+	 */
+	size_t render(s16 *interleaved, size_t frames);
+
+	/**
+	 * @brief Render the next frames of the song as floating point samples
+	 *
+	 * Same as the 16-bit render(), the samples are from -1.0 to 1.0.
+	 * @param interleaved Interleaved left/right output
+	 * @param frames Number of stereo frames at the output sample rate
+	 * @return Number of frames rendered before the end of the song
+	 */
+	size_t render(float *interleaved, size_t frames);
+
+	/**
+	 * @brief Render the next frames of the song on many threads
+	 *
+	 * A first pass runs the CPU with the DSP only updating its state,
+	 * and takes a checkpoint of the whole emulation every
+	 * checkpointInterval seconds. Each segment between two checkpoints
+	 * is rendered by its own SpcRunner in a ThreadPool, as soon as its
+	 * checkpoint is taken. The output and the state reached are the
+	 * same as with render(), the stem buffers are not filled and
+	 * all the frames are rendered even past the end of the song.
+	 * @param interleaved Interleaved left/right output, can be null
+	 * @param frames Number of stereo frames at the output sample rate
+	 * @param checkpointInterval Seconds of song between two checkpoints
+	 * @param threadCount Number of threads, 0 for one per core
+	 */
+	void renderParallel(s16 *interleaved, size_t frames, int checkpointInterval = DefaultCheckpointInterval, int threadCount = 0);
+
+	/**
+	 * @brief Save the whole emulation state
+	 *
+	 * Settings like the muted voices, the stem buffers and the
+	 * output sample rate are not part of the state. Don't call
+	 * while rendering ahead.
+	 * @param state Receives the state
+	 */
+	void saveState(SpcState &state) const;
+
+	/**
+	 * @brief Restore a state saved by saveState()
+	 *
+	 * The resampler starts over, like after loading a file.
+	 * Muted voices stay stopped.
+	 * @param state State to restore
+	 */
+	void restoreState(const SpcState &state);
+
+	/**
+	 * @brief Save the emulation state compressed
+	 *
+	 * The RAM is stored as its difference with the RAM of the
+	 * loaded file, a snapshot takes a few kilobytes. The same
+	 * settings as saveState() are left out.
+	 * @param snapshot Receives the state
+	 * @see CompressedSnapshot
+	 */
+	void saveSnapshot(CompressedSnapshot &snapshot) const;
+
+	/**
+	 * @brief Restore a snapshot saved by saveSnapshot()
+	 *
+	 * The snapshot must have been saved with the same file loaded.
+	 * @param snapshot Snapshot to restore
+	 * @return false if the snapshot is empty or invalid
+	 */
+	bool restoreSnapshot(const CompressedSnapshot &snapshot);
+
+	/**
+	 * @brief Create a runner going on from the current point
+	 *
+	 * The copy has the state, the output sample rate with the
+	 * resampler input pending, the block size, the muted voices and
+	 * the end detection settings. It shares the state saved when
+	 * loading the file, for seeking backward and the snapshots.
+	 * The stem buffers and the rewind points are not copied. Each
+	 * runner then plays on its own, to compare mutes or port inputs
+	 * from the same point. Don't call while rendering ahead.
+	 * @return New runner, delete it when done
+	 */
+	SpcRunner *fork() const;
+
+	/**
+	 * @brief Move to a time of the song
+	 *
+	 * The CPU and the timers run at full speed up to that time while
+	 * the DSP only updates its state: envelopes, BRR positions and
+	 * echo buffer writes, without interpolation or mixing. The state
+	 * reached is the same as rendering up to that time. Seeking
+	 * backward starts over from the loaded file. The resampler
+	 * starts over at the new time.
+	 * @param milliseconds Time since the file was loaded
+	 * @return false if no file is loaded
+	 */
+	bool seek(int milliseconds);
+
+	/**
+	 * @brief Find where the song starts to loop
+	 *
+	 * The song runs from the current position without mixing, like
+	 * seek(). At each tick of the sound driver, the CPU registers,
+	 * the timers, the DSP registers and the RAM are hashed, the
+	 * first state seen twice gives the loop. The song is back at
+	 * the current position afterward and the output goes on as if
+	 * findLoop() was not called.
+	 * @param maxSeconds Length of the song to search
+	 * @param introLength Set to the milliseconds from the loaded
+	 * file to the loop
+	 * @param loopLength Set to the length of the loop in milliseconds
+	 * @return false if no loop was found
+	 * @see LoopDetector
+	 */
+	bool findLoop(int maxSeconds, int &introLength, int &loopLength);
+
+	/**
+	 * @brief Record the song to step back in it
+	 *
+	 * While rendering, a point is added to a RewindBuffer at the end
+	 * of the first block past each interval, so the block size sets
+	 * the finest interval. Seeking and renderParallel() record nothing. A point costs
+	 * what the song changed since the previous one, the oldest points
+	 * are dropped to stay within the budget. Loading a file forgets
+	 * the points.
+	 * @param intervalMilliseconds Time between two points, 0 to stop recording
+	 * @param byteBudget Memory allowed for the points, in bytes
+	 */
+	void setRewind(int intervalMilliseconds, size_t byteBudget = DefaultRewindBudget);
+
+	/**
+	 * @brief Get the number of points recorded for rewinding
+	 * @return Points, the oldest is 0
+	 */
+	int rewindPointCount() const;
+
+	/**
+	 * @brief Get the time of a point recorded for rewinding
+	 * @param index Point from 0 to rewindPointCount() - 1
+	 * @return Milliseconds since the file was loaded, -1 for an invalid index
+	 */
+	int rewindPointPosition(int index) const;
+
+	/**
+	 * @brief Go back to a point recorded for rewinding
+	 *
+	 * The points after it are dropped and the recording goes on
+	 * from there. Like restoreState(), the resampler starts over.
+	 * @param index Point from 0 to rewindPointCount() - 1
+	 * @return false if the index is invalid
+	 */
+	bool rewind(int index);
+
+	/**
+	 * @brief Go back to the last point before the current position
+	 * @return false if there is no such point
+	 */
+	bool stepBack();
+
+	/**
+	 * @brief End the song after a length of silence
+	 *
+	 * The silence is detected on the 32 kHz DSP output, when
+	 * rendering to a null buffer at 32 kHz nothing is checked.
+	 * @param milliseconds Length of the silence, 0 to disable the detection
+	 * @param threshold Highest absolute sample value counted as silence
+	 */
+	void setSilenceDetection(int milliseconds, int threshold = 0);
+
+	/**
+	 * @brief End the song when the CPU executes SLEEP or STOP
+	 * @param enabled true to detect a halted CPU
+	 */
+	void setHaltDetection(bool enabled);
+
+	/**
+	 * @brief Get why the song ended
+	 *
+	 * Loading a file, seeking and restoring a state start
+	 * the detection over.
+	 * @return NotEnded while the song plays
+	 */
+	EndReason endReason() const;
+
+	/**
+	 * @brief Record each instruction executed by the CPU
+	 *
+	 * Rendering, seeking and findLoop() are recorded, the segments
+	 * of renderParallel() run on other runners and are not. The
+	 * cycles of the records count from the loaded file.
+	 * @param recorder Recorder, not owned, null to stop recording
+	 * @see TraceRecorder
+	 */
+	void setTraceRecorder(TraceRecorder *recorder);
+
+	/**
+	 * @brief Get the recorder of the instructions
+	 * @return Recorder, null when not recording
+	 */
+	TraceRecorder *traceRecorder() const;
+
+	/**
+	 * @brief Get the time of the song emulated so far
+	 *
+	 * At output rates other than 32 kHz, the DSP is a few
+	 * samples ahead of the output for the resampler.
+	 * @return Milliseconds since the file was loaded
+	 */
+	int position() const;
+
+	/**
+	 * @brief Start rendering ahead in a worker thread
+	 *
+	 * The worker keeps a lock-free ring buffer filled with the next
+	 * latencyFrames frames, the audio thread reads them with
+	 * readRenderedAhead(). While the worker runs, only the render ahead
+	 * methods can be called on the runner.
+	 * @param latencyFrames Frames to keep ready, at the output sample rate
+	 * @return false if the worker is already running or the latency is 0
+	 */
+	bool startRenderAhead(size_t latencyFrames);
+
+	/**
+	 * @brief Stop the render ahead worker
+	 *
+	 * Frames still in the ring are dropped, the next render()
+	 * continues after the last frame the worker rendered.
+	 */
+	void stopRenderAhead();
+
+	/**
+	 * @brief Check if the render ahead worker is running
+	 * @return true if the worker is running
+	 */
+	bool isRenderingAhead() const;
+
+	/**
+	 * @brief Read frames rendered by the worker
+	 *
+	 * Wait-free, it can be called from a realtime audio callback.
+	 * Missing frames are filled with silence and counted as an underrun.
+	 * @param interleaved Interleaved left/right output
+	 * @param frames Number of frames wanted
+	 * @return Number of rendered frames read
+	 */
+	size_t readRenderedAhead(s16 *interleaved, size_t frames);
+
+	/**
+	 * @brief Get the number of frames ready to be read
+	 * @return Frames
+	 */
+	size_t renderedAheadAvailable() const;
+
+	/**
+	 * @brief Get the number of reads that were short of frames
+	 * @return Underrun count since the worker was started
+	 */
+	unsigned long renderAheadUnderruns() const;
+
+	/**
+	 * @brief Get the number of times the worker fell behind
+	 *
+	 * The worker never drops frames, it only renders into the free
+	 * space. An overrun is counted when it comes back to refill the
+	 * ring and finds it empty: the reader took everything before the
+	 * worker could keep the latency target. A growing count calls
+	 * for a larger latency.
+	 * @return Overrun count since the worker was started
+	 */
+	unsigned long renderAheadOverruns() const;
+
+	/**
+	 * @brief Mute or unmute a voice
+	 *
+	 * A muted voice keeps running so the song plays the same,
+	 * only its interpolation and mixing are skipped. The voice
+	 * is heard again as soon as it is unmuted.
+	 * @param voice Voice index, 0 to 7
+	 * @param muted true to mute the voice
+	 */
+	void setVoiceMuted(int voice, bool muted);
+
+	/**
+	 * @brief Check if a voice is muted
+	 * @param voice Voice index, 0 to 7
+	 * @return true if the voice is muted
+	 */
+	bool isVoiceMuted(int voice) const;
+
+	/**
+	 * @brief Mute every voice except the given one
+	 * @param voice Voice index, 0 to 7
+	 */
+	void soloVoice(int voice);
+
+	/**
+	 * @brief Set all the muted voices at once
+	 * @param mask Bit mask, bit 0 for voice 0. Use 0 to unmute all the voices.
+	 */
+	void setMutedVoices(byte mask);
+
+	/**
+	 * @brief Get the muted voices
+	 * @return Bit mask, bit 0 for voice 0
+	 */
+	byte mutedVoices() const;
+
+	/**
+	 * @brief Output each voice and the echo return into separate buffers
+	 *
+	 * The buffers are filled along the normal output, in the same
+	 * pass, from their start. They must be large enough for everything
+	 * rendered until they are changed or removed.
+	 * @param buffers Stem buffers, copied. Use null to disable the separate output.
+	 * @see StemBuffers
+	 */
+	void setStemBuffers(const StemBuffers *buffers);
+
+	/**
+	 * @brief Set the number of samples emulated at once
+	 *
+	 * The CPU runs for a whole block while its DSP writes are
+	 * queued. The DSP lags behind and only catches up when the CPU
+	 * reads ENVX, OUTX or ENDX, when its write queue is full, and at
+	 * the end of the block. This is the most the DSP can lag behind the
+	 * CPU. The output does not depend on the block size.
+	 * @param sampleCount Samples per block, from 1 to MaxBlockSize
+	 */
+	void setBlockSize(int sampleCount);
+
+	/**
+	 * @brief Get the number of samples emulated at once
+	 * @return Samples per block
+	 */
+	int blockSize() const;
+
+	/**
+	 * @brief Set the sample rate of the output
+	 *
+	 * The DSP generates 32 kHz samples, they go through a polyphase
+	 * resampler for other rates. At 32 kHz, the resampler is skipped.
+	 * The stem buffers always receive the 32 kHz samples.
+	 * @param rate Output rate in Hz, like 44100 or 48000
+	 * @param quality Quality of the resampling filters
+	 */
+	void setOutputSampleRate(int rate, Resampler::Quality quality = Resampler::MediumQuality);
+
+	/**
+	 * @brief Get the sample rate of the output
+	 * @return Rate in Hz
+	 */
+	int outputSampleRate() const;
+
+	enum
+	{
+		DefaultBlockSize = 8192,
+		MaxBlockSize = 65536,
+		DefaultCheckpointInterval = 10, ///< Seconds, see renderParallel()
+		DefaultRewindBudget = 4 * 1024 * 1024 ///< Bytes, see setRewind()
+	};
+
 protected:
 	/**
 	 * @internal
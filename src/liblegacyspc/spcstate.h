@@ -0,0 +1,182 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SPCSTATE_H
+#define LEGACYSPC_SPCSTATE_H
+
+#include <types.h>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief State of a SPC700 processor between two instructions
+ */
+struct ProcessorState
+{
+	uint16 programCounter;
+	byte a;
+	byte x;
+	byte y;
+	byte stackPointer;
+	byte programStatus;
+	/**
+	 * @brief Always 0, there is no padding to leave undefined
+	 */
+	byte reserved;
+	/**
+	 * @brief Cycles run past the last rendered sample
+	 */
+	int cycles;
+};
+
+/**
+ * @brief State of a timer
+ */
+struct TimerState
+{
+	bool enabled;
+	byte target;
+	/**
+	 * @brief 4-bit output counter, cleared when read
+	 */
+	byte counter;
+	/**
+	 * @brief Always 0, there is no padding to leave undefined
+	 */
+	byte reserved;
+	int divider;
+	/**
+	 * @brief Cycles not yet counted as a tick
+	 */
+	int elapsed;
+};
+
+/**
+ * @brief State of the memory mapped I/O not kept in RAM
+ */
+struct IoState
+{
+	TimerState timers[3];
+	/**
+	 * @brief CPU time the timers are up to
+	 */
+	int timerCycles;
+	/**
+	 * @brief Values written by the main CPU, read from $F4-$F7
+	 */
+	byte inputPorts[4];
+};
+
+/**
+ * @brief Internal state of a DSP voice
+ */
+struct DspVoiceState
+{
+	/**
+	 * @brief Decoded samples, each sample is stored twice so the
+	 * interpolation never has to wrap around
+	 */
+	int buffer[24];
+	/**
+	 * @brief Position of the oldest group of 4 samples in buffer
+	 */
+	int bufferPosition;
+	/**
+	 * @brief 12-bit fraction of the position between the decoded samples
+	 */
+	int interpolationPosition;
+	int brrAddress;
+	int brrOffset;
+	int envelope;
+	int envelopeMode;
+	/**
+	 * @brief Output of the last sample, used for pitch modulation
+	 */
+	int output;
+};
+
+/**
+ * @brief Internal state of the DSP between two samples
+ */
+struct DspState
+{
+	byte registers[128];
+	/**
+	 * @brief Last values written by the CPU, ahead of registers
+	 * while writes wait in the queue
+	 */
+	byte writtenRegisters[128];
+	DspVoiceState voices[8];
+
+	/**
+	 * @brief Global counter, decremented each sample
+	 */
+	int counter;
+	/**
+	 * @brief Noise generator shift register
+	 */
+	int noise;
+
+	int echoOffset;
+	int echoLength;
+	/**
+	 * @brief Last 8 echo samples, doubled like the BRR buffer
+	 */
+	int echoHistory[16][2];
+	int echoHistoryPosition;
+
+	/**
+	 * @brief Voices keyed on since the last sample
+	 */
+	byte newKeyOn;
+	byte activeVoices;
+	/**
+	 * @brief Always 0, there is no padding to leave undefined
+	 */
+	byte reserved[2];
+};
+
+/**
+ * @brief Complete emulation state of a SpcRunner
+ *
+ * Plain data, it can be copied around freely. Saving and
+ * restoring it is a few memory copies. The layout has no padding,
+ * every byte is written when saving, so states can be compared,
+ * stored and delta encoded as raw bytes. Bump SpcStateFile::Version
+ * when the layout changes.
+ * @see SpcRunner::saveState(), SpcStateFile
+ */
+struct SpcState
+{
+	/**
+	 * @brief DSP samples generated since the file was loaded
+	 */
+	long long position;
+	byte ram[0x10000];
+	ProcessorState processor;
+	IoState io;
+	DspState dsp;
+};
+
+// Any padding would be left undefined by saveState()
+static_assert(sizeof(ProcessorState) == 12, "ProcessorState has padding");
+static_assert(sizeof(TimerState) == 12, "TimerState has padding");
+static_assert(sizeof(IoState) == 44, "IoState has padding");
+static_assert(sizeof(DspState) == 1400, "DspState has padding");
+static_assert(sizeof(SpcState) == 8 + 0x10000 + 12 + 44 + 1400, "SpcState has padding");
+
+}
+
+#endif
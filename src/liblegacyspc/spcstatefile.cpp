@@ -0,0 +1,139 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "spcstatefile.h"
+
+// STL includes
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// LegacySPC includes
+#include "spcstate.h"
+
+namespace LegacySPC
+{
+
+static const char StateMagic[] = "LSPCSTAT";
+// Reads 0x04030201 when saved with the other byte order
+static const uint32 ByteOrderMark = 0x01020304;
+
+/**
+ * @internal
+ * @brief Header of a save-state, in the byte order of the platform
+ */
+struct StateHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 byteOrder;
+	uint32 stateSize;
+	uint32 reserved[3];
+};
+
+// The DSP uses these positions as array indices
+static bool checkDspPositions(const DspState &dsp)
+{
+	const int bufferSize = sizeof(DspVoiceState::buffer) / sizeof(int) / 2;
+	const int historySize = sizeof(DspState::echoHistory) / sizeof(DspState::echoHistory[0]) / 2;
+
+	for(int i = 0; i < 8; i++)
+	{
+		const DspVoiceState &voice = dsp.voices[i];
+		if( voice.bufferPosition < 0 || voice.bufferPosition >= bufferSize || (voice.bufferPosition & 3) )
+		{
+			return false;
+		}
+		// Below 0x4000 between two samples, the next group is decoded past it
+		if( voice.interpolationPosition < 0 || voice.interpolationPosition >= 0x4000 )
+		{
+			return false;
+		}
+	}
+
+	return dsp.echoHistoryPosition >= 0 && dsp.echoHistoryPosition < historySize;
+}
+
+size_t SpcStateFile::blobSize()
+{
+	return HeaderSize + sizeof(SpcState);
+}
+
+void SpcStateFile::save(const SpcState &state, byte *blob)
+{
+	StateHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, StateMagic, sizeof(header.magic));
+	header.version = Version;
+	header.byteOrder = ByteOrderMark;
+	header.stateSize = sizeof(SpcState);
+
+	memset(blob, 0, HeaderSize);
+	memcpy(blob, &header, sizeof(header));
+	memcpy(blob + HeaderSize, &state, sizeof(SpcState));
+}
+
+bool SpcStateFile::restore(const byte *blob, size_t size, SpcState &state)
+{
+	if( size < blobSize() )
+	{
+		return false;
+	}
+
+	StateHeader header;
+	memcpy(&header, blob, sizeof(header));
+	if( memcmp(header.magic, StateMagic, sizeof(header.magic)) != 0 || header.version != Version ||
+	    header.byteOrder != ByteOrderMark || header.stateSize != sizeof(SpcState) )
+	{
+		return false;
+	}
+
+	DspState dsp;
+	memcpy(&dsp, blob + HeaderSize + offsetof(SpcState, dsp), sizeof(DspState));
+	if( !checkDspPositions(dsp) )
+	{
+		return false;
+	}
+
+	memcpy(&state, blob + HeaderSize, sizeof(SpcState));
+	return true;
+}
+
+bool SpcStateFile::write(const std::string &filename, const SpcState &state)
+{
+	std::vector<byte> blob( blobSize() );
+	save(state, &blob[0]);
+
+	std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&blob[0]), blob.size());
+	file.close();
+
+	return !file.fail();
+}
+
+bool SpcStateFile::read(const std::string &filename, SpcState &state)
+{
+	std::vector<byte> blob( blobSize() );
+
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if( !file.read(reinterpret_cast<char*>(&blob[0]), blob.size()) )
+	{
+		return false;
+	}
+
+	return restore(&blob[0], blob.size(), state);
+}
+
+}
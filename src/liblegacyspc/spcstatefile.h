@@ -0,0 +1,112 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_SPCSTATEFILE_H
+#define LEGACYSPC_SPCSTATEFILE_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+#include <string>
+
+namespace LegacySPC
+{
+
+struct SpcState;
+
+/**
+ * @brief Native save-state format
+ *
+ * A save-state is a small header followed by the SpcState as laid
+ * out in memory. Saving and restoring are a memory copy each, there
+ * is nothing to parse.
+ *
+ * The header holds a version, bumped when SpcState changes, the
+ * size of SpcState and the byte order. A blob saved by another
+ * version, or on a platform with another layout, is refused
+ * instead of being misread. Use SpcFileWriter to exchange states
+ * between platforms.
+ *
+ * @code
+std::vector<LegacySPC::byte> blob(LegacySPC::SpcStateFile::blobSize());
+LegacySPC::SpcStateFile::save(state, &blob[0]);
+...
+if( LegacySPC::SpcStateFile::restore(&blob[0], blob.size(), state) )
+{
+	runner.restoreState(state);
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT SpcStateFile
+{
+public:
+	enum
+	{
+		/**
+		 * @brief Version of the SpcState layout
+		 */
+		Version = 2,
+		/**
+		 * @brief Size of the header, SpcState starts 8-byte aligned
+		 */
+		HeaderSize = 32
+	};
+
+	/**
+	 * @brief Get the size of a save-state
+	 * @return Header and state size in bytes
+	 */
+	static size_t blobSize();
+
+	/**
+	 * @brief Save a state in a buffer
+	 * @param state State to save
+	 * @param blob Buffer of blobSize() bytes
+	 */
+	static void save(const SpcState &state, byte *blob);
+
+	/**
+	 * @brief Restore a state from a buffer
+	 * @param blob Buffer filled by save()
+	 * @param size Size of the buffer
+	 * @param state Receives the state
+	 * @return false if the buffer is not a save-state of this version and platform,
+	 * or if its DSP buffer positions are out of range
+	 */
+	static bool restore(const byte *blob, size_t size, SpcState &state);
+
+	/**
+	 * @brief Save a state in a file
+	 * @param filename Path of the file
+	 * @param state State to save
+	 * @return false if the file can't be written
+	 */
+	static bool write(const std::string &filename, const SpcState &state);
+
+	/**
+	 * @brief Restore a state from a file
+	 * @param filename Path of the file
+	 * @param state Receives the state
+	 * @return false if the file can't be read or is not a valid save-state
+	 */
+	static bool read(const std::string &filename, SpcState &state);
+};
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "threadpool.h"
+
+// STL includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LegacySPC
+{
+
+// Index of the worker running on the current thread, -1 if none
+static thread_local int currentWorker = -1;
+static thread_local const void *currentPool = 0;
+
+/**
+ * @brief Task queue of one worker
+ *
+ * The owner uses the back, thieves the front. Each queue has its own
+ * lock, held only to move a task in or out.
+ */
+struct WorkerQueue
+{
+	std::mutex mutex;
+	std::deque<ThreadPool::Task> tasks;
+};
+
+class ThreadPool::Private
+{
+public:
+	Private()
+	 : queued(0), pending(0), stopping(false), nextQueue(0)
+	{}
+
+	bool takeTask(int worker, Task &task);
+	void runWorker(int worker);
+
+	std::vector<WorkerQueue*> queues;
+	std::vector<std::thread> threads;
+
+	// Tasks waiting in the queues
+	std::atomic<int> queued;
+	// Tasks submitted and not finished
+	std::atomic<int> pending;
+	std::atomic<bool> stopping;
+	std::atomic<unsigned int> nextQueue;
+
+	// Sleeping workers and wait() use these
+	std::mutex sleepMutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable allDone;
+};
+
+bool ThreadPool::Private::takeTask(int worker, Task &task)
+{
+	// Newest task of our own queue first
+	{
+		WorkerQueue *queue = queues[worker];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if( !queue->tasks.empty() )
+		{
+			task = queue->tasks.back();
+			queue->tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+
+	// Then steal the oldest task of the others
+	int count = static_cast<int>(queues.size());
+	for(int i = 1; i < count; i++)
+	{
+		WorkerQueue *queue = queues[(worker + i) % count];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if( !queue->tasks.empty() )
+		{
+			task = queue->tasks.front();
+			queue->tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::Private::runWorker(int worker)
+{
+	currentWorker = worker;
+	currentPool = this;
+
+	Task task;
+	for(;;)
+	{
+		if( takeTask(worker, task) )
+		{
+			task();
+			task = Task();
+
+			if( --pending == 0 )
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				allDone.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		if( stopping && queued == 0 )
+		{
+			break;
+		}
+		if( queued == 0 )
+		{
+			taskAvailable.wait(lock);
+		}
+	}
+}
+
+ThreadPool::ThreadPool(int threadCount)
+ : d(new Private)
+{
+	if( threadCount < 1 )
+	{
+		threadCount = static_cast<int>( std::thread::hardware_concurrency() );
+		if( threadCount < 1 )
+		{
+			threadCount = 1;
+		}
+	}
+
+	for(int i = 0; i < threadCount; i++)
+	{
+		d->queues.push_back(new WorkerQueue);
+	}
+	for(int i = 0; i < threadCount; i++)
+	{
+		d->threads.push_back( std::thread(&ThreadPool::Private::runWorker, d, i) );
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	wait();
+
+	{
+		std::lock_guard<std::mutex> lock(d->sleepMutex);
+		d->stopping = true;
+		d->taskAvailable.notify_all();
+	}
+
+	for(size_t i = 0; i < d->threads.size(); i++)
+	{
+		d->threads[i].join();
+	}
+	for(size_t i = 0; i < d->queues.size(); i++)
+	{
+		delete d->queues[i];
+	}
+
+	delete d;
+}
+
+int ThreadPool::threadCount() const
+{
+	return static_cast<int>(d->threads.size());
+}
+
+void ThreadPool::submit(const Task &task)
+{
+	int worker = currentPool == d ? currentWorker : -1;
+	if( worker < 0 )
+	{
+		worker = d->nextQueue++ % d->queues.size();
+	}
+
+	d->pending++;
+	{
+		WorkerQueue *queue = d->queues[worker];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->tasks.push_back(task);
+		d->queued++;
+	}
+
+	std::lock_guard<std::mutex> lock(d->sleepMutex);
+	d->taskAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(d->sleepMutex);
+	while( d->pending != 0 )
+	{
+		d->allDone.wait(lock);
+	}
+}
+
+}
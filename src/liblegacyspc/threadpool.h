@@ -0,0 +1,80 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_THREADPOOL_H
+#define LEGACYSPC_THREADPOOL_H
+
+#include <legacyspc_export.h>
+
+// STL includes
+#include <functional>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Work-stealing thread pool
+ *
+ * Each worker thread has its own queue of tasks. A worker takes
+ * the most recent task of its queue, and when its queue is empty it
+ * steals the oldest task of another worker. Tasks submitted from a
+ * worker go to its own queue, other tasks are spread over the queues.
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	/**
+	 * @brief Create the pool and start the threads
+	 * @param threadCount Number of threads, 0 for one per core
+	 */
+	ThreadPool(int threadCount = 0);
+	/**
+	 * @brief Wait for the tasks and stop the threads
+	 */
+	~ThreadPool();
+
+	/**
+	 * @brief Get the number of threads
+	 * @return Thread count
+	 */
+	int threadCount() const;
+
+	/**
+	 * @brief Add a task to run
+	 * @param task Task, can submit other tasks
+	 */
+	void submit(const Task &task);
+
+	/**
+	 * @brief Wait until all the submitted tasks are done
+	 *
+	 * Don't call from a task.
+	 */
+	void wait();
+
+private:
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "tracereader.h"
+
+// STL includes
+#include <cstring>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <fstream>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEGACYSPC_HAVE_MMAP
+#endif
+
+// LegacySPC includes
+#include "tracerecord.h"
+#include "tracerecorder.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+static const char TraceMagic[] = "LSPCTRCE";
+static const uint32 ByteOrderMark = 0x01020304;
+
+// Offsets in the header, see TraceRecorder::open()
+enum HeaderOffsets
+{
+	VersionOffset = 8,
+	ByteOrderOffset = 12,
+	RecordSizeOffset = 16
+};
+
+static uint32 readNative32(const byte *data)
+{
+	uint32 value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+class TraceReader::Private
+{
+public:
+	Private()
+	 : data(0), size(0), count(0)
+	{}
+
+	const byte *data;
+	size_t size;
+	size_t count;
+#ifndef LEGACYSPC_HAVE_MMAP
+	std::vector<byte> buffer;
+#endif
+};
+
+TraceReader::TraceReader()
+ : d(new Private)
+{
+}
+
+TraceReader::TraceReader(const std::string &filename)
+ : d(new Private)
+{
+	open(filename);
+}
+
+TraceReader::~TraceReader()
+{
+	close();
+	delete d;
+}
+
+bool TraceReader::open(const std::string &filename)
+{
+	close();
+
+	lDebug() << "Mapping trace" << filename;
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	int descriptor = ::open(filename.c_str(), O_RDONLY);
+	if( descriptor < 0 )
+	{
+		return false;
+	}
+
+	struct stat status;
+	if( fstat(descriptor, &status) != 0 || status.st_size < TraceRecorder::HeaderSize )
+	{
+		::close(descriptor);
+		return false;
+	}
+
+	void *mapping = mmap(0, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+	::close(descriptor);
+	if( mapping == MAP_FAILED )
+	{
+		return false;
+	}
+
+	d->data = static_cast<const byte*>(mapping);
+	d->size = status.st_size;
+#else
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if( !file )
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	if( fileSize < TraceRecorder::HeaderSize )
+	{
+		return false;
+	}
+
+	d->buffer.resize( static_cast<size_t>(fileSize) );
+	file.seekg(0, std::ios::beg);
+	if( !file.read(reinterpret_cast<char*>(&d->buffer[0]), fileSize) )
+	{
+		d->buffer.clear();
+		return false;
+	}
+
+	d->data = &d->buffer[0];
+	d->size = d->buffer.size();
+#endif
+
+	if( memcmp(d->data, TraceMagic, 8) != 0 || readNative32(d->data + VersionOffset) != TraceRecorder::Version ||
+	    readNative32(d->data + ByteOrderOffset) != ByteOrderMark || readNative32(d->data + RecordSizeOffset) != sizeof(TraceRecord) )
+	{
+		close();
+		return false;
+	}
+
+	d->count = (d->size - TraceRecorder::HeaderSize) / sizeof(TraceRecord);
+
+	return true;
+}
+
+void TraceReader::close()
+{
+	if( !d->data )
+	{
+		return;
+	}
+
+#ifdef LEGACYSPC_HAVE_MMAP
+	munmap(const_cast<byte*>(d->data), d->size);
+#else
+	std::vector<byte>().swap(d->buffer);
+#endif
+
+	d->data = 0;
+	d->size = 0;
+	d->count = 0;
+}
+
+bool TraceReader::isOpen() const
+{
+	return d->data != 0;
+}
+
+size_t TraceReader::count() const
+{
+	return d->count;
+}
+
+const TraceRecord *TraceReader::records() const
+{
+	return d->data ? reinterpret_cast<const TraceRecord*>(d->data + TraceRecorder::HeaderSize) : 0;
+}
+
+const TraceRecord &TraceReader::record(size_t index) const
+{
+	return records()[index];
+}
+
+}
@@ -0,0 +1,109 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_TRACEREADER_H
+#define LEGACYSPC_TRACEREADER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+#include <string>
+
+namespace LegacySPC
+{
+
+struct TraceRecord;
+
+/**
+ * @brief Trace file mapped in memory
+ *
+ * Gives access to the records written by TraceRecorder without
+ * copying them. A trace written by another version, or on a
+ * platform with another byte order, is refused.
+ *
+ * @code
+LegacySPC::TraceReader reader("song.trace");
+for(size_t i = 0; i < reader.count(); i++)
+{
+	const LegacySPC::TraceRecord &record = reader.record(i);
+	...
+}
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT TraceReader
+{
+public:
+	/**
+	 * @brief Create a reader with no file
+	 */
+	TraceReader();
+	/**
+	 * @brief Create a reader and map a file
+	 * @param filename Path of the trace
+	 */
+	explicit TraceReader(const std::string &filename);
+	/**
+	 * @brief Unmap the file
+	 */
+	~TraceReader();
+
+	/**
+	 * @brief Map a trace file
+	 * @param filename Path of the trace
+	 * @return false if the file can't be read or is not a valid trace
+	 */
+	bool open(const std::string &filename);
+
+	/**
+	 * @brief Unmap the file
+	 */
+	void close();
+
+	/**
+	 * @brief Check if a trace is mapped
+	 * @return true after a successful open()
+	 */
+	bool isOpen() const;
+
+	/**
+	 * @brief Get the number of records
+	 * @return Records in the file, a partial record at the end is left out
+	 */
+	size_t count() const;
+
+	/**
+	 * @brief Get all the records
+	 * @return count() records, valid until close()
+	 */
+	const TraceRecord *records() const;
+
+	/**
+	 * @brief Get a record
+	 * @param index Record from 0 to count() - 1
+	 * @return Record, valid until close()
+	 */
+	const TraceRecord &record(size_t index) const;
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
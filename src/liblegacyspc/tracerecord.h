@@ -0,0 +1,68 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_TRACERECORD_H
+#define LEGACYSPC_TRACERECORD_H
+
+#include <types.h>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Memory access kept in a TraceRecord
+ */
+enum TraceAccess
+{
+	NoAccess = 0, ///< The instruction only used registers
+	ReadAccess = 1, ///< Last data read of the instruction
+	WriteAccess = 2 ///< Last data write of the instruction, kept over the reads
+};
+
+/**
+ * @brief Instruction executed by the SPC700, as traced
+ *
+ * The registers are the ones before the instruction, the memory
+ * access is the one done by the instruction. The opcode fetch and
+ * the operands are not counted as accesses, a word access keeps
+ * its first address and byte.
+ *
+ * Plain data of 24 bytes, written as is in trace files.
+ * @see TraceRecorder, TraceReader
+ */
+struct TraceRecord
+{
+	/**
+	 * @brief CPU cycles since the file was loaded, at the start of the instruction
+	 */
+	unsigned long long cycle;
+	uint16 programCounter;
+	uint16 accessAddress;
+	byte opcode;
+	byte a;
+	byte x;
+	byte y;
+	byte stackPointer;
+	byte programStatus;
+	byte accessValue;
+	/**
+	 * @brief TraceAccess of accessAddress and accessValue
+	 */
+	byte accessType;
+	uint32 reserved;
+};
+
+}
+
+#endif
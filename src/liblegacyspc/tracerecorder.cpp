@@ -0,0 +1,205 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "tracerecorder.h"
+
+// STL includes
+#include <cstring>
+
+// LegacySPC includes
+#include "tracereader.h"
+#include "legacyspc_debug.h"
+
+namespace LegacySPC
+{
+
+static const char TraceMagic[] = "LSPCTRCE";
+// Reads 0x04030201 when written with the other byte order
+static const uint32 ByteOrderMark = 0x01020304;
+
+/**
+ * @internal
+ * @brief Header of a trace file, in the byte order of the platform
+ */
+struct TraceHeader
+{
+	char magic[8];
+	uint32 version;
+	uint32 byteOrder;
+	uint32 recordSize;
+	uint32 reserved[3];
+};
+
+TraceRecorder::TraceRecorder()
+ : m_buffer(new TraceRecord[BufferRecords]), m_count(0), m_flushed(0), m_cycleBase(0),
+   m_file(0), m_reference(0), m_divergence(-1)
+{
+	reset();
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	close();
+	delete[] m_buffer;
+}
+
+bool TraceRecorder::open(const std::string &filename)
+{
+	close();
+
+	lDebug() << "Recording trace" << filename;
+	reset();
+
+	m_file = std::fopen(filename.c_str(), "wb");
+	if( !m_file )
+	{
+		return false;
+	}
+
+	TraceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TraceMagic, sizeof(header.magic));
+	header.version = Version;
+	header.byteOrder = ByteOrderMark;
+	header.recordSize = sizeof(TraceRecord);
+
+	byte block[HeaderSize];
+	memset(block, 0, sizeof(block));
+	memcpy(block, &header, sizeof(header));
+	if( std::fwrite(block, sizeof(block), 1, m_file) != 1 )
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool TraceRecorder::compareWith(const std::string &filename)
+{
+	close();
+
+	reset();
+	m_reference = new TraceReader;
+	if( !m_reference->open(filename) )
+	{
+		delete m_reference;
+		m_reference = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void TraceRecorder::close()
+{
+	if( !isOpen() )
+	{
+		return;
+	}
+
+	flush();
+
+	if( m_file )
+	{
+		std::fclose(m_file);
+		m_file = 0;
+	}
+	delete m_reference;
+	m_reference = 0;
+}
+
+bool TraceRecorder::isOpen() const
+{
+	return m_file || m_reference;
+}
+
+void TraceRecorder::flush()
+{
+	if( m_file && m_count )
+	{
+		if( std::fwrite(m_buffer, sizeof(TraceRecord), m_count, m_file) != m_count )
+		{
+			lWarning() << "Could not write the trace records";
+		}
+	}
+	else if( m_reference )
+	{
+		compare();
+	}
+
+	m_flushed += m_count;
+	m_count = 0;
+}
+
+void TraceRecorder::reset()
+{
+	m_count = 0;
+	m_flushed = 0;
+	m_cycleBase = 0;
+	m_divergence = -1;
+	memset(&m_expected, 0, sizeof(m_expected));
+	memset(&m_actual, 0, sizeof(m_actual));
+}
+
+void TraceRecorder::compare()
+{
+	if( m_divergence >= 0 )
+	{
+		return;
+	}
+
+	for(size_t i = 0; i < m_count; i++)
+	{
+		unsigned long long index = m_flushed + i;
+		if( index >= m_reference->count() )
+		{
+			memset(&m_expected, 0, sizeof(m_expected));
+		}
+		else if( memcmp(&m_reference->record(index), &m_buffer[i], sizeof(TraceRecord)) == 0 )
+		{
+			continue;
+		}
+		else
+		{
+			m_expected = m_reference->record(index);
+		}
+
+		m_actual = m_buffer[i];
+		m_divergence = static_cast<long long>(index);
+		return;
+	}
+}
+
+unsigned long long TraceRecorder::recordCount() const
+{
+	return m_flushed + m_count;
+}
+
+long long TraceRecorder::divergence() const
+{
+	return m_divergence;
+}
+
+const TraceRecord &TraceRecorder::expectedRecord() const
+{
+	return m_expected;
+}
+
+const TraceRecord &TraceRecorder::actualRecord() const
+{
+	return m_actual;
+}
+
+}
@@ -0,0 +1,209 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_TRACERECORDER_H
+#define LEGACYSPC_TRACERECORDER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstdio>
+#include <string>
+
+// LegacySPC includes
+#include "tracerecord.h"
+
+namespace LegacySPC
+{
+
+class TraceReader;
+
+/**
+ * @brief Record the instructions executed by the SPC700
+ *
+ * The processor fills a TraceRecord in a buffer for each
+ * instruction, the buffer is written to the file when full, so
+ * recording costs a few stores per instruction.
+ *
+ * The file starts with a 32-byte header holding a version, the
+ * record size and the byte order, followed by the records as laid
+ * out in memory. Read it with TraceReader.
+ *
+ * Instead of writing a file, the records can be compared with a
+ * trace recorded before, to find the first instruction where a
+ * change of the emulator makes the song run differently.
+ *
+ * @code
+LegacySPC::TraceRecorder recorder;
+recorder.open("song.trace");
+runner.setTraceRecorder(&recorder);
+runner.render(0, frames);
+runner.setTraceRecorder(0);
+recorder.close();
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ * @see SpcRunner::setTraceRecorder()
+ */
+class LEGACYSPC_EXPORT TraceRecorder
+{
+public:
+	enum
+	{
+		/**
+		 * @brief Version of the TraceRecord layout
+		 */
+		Version = 1,
+		/**
+		 * @brief Size of the header, the records start 8-byte aligned
+		 */
+		HeaderSize = 32,
+		/**
+		 * @brief Records kept before writing or comparing them
+		 */
+		BufferRecords = 16384
+	};
+
+	/**
+	 * @brief Create a recorder with no output
+	 */
+	TraceRecorder();
+	/**
+	 * @brief Write the pending records and close
+	 */
+	~TraceRecorder();
+
+	/**
+	 * @brief Record to a file
+	 * @param filename Path of the file, replaced
+	 * @return false if the file can't be created
+	 */
+	bool open(const std::string &filename);
+
+	/**
+	 * @brief Compare the records with a trace file
+	 *
+	 * Nothing is written, the first record that differs from the
+	 * file, or comes after its end, is kept. See divergence().
+	 * @param filename Trace recorded before
+	 * @return false if the file is not a valid trace
+	 */
+	bool compareWith(const std::string &filename);
+
+	/**
+	 * @brief Write or compare the pending records and close
+	 */
+	void close();
+
+	/**
+	 * @brief Check if records are written or compared
+	 * @return true after a successful open() or compareWith()
+	 */
+	bool isOpen() const;
+
+	/**
+	 * @brief Write or compare the pending records now
+	 *
+	 * Done when the buffer is full and when closing.
+	 */
+	void flush();
+
+	/**
+	 * @brief Get the number of records since opening
+	 * @return Records, the pending ones included
+	 */
+	unsigned long long recordCount() const;
+
+	/**
+	 * @brief Get the first record different from the compared trace
+	 *
+	 * Only checked when the records are flushed.
+	 * @return Index of the record, -1 while the traces match
+	 */
+	long long divergence() const;
+
+	/**
+	 * @brief Get the record of the compared trace at divergence()
+	 * @return Record, zero-filled if the compared trace ended before
+	 */
+	const TraceRecord &expectedRecord() const;
+
+	/**
+	 * @brief Get the record made at divergence()
+	 * @return Record
+	 */
+	const TraceRecord &actualRecord() const;
+
+	/**
+	 * @internal
+	 * @brief Set the cycle of the start of the current block
+	 * @param cycle CPU cycles since the file was loaded
+	 */
+	void setCycleBase(unsigned long long cycle)
+	{
+		m_cycleBase = cycle;
+	}
+
+	/**
+	 * @internal
+	 * @brief Get the cycle of the start of the current block
+	 * @return CPU cycles since the file was loaded
+	 */
+	unsigned long long cycleBase() const
+	{
+		return m_cycleBase;
+	}
+
+	/**
+	 * @internal
+	 * @brief Get the record to fill for the next instruction
+	 * @return Record in the buffer, valid until commit()
+	 */
+	TraceRecord &append()
+	{
+		return m_buffer[m_count];
+	}
+
+	/**
+	 * @internal
+	 * @brief Keep the record filled after append()
+	 */
+	void commit()
+	{
+		if( ++m_count == BufferRecords )
+		{
+			flush();
+		}
+	}
+
+private:
+	void reset();
+	void compare();
+
+	TraceRecord *m_buffer;
+	size_t m_count;
+	unsigned long long m_flushed;
+	unsigned long long m_cycleBase;
+
+	std::FILE *m_file;
+	TraceReader *m_reference;
+	long long m_divergence;
+	TraceRecord m_expected;
+	TraceRecord m_actual;
+};
+
+}
+
+#endif
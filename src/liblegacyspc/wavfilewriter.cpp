@@ -0,0 +1,159 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include "wavfilewriter.h"
+
+// STL includes
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+namespace LegacySPC
+{
+
+static const int HeaderSize = 44;
+static const int Channels = 2;
+static const int BytesPerSample = 2;
+
+class WavFileWriter::Private
+{
+public:
+	Private()
+	 : sampleRate(0), frameCount(0), failed(false)
+	{}
+
+	void writeHeader();
+
+	void write16(int value)
+	{
+		char bytes[2] = { static_cast<char>(value), static_cast<char>(value >> 8) };
+		file.write(bytes, 2);
+	}
+
+	void write32(unsigned int value)
+	{
+		char bytes[4] = { static_cast<char>(value), static_cast<char>(value >> 8),
+		                  static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+		file.write(bytes, 4);
+	}
+
+	ofstream file;
+	int sampleRate;
+	size_t frameCount;
+	bool failed;
+	// Little-endian samples for one write
+	vector<char> buffer;
+};
+
+void WavFileWriter::Private::writeHeader()
+{
+	unsigned int dataSize = static_cast<unsigned int>(frameCount * Channels * BytesPerSample);
+
+	file.write("RIFF", 4);
+	write32(HeaderSize - 8 + dataSize);
+	file.write("WAVE", 4);
+
+	file.write("fmt ", 4);
+	write32(16);
+	// PCM
+	write16(1);
+	write16(Channels);
+	write32(sampleRate);
+	write32(sampleRate * Channels * BytesPerSample);
+	write16(Channels * BytesPerSample);
+	write16(BytesPerSample * 8);
+
+	file.write("data", 4);
+	write32(dataSize);
+}
+
+WavFileWriter::WavFileWriter()
+ : d(new Private)
+{
+}
+
+WavFileWriter::~WavFileWriter()
+{
+	close();
+	delete d;
+}
+
+bool WavFileWriter::open(const std::string &filename, int sampleRate)
+{
+	close();
+
+	d->file.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	if( !d->file )
+	{
+		return false;
+	}
+
+	d->frameCount = 0;
+	d->failed = false;
+	d->sampleRate = sampleRate;
+	d->writeHeader();
+
+	return d->file.good();
+}
+
+bool WavFileWriter::write(const s16 *interleaved, size_t frames)
+{
+	if( !d->file.is_open() )
+	{
+		return false;
+	}
+
+	size_t size = frames * Channels * BytesPerSample;
+	if( d->buffer.size() < size )
+	{
+		d->buffer.resize(size);
+	}
+
+	for(size_t i = 0; i < frames * Channels; i++)
+	{
+		d->buffer[i * 2] = static_cast<char>(interleaved[i]);
+		d->buffer[i * 2 + 1] = static_cast<char>(interleaved[i] >> 8);
+	}
+
+	d->file.write(&d->buffer[0], size);
+	d->frameCount += frames;
+	d->failed = d->failed || !d->file.good();
+
+	return !d->failed;
+}
+
+bool WavFileWriter::close()
+{
+	if( !d->file.is_open() )
+	{
+		return false;
+	}
+
+	// Rewrite the header with the sizes
+	d->file.seekp(0);
+	d->writeHeader();
+
+	bool success = !d->failed && d->file.good();
+	d->file.close();
+
+	return success;
+}
+
+size_t WavFileWriter::frameCount() const
+{
+	return d->frameCount;
+}
+
+}
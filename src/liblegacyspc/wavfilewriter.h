@@ -0,0 +1,89 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LEGACYSPC_WAVFILEWRITER_H
+#define LEGACYSPC_WAVFILEWRITER_H
+
+#include <legacyspc_export.h>
+#include <types.h>
+
+// STL includes
+#include <cstddef>
+#include <string>
+
+namespace LegacySPC
+{
+
+/**
+ * @brief Write 16-bit stereo PCM to a WAV file
+ * @code
+LegacySPC::WavFileWriter writer;
+if( !writer.open("song.wav", 32000) )
+{
+	std::cerr << "Can't write song.wav" << std::endl;
+}
+writer.write(samples, frameCount);
+writer.close();
+ * @endcode
+ *
+ * @author Michaël Larouche <larouche@kde.org>
+ */
+class LEGACYSPC_EXPORT WavFileWriter
+{
+public:
+	/**
+	 * @brief Create a new instance of WavFileWriter
+	 */
+	WavFileWriter();
+	/**
+	 * @brief Close the file if it is still open
+	 */
+	~WavFileWriter();
+
+	/**
+	 * @brief Create the file and write the header
+	 * @param filename Path of the WAV file
+	 * @param sampleRate Sample rate in Hz
+	 * @return false if the file can't be created
+	 */
+	bool open(const std::string &filename, int sampleRate);
+
+	/**
+	 * @brief Append frames
+	 * @param interleaved Interleaved left/right samples
+	 * @param frames Number of stereo frames
+	 * @return false if writing failed
+	 */
+	bool write(const s16 *interleaved, size_t frames);
+
+	/**
+	 * @brief Set the final sizes in the header and close the file
+	 * @return false if writing failed
+	 */
+	bool close();
+
+	/**
+	 * @brief Get the number of frames written
+	 * @return Frames
+	 */
+	size_t frameCount() const;
+
+private:
+	class Private;
+	Private *d;
+};
+
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// STL includes
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// LegacySPC includes
+#include <batchrenderer.h>
+
+using namespace std;
+using namespace LegacySPC;
+
+void showheader()
+{
+	cout << "LegacySPC batch renderer, part of LegacySPC distribution" << endl;
+	cout << "Copyright 2011 Michaël Larouche" << endl;
+	cout << "Licensed under GNU Library General Public License v2" << endl;
+}
+
+void showusage()
+{
+	cout << endl;
+	cout << "Usage: spcbatch [OPTIONS] FILE..." << endl;
+	cout << "Render each SPC file to a WAV file." << endl;
+	cout << endl;
+	cout << "  -j THREADS  Number of threads, one per core by default" << endl;
+	cout << "  -r RATE     Sample rate of the WAV files, 32000 by default" << endl;
+	cout << "  -o DIR      Write the WAV files in DIR instead of next to the SPC files" << endl;
+	cout << "  -l FILE     Read the SPC files to render from FILE, one per line" << endl;
+	cout << "  -t SECONDS  Song length when the ID666 tag has none, 180 by default" << endl;
+	cout << "  -f MS       Fadeout length when the ID666 tag has none, 10000 by default" << endl;
+	cout << "  -s MS       Stop a song after MS milliseconds of silence" << endl;
+	cout << "  -S LEVEL    Highest sample value counted as silence, 0 by default" << endl;
+	cout << "  -H          Stop a song when its CPU executes SLEEP or STOP" << endl;
+}
+
+string outputFileName(const string &inputFile, const string &outputDirectory)
+{
+	string name = inputFile;
+	string::size_type extension = name.rfind('.');
+	string::size_type separator = name.find_last_of("/\\");
+	if( extension != string::npos && (separator == string::npos || extension > separator) )
+	{
+		name.erase(extension);
+	}
+	name += ".wav";
+
+	if( outputDirectory.empty() )
+	{
+		return name;
+	}
+
+	if( separator != string::npos )
+	{
+		name.erase(0, separator + 1);
+	}
+
+	return outputDirectory + "/" + name;
+}
+
+int main(int argc, char **argv)
+{
+	showheader();
+
+	BatchRenderer renderer;
+	string outputDirectory;
+	vector<string> inputFiles;
+	int songLength = 180;
+	int fadeoutLength = 10000;
+	int silenceLength = 0;
+	int silenceThreshold = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if( argument == "-j" && hasValue )
+		{
+			renderer.setThreadCount( atoi(argv[++i]) );
+		}
+		else if( argument == "-r" && hasValue )
+		{
+			renderer.setOutputSampleRate( atoi(argv[++i]) );
+		}
+		else if( argument == "-o" && hasValue )
+		{
+			outputDirectory = argv[++i];
+		}
+		else if( argument == "-l" && hasValue )
+		{
+			ifstream list(argv[++i]);
+			if( !list )
+			{
+				cerr << "Error while reading the list " << argv[i] << endl;
+				return 1;
+			}
+
+			string line;
+			while( getline(list, line) )
+			{
+				if( !line.empty() )
+				{
+					inputFiles.push_back(line);
+				}
+			}
+		}
+		else if( argument == "-t" && hasValue )
+		{
+			songLength = atoi(argv[++i]);
+		}
+		else if( argument == "-f" && hasValue )
+		{
+			fadeoutLength = atoi(argv[++i]);
+		}
+		else if( argument == "-s" && hasValue )
+		{
+			silenceLength = atoi(argv[++i]);
+		}
+		else if( argument == "-S" && hasValue )
+		{
+			silenceThreshold = atoi(argv[++i]);
+		}
+		else if( argument == "-H" )
+		{
+			renderer.setHaltDetection(true);
+		}
+		else if( argument[0] == '-' )
+		{
+			showusage();
+			return 1;
+		}
+		else
+		{
+			inputFiles.push_back(argument);
+		}
+	}
+
+	if( inputFiles.empty() )
+	{
+		showusage();
+		return 1;
+	}
+
+	renderer.setDefaultLengths(songLength, fadeoutLength);
+	renderer.setSilenceDetection(silenceLength, silenceThreshold);
+
+	vector<BatchJob> jobs;
+	for(size_t i = 0; i < inputFiles.size(); i++)
+	{
+		jobs.push_back( BatchJob(inputFiles[i], outputFileName(inputFiles[i], outputDirectory)) );
+	}
+
+	vector<BatchJobResult> results = renderer.render(jobs);
+
+	cout << fixed << setprecision(2);
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BatchJobResult &result = results[i];
+		if( result.success )
+		{
+			cout << result.job.inputFile << ": " << result.emulatedSeconds << " s in "
+			     << result.wallSeconds << " s (" << result.emulatedSeconds / result.wallSeconds << "x)";
+			if( result.endReason == SpcRunner::SilenceDetected )
+			{
+				cout << ", ended on silence";
+			}
+			else if( result.endReason == SpcRunner::ProcessorHalted )
+			{
+				cout << ", ended on a halted CPU";
+			}
+			cout << endl;
+		}
+		else
+		{
+			cerr << result.job.inputFile << ": " << result.errorMessage << endl;
+		}
+	}
+
+	BatchSummary summary = renderer.summary();
+	cout << endl;
+	cout << summary.succeeded << " rendered, " << summary.failed << " failed" << endl;
+	cout << summary.emulatedSeconds << " emulated seconds in " << summary.wallSeconds << " s" << endl;
+	cout << "Throughput: " << summary.throughput() << " emulated seconds per second" << endl;
+
+	return summary.failed == 0 ? 0 : 1;
+}
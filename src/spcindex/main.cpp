@@ -0,0 +1,216 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// STL includes
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// LegacySPC includes
+#include <spcindex.h>
+
+using namespace std;
+using namespace LegacySPC;
+
+void showheader()
+{
+	cout << "LegacySPC library indexer, part of LegacySPC distribution" << endl;
+	cout << "Copyright 2011 Michaël Larouche" << endl;
+	cout << "Licensed under GNU Library General Public License v2" << endl;
+}
+
+void showusage()
+{
+	cout << endl;
+	cout << "Usage: spcindex [OPTIONS] INDEX [PATH...]" << endl;
+	cout << "Index the SPC files of each PATH, a directory or a file, in INDEX." << endl;
+	cout << "Without PATH, read INDEX." << endl;
+	cout << endl;
+	cout << "  -j THREADS  Number of threads, one per core by default" << endl;
+	cout << "  -s TEXT     List the files with a title, game or artist containing TEXT" << endl;
+	cout << "  -f HASH     List the files with the content hash HASH, in hexadecimal" << endl;
+	cout << "  -a          List all the files" << endl;
+	cout << "  -d          List the files with the same content, only one of them needs a render" << endl;
+}
+
+void showentry(const SpcIndexEntry &entry)
+{
+	cout << hex << setw(16) << setfill('0') << entry.contentHash << dec << setfill(' ')
+	     << "  " << entry.path << endl;
+	cout << "    " << entry.gameTitle << " - " << entry.songTitle;
+	if( *entry.artistName )
+	{
+		cout << " (" << entry.artistName << ")";
+	}
+	if( entry.songLength > 0 )
+	{
+		cout << ", " << entry.songLength / 1000 << " s";
+	}
+	cout << endl;
+}
+
+int main(int argc, char **argv)
+{
+	showheader();
+
+	string indexFile;
+	vector<string> paths;
+	int threadCount = 0;
+	string searchText;
+	bool search = false;
+	string hash;
+	bool listAll = false;
+	bool listDuplicates = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if( argument == "-j" && hasValue )
+		{
+			threadCount = atoi(argv[++i]);
+		}
+		else if( argument == "-s" && hasValue )
+		{
+			searchText = argv[++i];
+			search = true;
+		}
+		else if( argument == "-f" && hasValue )
+		{
+			hash = argv[++i];
+		}
+		else if( argument == "-a" )
+		{
+			listAll = true;
+		}
+		else if( argument == "-d" )
+		{
+			listDuplicates = true;
+		}
+		else if( argument[0] == '-' )
+		{
+			showusage();
+			return 1;
+		}
+		else if( indexFile.empty() )
+		{
+			indexFile = argument;
+		}
+		else
+		{
+			paths.push_back(argument);
+		}
+	}
+
+	if( indexFile.empty() )
+	{
+		showusage();
+		return 1;
+	}
+
+	if( !paths.empty() )
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		vector<string> files;
+		for(size_t i = 0; i < paths.size(); i++)
+		{
+			vector<string> found = SpcIndex::findSpcFiles(paths[i]);
+			files.insert(files.end(), found.begin(), found.end());
+		}
+
+		int indexed = SpcIndex::build(files, indexFile, threadCount);
+		if( indexed < 0 )
+		{
+			cerr << "Error while writing the index " << indexFile << endl;
+			return 1;
+		}
+
+		double seconds = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+		cout << fixed << setprecision(2);
+		cout << indexed << " files indexed, " << files.size() - indexed << " skipped in " << seconds << " s" << endl;
+	}
+
+	SpcIndex index(indexFile);
+	if( !index.isOpen() )
+	{
+		cerr << "Error while reading the index " << indexFile << endl;
+		return 1;
+	}
+
+	if( search )
+	{
+		vector<int> found = index.search(searchText);
+		for(size_t i = 0; i < found.size(); i++)
+		{
+			showentry( index.entry(found[i]) );
+		}
+	}
+	else if( !hash.empty() )
+	{
+		unsigned long long contentHash = strtoull(hash.c_str(), 0, 16);
+		for(int i = index.find(contentHash); i >= 0 && i < index.count() && index.entry(i).contentHash == contentHash; i++)
+		{
+			showentry( index.entry(i) );
+		}
+	}
+	else if( listDuplicates )
+	{
+		// The entries are sorted by hash, the duplicates follow each other
+		int groups = 0;
+		int duplicates = 0;
+		for(int i = 0; i < index.count(); )
+		{
+			unsigned long long contentHash = index.entry(i).contentHash;
+			int end = i + 1;
+			while( end < index.count() && index.entry(end).contentHash == contentHash )
+			{
+				end++;
+			}
+
+			if( end - i > 1 )
+			{
+				groups++;
+				duplicates += end - i - 1;
+
+				cout << hex << setw(16) << setfill('0') << contentHash << dec << setfill(' ')
+				     << ", " << end - i << " files" << endl;
+				for(; i < end; i++)
+				{
+					cout << "    " << index.entry(i).path << endl;
+				}
+			}
+			i = end;
+		}
+
+		cout << groups << " contents shared by several files, " << duplicates << " renders saved out of " << index.count() << endl;
+	}
+	else if( listAll )
+	{
+		for(int i = 0; i < index.count(); i++)
+		{
+			showentry( index.entry(i) );
+		}
+	}
+	else
+	{
+		cout << index.count() << " files in " << indexFile << endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+// LegacySPC includes
+#include <batchrenderer.h>
+#include <threadpool.h>
+#include <wavfilewriter.h>
+
+using namespace LegacySPC;
+
+static std::vector<char> readFile(const char *filename)
+{
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+	return std::vector<char>( (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>() );
+}
+
+static unsigned int read32(const std::vector<char> &data, size_t offset)
+{
+	return static_cast<unsigned char>(data[offset]) |
+	       static_cast<unsigned char>(data[offset + 1]) << 8 |
+	       static_cast<unsigned char>(data[offset + 2]) << 16 |
+	       static_cast<unsigned int>( static_cast<unsigned char>(data[offset + 3]) ) << 24;
+}
+
+TEST(TestBatchRenderer, ThreadPoolRunsNestedTasks)
+{
+	ThreadPool pool(3);
+	EXPECT_EQ( pool.threadCount(), 3 );
+
+	std::atomic<int> count(0);
+	for(int i = 0; i < 100; i++)
+	{
+		pool.submit( [&pool, &count]()
+		{
+			for(int j = 0; j < 10; j++)
+			{
+				pool.submit( [&count]() { count++; } );
+			}
+			count++;
+		} );
+	}
+	pool.wait();
+
+	EXPECT_EQ( count.load(), 100 * 11 );
+}
+
+TEST(TestBatchRenderer, WavHeader)
+{
+	const char *filename = "testbatchrenderer_header.wav";
+	s16 frames[4 * 2] = { 1, -1, 2, -2, 3, -3, 4, -4 };
+
+	WavFileWriter writer;
+	ASSERT_TRUE( writer.open(filename, 32000) );
+	EXPECT_TRUE( writer.write(frames, 4) );
+	EXPECT_TRUE( writer.write(frames, 2) );
+	EXPECT_EQ( writer.frameCount(), 6u );
+	EXPECT_TRUE( writer.close() );
+
+	std::vector<char> data = readFile(filename);
+	std::remove(filename);
+
+	ASSERT_EQ( data.size(), 44u + 6 * 4 );
+	EXPECT_EQ( std::string(&data[0], 4), "RIFF" );
+	EXPECT_EQ( read32(data, 4), 36u + 6 * 4 );
+	EXPECT_EQ( std::string(&data[8], 4), "WAVE" );
+	EXPECT_EQ( read32(data, 24), 32000u );
+	EXPECT_EQ( std::string(&data[36], 4), "data" );
+	EXPECT_EQ( read32(data, 40), 6u * 4 );
+	// Little-endian samples
+	EXPECT_EQ( data[44], 1 );
+	EXPECT_EQ( data[46], -1 );
+	EXPECT_EQ( data[47], -1 );
+}
+
+TEST(TestBatchRenderer, RenderJobs)
+{
+	const char *filename = "testbatchrenderer_dkc2.wav";
+
+	std::vector<BatchJob> jobs;
+	jobs.push_back( BatchJob(LEGACYSPC_TESTDATA"dkc2_roller_coaster.spc", filename) );
+	jobs.push_back( BatchJob(LEGACYSPC_TESTDATA"notaspcfile", "testbatchrenderer_invalid.wav") );
+
+	BatchRenderer renderer;
+	renderer.setThreadCount(2);
+	// The dkc2 tag has no lengths
+	renderer.setDefaultLengths(1, 500);
+
+	std::vector<BatchJobResult> results = renderer.render(jobs);
+	ASSERT_EQ( results.size(), 2u );
+
+	EXPECT_TRUE( results[0].success );
+	EXPECT_DOUBLE_EQ( results[0].emulatedSeconds, 1.5 );
+	EXPECT_FALSE( results[1].success );
+	EXPECT_FALSE( results[1].errorMessage.empty() );
+
+	BatchSummary summary = renderer.summary();
+	EXPECT_EQ( summary.succeeded, 1 );
+	EXPECT_EQ( summary.failed, 1 );
+	EXPECT_DOUBLE_EQ( summary.emulatedSeconds, 1.5 );
+	EXPECT_GT( summary.throughput(), 0.0 );
+
+	std::vector<char> data = readFile(filename);
+	std::remove(filename);
+	ASSERT_EQ( data.size(), 44u + 48000 * 4 );
+	EXPECT_EQ( read32(data, 40), 48000u * 4 );
+}
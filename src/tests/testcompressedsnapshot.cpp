@@ -0,0 +1,138 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// LegacySPC includes
+#include <compressedsnapshot.h>
+#include <snapshotcodec.h>
+#include <spcrunner.h>
+#include <spcstate.h>
+
+using namespace LegacySPC;
+
+static const int FrameCount = 8000;
+
+static void roundTrip(const std::vector<byte> &data, const std::vector<byte> &reference)
+{
+	const byte *referenceData = reference.empty() ? 0 : &reference[0];
+
+	std::vector<byte> encoded;
+	SnapshotCodec::encode(&data[0], referenceData, data.size(), encoded);
+
+	std::vector<byte> decoded(data.size(), 0xAA);
+	EXPECT_EQ( SnapshotCodec::decode(&encoded[0], encoded.size(), referenceData, &decoded[0], decoded.size()), encoded.size() );
+	EXPECT_TRUE( decoded == data );
+}
+
+TEST(TestCompressedSnapshot, CodecRoundTrip)
+{
+	std::vector<byte> none;
+	std::vector<byte> data(0x10000, 0);
+	roundTrip(data, none);
+
+	srand(42);
+	for(size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = static_cast<byte>(rand());
+	}
+	roundTrip(data, none);
+	roundTrip(data, data);
+
+	// Runs, repeated blocks and literals mixed up
+	std::vector<byte> reference(data);
+	for(size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = (i % 1000 < 300) ? 0x55 : static_cast<byte>(i % 37);
+	}
+	for(size_t i = 0; i < data.size(); i += 97)
+	{
+		data[i] = reference[i];
+	}
+	roundTrip(data, none);
+	roundTrip(data, reference);
+
+	// Sizes around the inline length limit
+	for(size_t size = 1; size < 200; size++)
+	{
+		roundTrip(std::vector<byte>(size, 0), none);
+		roundTrip(std::vector<byte>(size, 7), none);
+		roundTrip(std::vector<byte>(data.begin(), data.begin() + size), none);
+	}
+}
+
+TEST(TestCompressedSnapshot, CodecRejectsInvalidStream)
+{
+	std::vector<byte> data(4096);
+	for(size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = static_cast<byte>(i * 7 + (i >> 5));
+	}
+
+	std::vector<byte> encoded;
+	SnapshotCodec::encode(&data[0], 0, data.size(), encoded);
+
+	std::vector<byte> decoded(data.size());
+	for(size_t size = 0; size < encoded.size(); size++)
+	{
+		EXPECT_EQ( SnapshotCodec::decode(&encoded[0], size, 0, &decoded[0], decoded.size()), 0u );
+	}
+
+	// A match before the start of the data
+	const byte badMatch[] = { 0x03 | (8 << 2), 0x01 };
+	EXPECT_EQ( SnapshotCodec::decode(badMatch, sizeof(badMatch), 0, &decoded[0], 8), 0u );
+	// A run longer than the data
+	const byte longRun[] = { 0x00 | (9 << 2) };
+	EXPECT_EQ( SnapshotCodec::decode(longRun, sizeof(longRun), 0, &decoded[0], 8), 0u );
+}
+
+TEST(TestCompressedSnapshot, RestoreRunningState)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	runner.render(static_cast<s16*>(0), FrameCount);
+
+	CompressedSnapshot snapshot;
+	EXPECT_TRUE( snapshot.isEmpty() );
+	runner.saveSnapshot(snapshot);
+	EXPECT_FALSE( snapshot.isEmpty() );
+	EXPECT_LT( snapshot.size(), sizeof(SpcState) / 8 );
+
+	std::unique_ptr<SpcState> saved(new SpcState);
+	runner.saveState(*saved);
+	EXPECT_EQ( snapshot.position(), saved->position );
+
+	std::vector<s16> expected(FrameCount * 2);
+	runner.render(&expected[0], FrameCount);
+
+	ASSERT_TRUE( runner.restoreSnapshot(snapshot) );
+	std::unique_ptr<SpcState> restored(new SpcState);
+	runner.saveState(*restored);
+	EXPECT_EQ( memcmp(saved.get(), restored.get(), sizeof(SpcState)), 0 );
+
+	std::vector<s16> output(FrameCount * 2);
+	runner.render(&output[0], FrameCount);
+	EXPECT_TRUE( output == expected );
+
+	snapshot.clear();
+	EXPECT_TRUE( snapshot.isEmpty() );
+	EXPECT_FALSE( runner.restoreSnapshot(snapshot) );
+}
@@ -0,0 +1,392 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// LegacySPC includes
+#include <dsp.h>
+#include <ram.h>
+
+using namespace LegacySPC;
+
+class TestDsp : public ::testing::Test
+{
+public:
+	TestDsp()
+	 : dsp(&ram)
+	{
+		// Sample directory at 0x0200, sample 0 start and loop at 0x0300
+		ram.writeByte(0x0200, 0x00);
+		ram.writeByte(0x0201, 0x03);
+		ram.writeByte(0x0202, 0x00);
+		ram.writeByte(0x0203, 0x03);
+
+		dsp.writeRegister(Dsp::SourceDirectory, 0x02);
+	}
+
+	void writeSample(byte header)
+	{
+		ram.writeByte(0x0300, header);
+		for(int i = 1; i < 9; i++)
+		{
+			ram.writeByte(0x0300 + i, 0x77);
+		}
+	}
+
+	void setupVoice(int voice)
+	{
+		int base = voice << 4;
+		dsp.writeRegister(base + Dsp::VolumeLeft, 0x7F);
+		dsp.writeRegister(base + Dsp::VolumeRight, 0x7F);
+		dsp.writeRegister(base + Dsp::PitchHigh, 0x10);
+		dsp.writeRegister(base + Dsp::SourceNumber, 0);
+		// ADSR, fastest attack, sustain at full level
+		dsp.writeRegister(base + Dsp::Adsr1, 0x8F);
+		dsp.writeRegister(base + Dsp::Adsr2, 0xE0);
+	}
+
+	bool isSilent(int sampleCount)
+	{
+		s16 buffer[2];
+		for(int i = 0; i < sampleCount; i++)
+		{
+			dsp.render(buffer, 1);
+			if( buffer[0] != 0 || buffer[1] != 0 )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	Ram ram;
+	Dsp dsp;
+};
+
+TEST_F(TestDsp, SilentAfterReset)
+{
+	EXPECT_EQ( dsp.activeVoices(), 0 );
+	EXPECT_TRUE( isSilent(64) );
+}
+
+TEST_F(TestDsp, KeyOnActivatesVoice)
+{
+	writeSample(0xC3);
+	setupVoice(2);
+	dsp.writeRegister(Dsp::MainVolumeLeft, 0x7F);
+	dsp.writeRegister(Dsp::MainVolumeRight, 0x7F);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+	dsp.writeRegister(Dsp::KeyOn, 0x04);
+
+	EXPECT_FALSE( isSilent(64) );
+	EXPECT_EQ( dsp.activeVoices(), 0x04 );
+	EXPECT_NE( dsp.readRegister(0x20 + Dsp::EnvelopeX), 0 );
+}
+
+TEST_F(TestDsp, ReleasedVoiceBecomesInactive)
+{
+	writeSample(0xC3);
+	setupVoice(0);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+	dsp.writeRegister(Dsp::KeyOn, 0x01);
+	dsp.render(0, 64);
+	EXPECT_EQ( dsp.activeVoices(), 0x01 );
+
+	dsp.writeRegister(Dsp::KeyOff, 0x01);
+	// Release goes down by 8 each sample from at most 0x7FF
+	dsp.render(0, 0x100);
+	EXPECT_EQ( dsp.activeVoices(), 0 );
+	EXPECT_EQ( dsp.readRegister(Dsp::EnvelopeX), 0 );
+}
+
+TEST_F(TestDsp, EndedSampleBecomesInactive)
+{
+	// End without loop
+	writeSample(0xC1);
+	setupVoice(1);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+	dsp.writeRegister(Dsp::KeyOn, 0x02);
+	dsp.render(0, 64);
+
+	EXPECT_EQ( dsp.activeVoices(), 0 );
+	EXPECT_EQ( dsp.readRegister(Dsp::EndX), 0x02 );
+}
+
+TEST_F(TestDsp, MutedVoiceKeepsRunning)
+{
+	writeSample(0xC3);
+	setupVoice(0);
+	dsp.writeRegister(Dsp::MainVolumeLeft, 0x7F);
+	dsp.writeRegister(Dsp::MainVolumeRight, 0x7F);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+
+	dsp.setMutedVoices(0x01);
+	dsp.writeRegister(Dsp::KeyOn, 0x01);
+
+	EXPECT_TRUE( isSilent(64) );
+	EXPECT_EQ( dsp.activeVoices(), 0x01 );
+	EXPECT_NE( dsp.readRegister(Dsp::EnvelopeX), 0 );
+
+	// The voice is heard again right away once unmuted
+	dsp.setMutedVoices(0);
+	EXPECT_FALSE( isSilent(16) );
+
+	dsp.setMutedVoices(0x01);
+	EXPECT_EQ( dsp.activeVoices(), 0x01 );
+	EXPECT_TRUE( isSilent(64) );
+
+	dsp.writeRegister(Dsp::KeyOff, 0x01);
+	dsp.render(0, 0x100);
+	EXPECT_EQ( dsp.activeVoices(), 0 );
+	EXPECT_EQ( dsp.readRegister(Dsp::EnvelopeX), 0 );
+}
+
+TEST_F(TestDsp, MutedVoiceStillModulatesPitch)
+{
+	// Sample 1 at 0x0400, varying so that the pitch shows in the output
+	ram.writeByte(0x0204, 0x00);
+	ram.writeByte(0x0205, 0x04);
+	ram.writeByte(0x0206, 0x00);
+	ram.writeByte(0x0207, 0x04);
+	for(int block = 0; block < 4; block++)
+	{
+		int address = 0x0400 + block * 9;
+		ram.writeByte(address, block == 3 ? 0xB3 : 0xB0);
+		for(int i = 1; i < 9; i++)
+		{
+			ram.writeByte(address + i, static_cast<byte>((block * 8 + i) * 0x35));
+		}
+	}
+
+	writeSample(0xC3);
+
+	const int sampleCount = 512;
+	s16 reference[sampleCount];
+	s16 soloed[sampleCount];
+
+	for(int pass = 0; pass < 2; pass++)
+	{
+		dsp.reset();
+		dsp.writeRegister(Dsp::SourceDirectory, 0x02);
+		setupVoice(0);
+		setupVoice(1);
+		dsp.writeRegister(0x10 + Dsp::SourceNumber, 1);
+		dsp.writeRegister(Dsp::PitchModulation, 0x02);
+		dsp.writeRegister(Dsp::MainVolumeLeft, 0x7F);
+		dsp.writeRegister(Dsp::MainVolumeRight, 0x7F);
+		dsp.writeRegister(Dsp::Flags, 0x20);
+		dsp.setMutedVoices(pass == 0 ? 0 : 0xFD);
+		dsp.writeRegister(Dsp::KeyOn, 0x03);
+
+		StemBuffers stems;
+		stems.voices[1] = pass == 0 ? reference : soloed;
+		dsp.setStemBuffers(&stems);
+		dsp.render(0, sampleCount);
+		dsp.setStemBuffers(0);
+	}
+
+	bool hasSound = false;
+	for(int i = 0; i < sampleCount; i++)
+	{
+		EXPECT_EQ( soloed[i], reference[i] );
+		hasSound = hasSound || reference[i] != 0;
+	}
+	EXPECT_TRUE( hasSound );
+}
+
+TEST_F(TestDsp, StemsMatchMainOutput)
+{
+	writeSample(0xC3);
+	setupVoice(3);
+	dsp.writeRegister(Dsp::MainVolumeLeft, 0x40);
+	dsp.writeRegister(Dsp::MainVolumeRight, 0x40);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+	dsp.writeRegister(Dsp::KeyOn, 0x08);
+
+	const int sampleCount = 64;
+	s16 voiceBuffers[8][sampleCount];
+	s16 echoLeft[sampleCount];
+	s16 echoRight[sampleCount];
+
+	StemBuffers stems;
+	for(int i = 0; i < 8; i++)
+	{
+		stems.voices[i] = voiceBuffers[i];
+	}
+	stems.echoLeft = echoLeft;
+	stems.echoRight = echoRight;
+	dsp.setStemBuffers(&stems);
+
+	s16 output[sampleCount * 2];
+	dsp.render(output, sampleCount);
+
+	bool hasSound = false;
+	for(int i = 0; i < sampleCount; i++)
+	{
+		for(int voice = 0; voice < 8; voice++)
+		{
+			if( voice != 3 )
+			{
+				EXPECT_EQ( voiceBuffers[voice][i], 0 );
+			}
+		}
+		EXPECT_EQ( echoLeft[i], 0 );
+		EXPECT_EQ( echoRight[i], 0 );
+
+		int expected = (((voiceBuffers[3][i] * 0x7F) >> 7) * 0x40) >> 7;
+		EXPECT_EQ( output[i * 2], expected );
+		EXPECT_EQ( output[i * 2 + 1], expected );
+
+		hasSound = hasSound || voiceBuffers[3][i] != 0;
+	}
+	EXPECT_TRUE( hasSound );
+}
+
+TEST_F(TestDsp, QueuedWritesMatchSampleBySample)
+{
+	struct Write
+	{
+		int sampleTime;
+		byte address;
+		byte value;
+	};
+
+	const Write writes[] =
+	{
+		{ 0, Dsp::MainVolumeLeft, 0x7F },
+		{ 0, Dsp::MainVolumeRight, 0x60 },
+		{ 0, Dsp::Flags, 0x20 },
+		{ 3, Dsp::KeyOn, 0x01 },
+		{ 3, Dsp::KeyOn, 0x02 },
+		{ 40, 0x10 + Dsp::PitchHigh, 0x08 },
+		{ 40, 0x10 + Dsp::VolumeLeft, 0x20 },
+		{ 97, Dsp::KeyOff, 0x01 },
+		{ 150, Dsp::KeyOff, 0x00 },
+		{ 151, Dsp::KeyOn, 0x01 },
+		{ 300, Dsp::EndX, 0x00 },
+		{ 301, 0x00 + Dsp::Gain, 0x9F },
+		{ 301, 0x00 + Dsp::Adsr1, 0x00 }
+	};
+	const int writeCount = sizeof(writes) / sizeof(writes[0]);
+	const int sampleCount = 512;
+
+	writeSample(0xC3);
+	setupVoice(0);
+	setupVoice(1);
+
+	// Reference, one sample at a time with the writes in between
+	Ram referenceRam;
+	referenceRam.loadRam( std::vector<byte>(ram.data(), ram.data() + 0x10000) );
+	Dsp reference(&referenceRam);
+	for(int i = 0; i < Dsp::RegisterCount; i++)
+	{
+		reference.writeRegister(i, dsp.readRegister(i));
+	}
+
+	const int readTime = 120;
+	byte expectedEnvelope = 0;
+
+	s16 expected[sampleCount * 2];
+	int nextWrite = 0;
+	for(int i = 0; i < sampleCount; i++)
+	{
+		while( nextWrite < writeCount && writes[nextWrite].sampleTime == i )
+		{
+			reference.writeRegister(writes[nextWrite].address, writes[nextWrite].value);
+			nextWrite++;
+		}
+
+		if( i == readTime )
+		{
+			expectedEnvelope = reference.readRegister(Dsp::EnvelopeX);
+		}
+
+		reference.render(&expected[i * 2], 1);
+	}
+
+	// One block with the queued writes, reading ENVX in the middle
+	s16 output[sampleCount * 2];
+	dsp.beginBlock(output, sampleCount);
+	for(int i = 0; i < writeCount; i++)
+	{
+		dsp.queueRegisterWrite(writes[i].sampleTime, writes[i].address, writes[i].value);
+	}
+	dsp.renderUntil(readTime);
+	byte envelope = dsp.readRegister(Dsp::EnvelopeX);
+	dsp.endBlock();
+
+	for(int i = 0; i < sampleCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at sample " << i / 2;
+	}
+
+	EXPECT_EQ( envelope, expectedEnvelope );
+	EXPECT_EQ( dsp.readRegister(Dsp::EndX), reference.readRegister(Dsp::EndX) );
+	EXPECT_EQ( dsp.activeVoices(), reference.activeVoices() );
+}
+
+TEST_F(TestDsp, CatchUpOnlyForVolatileRegisters)
+{
+	writeSample(0xC3);
+	setupVoice(0);
+	dsp.writeRegister(Dsp::Flags, 0x20);
+
+	const int sampleCount = 256;
+	const s16 untouched = 0x1234;
+	s16 output[sampleCount * 2];
+	for(int i = 0; i < sampleCount * 2; i++)
+	{
+		output[i] = untouched;
+	}
+
+	dsp.beginBlock(output, sampleCount);
+	dsp.queueRegisterWrite(0, Dsp::KeyOn, 0x01);
+	dsp.queueRegisterWrite(10, Dsp::VolumeLeft, 0x42);
+
+	// Written registers are read back without rendering
+	EXPECT_EQ( dsp.readRegisterAt(100, Dsp::VolumeLeft), 0x42 );
+	EXPECT_EQ( dsp.readRegisterAt(100, 0x80 + Dsp::VolumeLeft), 0x42 );
+	EXPECT_EQ( output[0], untouched );
+
+	// ENVX brings the DSP up to date
+	EXPECT_NE( dsp.readRegisterAt(100, Dsp::EnvelopeX), 0 );
+	EXPECT_NE( output[0], untouched );
+	EXPECT_NE( output[99 * 2], untouched );
+	EXPECT_EQ( output[100 * 2], untouched );
+
+	dsp.endBlock();
+	EXPECT_NE( output[(sampleCount - 1) * 2], untouched );
+}
+
+TEST(TestDspGaussian, HardwareTable)
+{
+	EXPECT_EQ( Dsp::gaussianWeight(0), 0 );
+	EXPECT_EQ( Dsp::gaussianWeight(16), 1 );
+	EXPECT_EQ( Dsp::gaussianWeight(255), 370 );
+	EXPECT_EQ( Dsp::gaussianWeight(256), 374 );
+	EXPECT_EQ( Dsp::gaussianWeight(400), 1040 );
+	EXPECT_EQ( Dsp::gaussianWeight(510), 1305 );
+	EXPECT_EQ( Dsp::gaussianWeight(511), 1305 );
+
+	// The four taps of each position sum to about 2048
+	for(int offset = 0; offset < 256; offset++)
+	{
+		int sum = Dsp::gaussianWeight(255 - offset) + Dsp::gaussianWeight(511 - offset)
+			+ Dsp::gaussianWeight(256 + offset) + Dsp::gaussianWeight(offset);
+		EXPECT_GE( sum, 2047 );
+		EXPECT_LE( sum, 2049 );
+	}
+}
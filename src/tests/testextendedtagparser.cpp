@@ -0,0 +1,172 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// LegacySPC includes
+#include <extendedtagparser.h>
+#include <spcfile.h>
+#include <spcfileloader.h>
+
+using namespace LegacySPC;
+
+// Remove a file when leaving the scope, even when an assertion fails
+class RemoveOnExit
+{
+public:
+	RemoveOnExit(const char *filename)
+	 : m_filename(filename)
+	{}
+
+	~RemoveOnExit()
+	{
+		std::remove(m_filename);
+	}
+
+private:
+	const char *m_filename;
+};
+
+static void addHeader(std::vector<byte> &chunk, int id, int type, int length)
+{
+	chunk.push_back(id);
+	chunk.push_back(type);
+	chunk.push_back(length & 0xFF);
+	chunk.push_back(length >> 8);
+}
+
+static void addString(std::vector<byte> &chunk, int id, const std::string &text)
+{
+	addHeader(chunk, id, ExtendedTagParser::String, text.size() + 1);
+	chunk.insert(chunk.end(), text.begin(), text.end());
+	chunk.push_back(0);
+	while( chunk.size() % 4 )
+	{
+		chunk.push_back(0);
+	}
+}
+
+static void addInteger(std::vector<byte> &chunk, int id, int value)
+{
+	addHeader(chunk, id, ExtendedTagParser::Integer, 4);
+	for(int i = 0; i < 4; i++)
+	{
+		chunk.push_back( (value >> (i * 8)) & 0xFF );
+	}
+}
+
+static std::vector<byte> makeChunk()
+{
+	std::vector<byte> items;
+	addString(items, ExtendedTagParser::SongTitle, "Stickerbush Symphony, longer than 32 characters");
+	addString(items, ExtendedTagParser::GameTitle, "Donkey Kong Country 2");
+	addInteger(items, ExtendedTagParser::DateDumped, 19951120);
+	addHeader(items, ExtendedTagParser::OstTrack, ExtendedTagParser::Data, 7 << 8);
+	addInteger(items, ExtendedTagParser::IntroLength, 2 * 64000);
+	addInteger(items, ExtendedTagParser::LoopLength, 3 * 64000);
+	addHeader(items, ExtendedTagParser::LoopCount, ExtendedTagParser::Data, 2);
+	addInteger(items, ExtendedTagParser::FadeLength, 32000);
+	addHeader(items, ExtendedTagParser::MutedVoices, ExtendedTagParser::Data, 0x81);
+	// Unknown item
+	addString(items, 0x99, "skipped");
+
+	std::vector<byte> chunk;
+	chunk.push_back('x');
+	chunk.push_back('i');
+	chunk.push_back('d');
+	chunk.push_back('6');
+	for(int i = 0; i < 4; i++)
+	{
+		chunk.push_back( (items.size() >> (i * 8)) & 0xFF );
+	}
+	chunk.insert(chunk.end(), items.begin(), items.end());
+
+	return chunk;
+}
+
+TEST(TestExtendedTagParser, ParseItems)
+{
+	std::vector<byte> chunk = makeChunk();
+
+	ExtendedID666Tag tag;
+	ASSERT_TRUE( ExtendedTagParser::parse(&chunk[0], chunk.size(), tag) );
+
+	EXPECT_TRUE( tag.isPresent );
+	EXPECT_EQ( tag.songTitle, "Stickerbush Symphony, longer than 32 characters" );
+	EXPECT_EQ( tag.gameTitle, "Donkey Kong Country 2" );
+	EXPECT_EQ( tag.dateDumped, 19951120 );
+	EXPECT_EQ( tag.ostTrack >> 8, 7 );
+	EXPECT_EQ( tag.introLength, 2 * 64000 );
+	EXPECT_EQ( tag.loopLength, 3 * 64000 );
+	EXPECT_EQ( tag.loopCount, 2 );
+	EXPECT_EQ( tag.fadeLength, 32000 );
+	EXPECT_EQ( tag.mutedVoices, 0x81 );
+	EXPECT_EQ( tag.playLength(), 8 * 64000 );
+}
+
+TEST(TestExtendedTagParser, TruncatedChunk)
+{
+	std::vector<byte> chunk = makeChunk();
+
+	// Cut in the middle of the game title
+	ExtendedTagParser parser(&chunk[0], 8 + 52 + 4 + 10);
+	ASSERT_TRUE( parser.isValid() );
+
+	ExtendedTagParser::Item item;
+	ASSERT_TRUE( parser.readItem(item) );
+	EXPECT_EQ( item.id, ExtendedTagParser::SongTitle );
+	EXPECT_EQ( item.type, ExtendedTagParser::String );
+	EXPECT_FALSE( parser.readItem(item) );
+	EXPECT_FALSE( parser.readItem(item) );
+
+	const byte notATag[8] = { 'x', 'i', 'd', '5', 0, 0, 0, 0 };
+	ExtendedID666Tag tag;
+	EXPECT_FALSE( ExtendedTagParser::parse(notATag, sizeof(notATag), tag) );
+	EXPECT_FALSE( tag.isPresent );
+}
+
+TEST(TestExtendedTagParser, LoadFromFile)
+{
+	const char *filename = LEGACYSPC_TESTOUTPUT"testextendedtagparser.spc";
+	RemoveOnExit removeOnExit(filename);
+
+	std::ifstream input(LEGACYSPC_TESTDATA"dkc2_roller_coaster.spc", std::ios::in | std::ios::binary);
+	std::vector<char> data( (std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>() );
+	std::vector<byte> chunk = makeChunk();
+	data.insert(data.end(), chunk.begin(), chunk.end());
+	std::ofstream(filename, std::ios::out | std::ios::binary).write(&data[0], data.size());
+
+	SpcFile file = SpcFileLoader(filename).spcFile();
+	EXPECT_TRUE( file.extendedTag().isPresent );
+	EXPECT_EQ( file.extendedTag().loopLength, 3 * 64000 );
+
+	SpcFile tagFile = SpcFileLoader(filename, SpcFileLoader::TagOnly).spcFile();
+	EXPECT_EQ( tagFile.extendedTag().gameTitle, "Donkey Kong Country 2" );
+
+	ID666Tag tag;
+	ExtendedID666Tag extendedTag;
+	EXPECT_TRUE( SpcFileLoader::readTag(filename, tag, &extendedTag) );
+	EXPECT_EQ( extendedTag.mutedVoices, 0x81 );
+
+	// Files without a xid6 chunk
+	EXPECT_TRUE( SpcFileLoader::readTag(LEGACYSPC_TESTDATA"mmx1_prologue.spc", tag, &extendedTag) );
+	EXPECT_FALSE( extendedTag.isPresent );
+}
@@ -0,0 +1,157 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstring>
+#include <vector>
+
+// LegacySPC includes
+#include <dsp.h>
+#include <loopdetector.h>
+#include <ram.h>
+#include <spcrunner.h>
+#include <spcstate.h>
+
+using namespace LegacySPC;
+
+TEST(TestLoopDetector, DirtyPagesAreHashedAgain)
+{
+	Ram ram;
+	LoopDetector detector;
+	detector.reset(&ram);
+
+	const byte registers[2] = { 1, 2 };
+	EXPECT_FALSE( detector.addState(0, registers, sizeof(registers)) );
+
+	ram.writeByte(0x1234, 0x56);
+	EXPECT_FALSE( detector.addState(10, registers, sizeof(registers)) );
+
+	// Same RAM, other registers
+	const byte otherRegisters[2] = { 1, 3 };
+	EXPECT_FALSE( detector.addState(20, otherRegisters, sizeof(otherRegisters)) );
+	EXPECT_EQ( detector.stateCount(), 3u );
+
+	// Back to the first state
+	ram.writeByte(0x1234, 0x00);
+	EXPECT_TRUE( detector.addState(35, registers, sizeof(registers)) );
+	EXPECT_EQ( detector.loopStart(), 0 );
+	EXPECT_EQ( detector.loopLength(), 35 );
+}
+
+TEST(TestLoopDetector, ManyStates)
+{
+	Ram ram;
+	LoopDetector detector;
+	detector.reset(&ram);
+
+	// A counter over two pages
+	for(int i = 0; i < 20000; i++)
+	{
+		ram.writeByte(0x0010, i & 0xFF);
+		ram.writeByte(0x0110, i >> 8);
+		ASSERT_FALSE( detector.addState(i, 0, 0) ) << "at state " << i;
+	}
+	EXPECT_EQ( detector.stateCount(), 20000u );
+
+	ram.writeByte(0x0010, 100);
+	ram.writeByte(0x0110, 0);
+	EXPECT_TRUE( detector.addState(20000, 0, 0) );
+	EXPECT_EQ( detector.loopStart(), 100 );
+}
+
+TEST(TestLoopDetector, FindSongLoop)
+{
+	// A driver counting its ticks from 0 to 3 in $10
+	const byte program[] =
+	{
+		0xE8, 0x10,       // MOV A,#$10
+		0xC4, 0xFA,       // MOV $FA,A ; tick every 16 timer 0 periods
+		0xE8, 0x01,       // MOV A,#$01
+		0xC4, 0xF1,       // MOV $F1,A ; start timer 0
+		0xE4, 0xFD,       // MOV A,$FD
+		0xF0, 0xFC,       // BEQ -4
+		0xAB, 0x10,       // INC $10
+		0xE4, 0x10,       // MOV A,$10
+		0x28, 0x03,       // AND A,#$03
+		0xC4, 0x10,       // MOV $10,A
+		0x2F, 0xF2        // BRA -14
+	};
+
+	SpcState *state = new SpcState();
+	memcpy(state->ram + 0x0200, program, sizeof(program));
+	state->processor.programCounter = 0x0200;
+	state->processor.stackPointer = 0xEF;
+	// No echo writes
+	state->dsp.registers[Dsp::Flags] = 0x20;
+	state->dsp.writtenRegisters[Dsp::Flags] = 0x20;
+
+	SpcRunner runner;
+	runner.restoreState(*state);
+	delete state;
+
+	int introLength = -1;
+	int loopLength = -1;
+	ASSERT_TRUE( runner.findLoop(10, introLength, loopLength) );
+
+	// 4 ticks of 16 * 128 cycles are 8 ms, the polling
+	// loop can take a few rounds to fall in step
+	EXPECT_GE( introLength, 0 );
+	EXPECT_LT( introLength, 100 );
+	EXPECT_GT( loopLength, 0 );
+	EXPECT_EQ( loopLength % 8, 0 );
+
+	// The search leaves the song where it was
+	EXPECT_EQ( runner.position(), 0 );
+}
+
+TEST(TestLoopDetector, NoLoopWithoutTicks)
+{
+	SpcRunner runner;
+	int introLength = -1;
+	int loopLength = -1;
+	EXPECT_FALSE( runner.findLoop(1, introLength, loopLength) );
+	EXPECT_EQ( introLength, -1 );
+	EXPECT_EQ( loopLength, -1 );
+}
+
+TEST(TestLoopDetector, SearchKeepsTheOutput)
+{
+	const int Frames = 44100;
+
+	SpcRunner searched;
+	SpcRunner uninterrupted;
+	ASSERT_TRUE( searched.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( uninterrupted.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	searched.setOutputSampleRate(44100);
+	uninterrupted.setOutputSampleRate(44100);
+
+	// Leaves input pending in the resampler
+	searched.render(static_cast<s16*>(0), Frames + 17);
+	uninterrupted.render(static_cast<s16*>(0), Frames + 17);
+
+	int introLength;
+	int loopLength;
+	searched.findLoop(2, introLength, loopLength);
+	EXPECT_EQ( searched.position(), uninterrupted.position() );
+
+	std::vector<s16> expected(Frames * 2);
+	std::vector<s16> output(Frames * 2);
+	uninterrupted.render(&expected[0], Frames);
+	searched.render(&output[0], Frames);
+	EXPECT_NE( expected, std::vector<s16>(Frames * 2) );
+	EXPECT_EQ( output, expected );
+}
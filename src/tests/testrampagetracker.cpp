@@ -0,0 +1,111 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// LegacySPC includes
+#include <dsp.h>
+#include <loopdetector.h>
+#include <ram.h>
+#include <rampagetracker.h>
+
+using namespace LegacySPC;
+
+static int dirtyPageCount(RamPageTracker &tracker)
+{
+	int count = 0;
+	for(int page = 0; page < Ram::PageCount; page++)
+	{
+		if( tracker.isPageDirty(page) )
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+TEST(TestRamPageTracker, StartsWithAllPages)
+{
+	Ram ram;
+	RamPageTracker tracker(&ram);
+	EXPECT_EQ( dirtyPageCount(tracker), (int)Ram::PageCount );
+
+	tracker.clearDirtyPages();
+	EXPECT_EQ( dirtyPageCount(tracker), 0 );
+
+	ram.writeByte(0x12FF, 1);
+	ram.writeByte(0x1300, 1);
+	ram.writeByte(0xFFFF, 1);
+	EXPECT_EQ( dirtyPageCount(tracker), 3 );
+	EXPECT_TRUE( tracker.isPageDirty(0x12) );
+	EXPECT_TRUE( tracker.isPageDirty(0x13) );
+	EXPECT_TRUE( tracker.isPageDirty(0xFF) );
+
+	tracker.markAllDirty();
+	EXPECT_EQ( dirtyPageCount(tracker), (int)Ram::PageCount );
+}
+
+TEST(TestRamPageTracker, ConsumersAreIndependent)
+{
+	Ram ram;
+	RamPageTracker first(&ram);
+	RamPageTracker second(&ram);
+	first.clearDirtyPages();
+	second.clearDirtyPages();
+
+	ram.writeByte(0x0400, 1);
+	first.clearDirtyPages();
+	EXPECT_EQ( dirtyPageCount(first), 0 );
+	EXPECT_TRUE( second.isPageDirty(0x04) );
+
+	// Clearing the Ram directly doesn't hide the pages either
+	ram.writeByte(0x0500, 1);
+	ram.clearDirtyPages();
+	EXPECT_TRUE( first.isPageDirty(0x05) );
+	EXPECT_TRUE( second.isPageDirty(0x05) );
+
+	// Nor does a loop detector on the same RAM
+	LoopDetector detector;
+	detector.reset(&ram);
+	ram.writeByte(0x0600, 1);
+	detector.addState(0, 0, 0);
+	EXPECT_TRUE( first.isPageDirty(0x06) );
+
+	ram.loadRam(std::vector<byte>(Ram::Size, 0));
+	EXPECT_EQ( dirtyPageCount(second), (int)Ram::PageCount );
+}
+
+TEST(TestRamPageTracker, EchoWritesAreExternal)
+{
+	Ram ram;
+	Dsp dsp(&ram);
+	RamPageTracker all(&ram);
+	RamPageTracker cpuOnly(&ram, false);
+	all.clearDirtyPages();
+	cpuOnly.clearDirtyPages();
+
+	// Echo writes enabled, 2 KiB buffer at 0x4000
+	dsp.writeRegister(Dsp::EchoStart, 0x40);
+	dsp.writeRegister(Dsp::EchoDelay, 1);
+	dsp.writeRegister(Dsp::Flags, 0x00);
+
+	s16 buffer[2 * 64];
+	dsp.render(buffer, 64);
+
+	EXPECT_TRUE( all.isPageDirty(0x40) );
+	EXPECT_FALSE( all.isPageDirty(0x48) );
+	EXPECT_EQ( dirtyPageCount(cpuOnly), 0 );
+}
@@ -0,0 +1,209 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// LegacySPC includes
+#include <resampler.h>
+
+using namespace LegacySPC;
+
+static const double Pi = 3.14159265358979323846;
+
+// Resample a 1 kHz sine in small uneven chunks and return the largest
+// difference from the ideal sine at the output rate.
+static int sineError(int outputRate, Resampler::Quality quality)
+{
+	const int frameCount = 8000;
+	const double amplitude = 16000.0;
+
+	Resampler resampler;
+	resampler.setRates(32000, outputRate, quality);
+
+	std::vector<s16> output(frameCount * 2);
+	std::vector<s16> input(resampler.maxInputFrames() * 2);
+	int inputTime = 0;
+	int done = 0;
+	int chunk = 1;
+	while( done < frameCount )
+	{
+		int frames = chunk < frameCount - done ? chunk : frameCount - done;
+		int needed = resampler.inputFramesNeeded(frames);
+		for(int i = 0; i < needed; i++, inputTime++)
+		{
+			s16 value = static_cast<s16>( amplitude * std::sin(2.0 * Pi * 1000.0 * inputTime / 32000.0) );
+			input[i * 2] = value;
+			input[i * 2 + 1] = -value;
+		}
+		resampler.pushInput(&input[0], needed);
+		resampler.readOutput(&output[done * 2], frames);
+
+		done += frames;
+		chunk = chunk * 3 % 1021 + 1;
+	}
+
+	// Skip the start where the history is silence
+	int error = 0;
+	for(int i = 64; i < frameCount; i++)
+	{
+		int expected = static_cast<int>( amplitude * std::sin(2.0 * Pi * 1000.0 * i / outputRate) );
+		int difference = std::abs(output[i * 2] - expected);
+		if( difference > error )
+		{
+			error = difference;
+		}
+		EXPECT_EQ( output[i * 2], -output[i * 2 + 1] );
+	}
+
+	return error;
+}
+
+TEST(TestResampler, PassthroughKeepsSamples)
+{
+	Resampler resampler;
+	EXPECT_TRUE( resampler.isPassthrough() );
+
+	s16 input[64 * 2];
+	for(int i = 0; i < 64 * 2; i++)
+	{
+		input[i] = static_cast<s16>(i * 311 - 20000);
+	}
+
+	// The first output frame is the first input frame
+	int needed = resampler.inputFramesNeeded(32);
+	resampler.pushInput(input, needed);
+	s16 output[32 * 2];
+	resampler.readOutput(output, 32);
+
+	for(int i = 0; i < 32 * 2; i++)
+	{
+		EXPECT_NEAR( output[i], input[i], 1 );
+	}
+}
+
+TEST(TestResampler, SineAtCommonRates)
+{
+	EXPECT_LT( sineError(44100, Resampler::HighQuality), 160 );
+	EXPECT_LT( sineError(48000, Resampler::HighQuality), 160 );
+	EXPECT_LT( sineError(96000, Resampler::MediumQuality), 320 );
+	EXPECT_LT( sineError(22050, Resampler::MediumQuality), 320 );
+	EXPECT_LT( sineError(44100, Resampler::LowQuality), 800 );
+}
+
+TEST(TestResampler, InputNeededMatchesRate)
+{
+	Resampler resampler;
+	resampler.setRates(32000, 48000);
+
+	// After the start, three output frames use two input frames
+	s16 input[4096 * 2] = { 0 };
+	int total = 0;
+	for(int i = 0; i < 100; i++)
+	{
+		int needed = resampler.inputFramesNeeded(300);
+		ASSERT_LE( needed, resampler.maxInputFrames() );
+		resampler.pushInput(input, needed);
+		resampler.readOutput(static_cast<s16*>(0), 300);
+		total += needed;
+	}
+
+	EXPECT_NEAR( total, 20000, 16 );
+}
+
+TEST(TestResampler, LowRatesStayWithinMaxInput)
+{
+	// The decimation is larger than the taps at these rates
+	const int Rates[] = { 1000, 2000, 3000 };
+	for(int rate = 0; rate < 3; rate++)
+	{
+		for(int quality = Resampler::LowQuality; quality <= Resampler::HighQuality; quality++)
+		{
+			Resampler resampler;
+			resampler.setRates(32000, Rates[rate], static_cast<Resampler::Quality>(quality));
+
+			std::vector<s16> input(resampler.maxInputFrames() * 2);
+			int frames = Resampler::MaxOutputFrames;
+			for(int i = 0; i < 8; i++)
+			{
+				int needed = resampler.inputFramesNeeded(frames);
+				ASSERT_LE( needed, resampler.maxInputFrames() );
+				resampler.pushInput(&input[0], needed);
+				// Everything pushed was kept
+				ASSERT_EQ( resampler.inputFramesNeeded(frames), 0 );
+				resampler.readOutput(static_cast<s16*>(0), frames);
+
+				frames = i % 2 ? Resampler::MaxOutputFrames : 1;
+			}
+		}
+	}
+}
+
+TEST(TestResampler, KernelsGiveTheSameOutput)
+{
+	const Resampler::Kernel Kernels[3] = { Resampler::ScalarKernel, Resampler::Sse2Kernel, Resampler::Avx2Kernel };
+	// The last ratio needs the nearest of the phases
+	const int Rates[3] = { 44100, 22050, 44123 };
+	const int frameCount = 4096;
+
+	Resampler automatic;
+	EXPECT_EQ( automatic.kernel(), Resampler::AutomaticKernel );
+	EXPECT_TRUE( automatic.setKernel(Resampler::ScalarKernel) );
+	EXPECT_EQ( automatic.kernel(), Resampler::ScalarKernel );
+
+	for(int rate = 0; rate < 3; rate++)
+	{
+		for(int quality = Resampler::LowQuality; quality <= Resampler::HighQuality; quality++)
+		{
+			std::vector<float> expected;
+			for(int kernel = 0; kernel < 3; kernel++)
+			{
+				Resampler resampler;
+				if( !resampler.setKernel(Kernels[kernel]) )
+				{
+					continue;
+				}
+				resampler.setRates(32000, Rates[rate], static_cast<Resampler::Quality>(quality));
+
+				// Noise, where the order of the sums matters most
+				std::srand(1234);
+				std::vector<s16> input(resampler.inputFramesNeeded(frameCount) * 2);
+				for(size_t i = 0; i < input.size(); i++)
+				{
+					input[i] = static_cast<s16>( std::rand() % 65536 - 32768 );
+				}
+				resampler.pushInput(&input[0], static_cast<int>(input.size() / 2));
+
+				std::vector<float> output(frameCount * 2);
+				resampler.readOutput(&output[0], frameCount);
+
+				if( expected.empty() )
+				{
+					expected = output;
+				}
+				for(int i = 0; i < frameCount * 2; i++)
+				{
+					ASSERT_EQ( memcmp(&output[i], &expected[i], sizeof(float)), 0 )
+						<< "kernel " << kernel << " rate " << Rates[rate] << " at sample " << i;
+				}
+			}
+		}
+	}
+}
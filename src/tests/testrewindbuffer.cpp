@@ -0,0 +1,154 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// LegacySPC includes
+#include <ram.h>
+#include <rewindbuffer.h>
+#include <spcrunner.h>
+#include <spcstate.h>
+
+using namespace LegacySPC;
+
+static const int StepFrames = 1600;
+
+static std::vector<SpcState> recordSong(int count, RewindBuffer &buffer)
+{
+	SpcRunner runner;
+	runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+
+	uint32 allPages[Ram::PageCount / 32];
+	memset(allPages, 0xFF, sizeof(allPages));
+
+	std::vector<SpcState> states(count);
+	for(int i = 0; i < count; i++)
+	{
+		runner.render(static_cast<s16*>(0), StepFrames);
+		runner.saveState(states[i]);
+		buffer.record(states[i], allPages);
+	}
+
+	return states;
+}
+
+TEST(TestRewindBuffer, RestoreEveryPoint)
+{
+	RewindBuffer buffer(RewindBuffer::DefaultByteBudget, 8);
+	std::vector<SpcState> states = recordSong(40, buffer);
+	ASSERT_EQ( buffer.count(), 40 );
+	// Far less than the states themselves, the new echo samples
+	// take most of it
+	EXPECT_LT( buffer.memoryUsed(), sizeof(SpcState) * 40 / 4 );
+
+	std::unique_ptr<SpcState> state(new SpcState);
+	for(int i = 0; i < buffer.count(); i++)
+	{
+		EXPECT_EQ( buffer.position(i), states[i].position );
+		ASSERT_TRUE( buffer.restore(i, *state) );
+		EXPECT_EQ( memcmp(state.get(), &states[i], sizeof(SpcState)), 0 ) << "at point " << i;
+	}
+	EXPECT_FALSE( buffer.restore(40, *state) );
+	EXPECT_EQ( buffer.position(-1), -1 );
+
+	// Recording goes on from the point rewound to
+	ASSERT_TRUE( buffer.rewind(13, *state) );
+	EXPECT_EQ( buffer.count(), 14 );
+	uint32 allPages[Ram::PageCount / 32];
+	memset(allPages, 0xFF, sizeof(allPages));
+	buffer.record(states[30], allPages);
+	ASSERT_TRUE( buffer.restore(14, *state) );
+	EXPECT_EQ( memcmp(state.get(), &states[30], sizeof(SpcState)), 0 );
+	ASSERT_TRUE( buffer.restore(5, *state) );
+	EXPECT_EQ( memcmp(state.get(), &states[5], sizeof(SpcState)), 0 );
+}
+
+TEST(TestRewindBuffer, StayWithinBudget)
+{
+	const size_t budget = 16 * 1024;
+	RewindBuffer buffer(budget);
+	std::vector<SpcState> states = recordSong(100, buffer);
+
+	EXPECT_LE( buffer.memoryUsed(), budget );
+	ASSERT_GT( buffer.count(), 1 );
+	ASSERT_LT( buffer.count(), 100 );
+
+	// The newest points are kept
+	int first = 100 - buffer.count();
+	std::unique_ptr<SpcState> state(new SpcState);
+	for(int i = 0; i < buffer.count(); i++)
+	{
+		ASSERT_TRUE( buffer.restore(i, *state) );
+		EXPECT_EQ( memcmp(state.get(), &states[first + i], sizeof(SpcState)), 0 ) << "at point " << i;
+	}
+
+	buffer.setByteBudget(0);
+	EXPECT_EQ( buffer.count(), 1 );
+}
+
+TEST(TestRewindBuffer, StepBackInRunner)
+{
+	const int BlockSize = 640;
+
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	runner.setBlockSize(BlockSize);
+	runner.setRewind(100);
+	runner.render(static_cast<s16*>(0), 32000);
+
+	// The first point at the end of the first block, then one at the
+	// end of the first block past each 100 ms
+	ASSERT_EQ( runner.rewindPointCount(), 10 );
+	EXPECT_EQ( runner.rewindPointPosition(0), BlockSize * 1000 / 32000 );
+	for(int i = 1; i < runner.rewindPointCount(); i++)
+	{
+		int interval = runner.rewindPointPosition(i) - runner.rewindPointPosition(i - 1);
+		EXPECT_GE( interval, 100 );
+		EXPECT_LT( interval, 100 + BlockSize * 1000 / 32000 );
+	}
+
+	int last = runner.rewindPointPosition(9);
+	int previous = runner.rewindPointPosition(8);
+	ASSERT_TRUE( runner.stepBack() );
+	EXPECT_EQ( runner.position(), last );
+	ASSERT_TRUE( runner.stepBack() );
+	EXPECT_EQ( runner.position(), previous );
+	EXPECT_EQ( runner.rewindPointCount(), 9 );
+
+	// Same as playing up to there
+	SpcRunner other;
+	ASSERT_TRUE( other.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	other.setBlockSize(BlockSize);
+	other.render(static_cast<s16*>(0), previous * 32);
+
+	std::vector<s16> expected(StepFrames * 2);
+	std::vector<s16> output(StepFrames * 2);
+	other.render(&expected[0], StepFrames);
+	runner.render(&output[0], StepFrames);
+	EXPECT_EQ( output, expected );
+
+	ASSERT_TRUE( runner.rewind(0) );
+	EXPECT_EQ( runner.position(), BlockSize * 1000 / 32000 );
+	EXPECT_FALSE( runner.rewind(5) );
+
+	runner.setRewind(0);
+	EXPECT_EQ( runner.rewindPointCount(), 0 );
+	EXPECT_FALSE( runner.stepBack() );
+}
@@ -0,0 +1,184 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// LegacySPC includes
+#include <ringbuffer.h>
+#include <spcrunner.h>
+
+using namespace LegacySPC;
+
+TEST(TestRingBuffer, WrapAround)
+{
+	RingBuffer ring(6);
+	EXPECT_EQ( ring.capacity(), 8u );
+
+	s16 frames[8 * 2];
+	s16 output[8 * 2];
+	s16 next = 0;
+	s16 expected = 0;
+	for(int round = 0; round < 10; round++)
+	{
+		for(int i = 0; i < 5 * 2; i++)
+		{
+			frames[i] = next++;
+		}
+		EXPECT_EQ( ring.write(frames, 5), 5u );
+		EXPECT_EQ( ring.readAvailable(), 5u );
+
+		EXPECT_EQ( ring.read(output, 5), 5u );
+		for(int i = 0; i < 5 * 2; i++)
+		{
+			EXPECT_EQ( output[i], expected++ );
+		}
+	}
+
+	EXPECT_EQ( ring.underruns(), 0u );
+	EXPECT_EQ( ring.overruns(), 0u );
+}
+
+TEST(TestRingBuffer, Counters)
+{
+	RingBuffer ring(4);
+	s16 frames[8 * 2] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+	EXPECT_EQ( ring.write(frames, 6), 4u );
+	EXPECT_EQ( ring.overruns(), 1u );
+	EXPECT_EQ( ring.writeAvailable(), 0u );
+
+	s16 output[8 * 2];
+	EXPECT_EQ( ring.read(output, 8), 4u );
+	EXPECT_EQ( ring.underruns(), 1u );
+	EXPECT_EQ( output[7], 1 );
+	EXPECT_EQ( output[8], 0 );
+	EXPECT_EQ( output[15], 0 );
+}
+
+TEST(TestRingBuffer, ProducerConsumerThreads)
+{
+	const int total = 50000;
+	RingBuffer ring(256);
+
+	std::thread producer([&ring]()
+	{
+		int next = 0;
+		while( next < total )
+		{
+			size_t frames;
+			s16 *region = ring.writeRegion(frames);
+			size_t count = 0;
+			for(; count < frames && next < total; count++, next++)
+			{
+				region[count * 2] = static_cast<s16>(next);
+				region[count * 2 + 1] = static_cast<s16>(~next);
+			}
+			ring.commitWrite(count);
+			std::this_thread::yield();
+		}
+	});
+
+	s16 output[97 * 2];
+	int expected = 0;
+	while( expected < total )
+	{
+		size_t available = ring.readAvailable();
+		size_t frames = available < 97 ? available : 97;
+		ring.read(output, frames);
+		for(size_t i = 0; i < frames; i++, expected++)
+		{
+			ASSERT_EQ( output[i * 2], static_cast<s16>(expected) );
+			ASSERT_EQ( output[i * 2 + 1], static_cast<s16>(~expected) );
+		}
+		std::this_thread::yield();
+	}
+
+	producer.join();
+	EXPECT_EQ( ring.underruns(), 0u );
+}
+
+TEST(TestRingBuffer, RenderAheadMatchesRender)
+{
+	const size_t frameCount = 16000;
+
+	SpcRunner direct;
+	SpcRunner worker;
+	ASSERT_TRUE( direct.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( worker.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	std::vector<s16> expected(frameCount * 2);
+	direct.render(&expected[0], frameCount);
+
+	ASSERT_TRUE( worker.startRenderAhead(2048) );
+	EXPECT_TRUE( worker.isRenderingAhead() );
+	EXPECT_FALSE( worker.startRenderAhead(2048) );
+
+	std::vector<s16> output(frameCount * 2);
+	size_t done = 0;
+	while( done < frameCount )
+	{
+		size_t frames = worker.renderedAheadAvailable();
+		if( frames > frameCount - done )
+		{
+			frames = frameCount - done;
+		}
+		done += worker.readRenderedAhead(&output[done * 2], frames);
+		std::this_thread::yield();
+	}
+	worker.stopRenderAhead();
+	EXPECT_FALSE( worker.isRenderingAhead() );
+
+	for(size_t i = 0; i < frameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2;
+	}
+	EXPECT_EQ( worker.renderAheadUnderruns(), 0u );
+}
+
+TEST(TestRingBuffer, RenderAheadCountsOverruns)
+{
+	const size_t latency = 256;
+
+	SpcRunner worker;
+	ASSERT_TRUE( worker.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( worker.startRenderAhead(latency) );
+
+	while( worker.renderedAheadAvailable() < latency )
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ( worker.renderAheadOverruns(), 0u );
+
+	// Taking every frame as soon as it is ready leaves the
+	// worker an empty ring to come back to
+	std::vector<s16> output(latency * 2);
+	std::chrono::steady_clock::time_point limit = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while( worker.renderAheadOverruns() == 0 && std::chrono::steady_clock::now() < limit )
+	{
+		worker.readRenderedAhead(&output[0], worker.renderedAheadAvailable());
+	}
+	worker.stopRenderAhead();
+	EXPECT_GT( worker.renderAheadOverruns(), 0u );
+
+	// Counted again from 0
+	ASSERT_TRUE( worker.startRenderAhead(latency) );
+	EXPECT_EQ( worker.renderAheadOverruns(), 0u );
+	worker.stopRenderAhead();
+}
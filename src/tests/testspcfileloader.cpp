@@ -16,9 +16,14 @@
 #include <gtest/gtest.h>
 
 // STL includes
+#include <cstring>
 #include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
 
 // LegacySPC includes
+#include "mappedspcfile.h"
 #include "spcfileloader.h"
 #include "spcfile.h"
 #include "processor.h"
@@ -136,3 +141,138 @@ TEST(TestSpcFileLoader, TestMagicHeader)
 	EXPECT_EQ( !testFstream, false );
 	EXPECT_EQ( !magicHeaderLoader, true );
 }
+
+TEST(TestSpcFileLoader, TestMappedFile)
+{
+	MappedSpcFile mappedFile(LEGACYSPC_TESTDATA"rs3_binarytag.spc");
+	ASSERT_TRUE( mappedFile.isOpen() );
+	EXPECT_EQ( mappedFile.size(), 0x10200u );
+
+	SpcFile file = SpcFileLoader(LEGACYSPC_TESTDATA"rs3_binarytag.spc").spcFile();
+
+	EXPECT_EQ( (int)mappedFile.processorRegisters().programCounter(), 0x02F4 );
+	EXPECT_EQ( (int)mappedFile.processorRegisters().A(), 0x1E );
+	ASSERT_EQ( file.ramData().size(), (size_t)MappedSpcFile::RamSize );
+	EXPECT_EQ( memcmp(&file.ramData()[0], mappedFile.ramData(), MappedSpcFile::RamSize), 0 );
+	EXPECT_EQ( memcmp(&file.dspRegisters()[0], mappedFile.dspRegisters(), MappedSpcFile::DspRegistersSize), 0 );
+	EXPECT_TRUE( mappedFile.extraRam() != 0 );
+
+	EXPECT_STREQ( mappedFile.id666Tag().songTitle.c_str(), "Battle Theme" );
+	EXPECT_EQ( mappedFile.id666Tag().songLength, 200 );
+
+	mappedFile.close();
+	EXPECT_FALSE( mappedFile.isOpen() );
+
+	EXPECT_FALSE( mappedFile.open(LEGACYSPC_TESTDATA"notaspcfile") );
+	EXPECT_FALSE( mappedFile.open("roeotetewer") );
+}
+
+TEST(TestSpcFileLoader, TestTagOnly)
+{
+	SpcFileLoader tagLoader(LEGACYSPC_TESTDATA"mmx1_prologue.spc", SpcFileLoader::TagOnly);
+	EXPECT_EQ( !tagLoader, false );
+
+	SpcFile mmxFile = tagLoader.spcFile();
+	EXPECT_EQ( (int)mmxFile.processorRegisters().programCounter(), 0x03C2 );
+	EXPECT_STREQ( mmxFile.id666Tag().songTitle.c_str(), "Prologue stage" );
+	EXPECT_EQ( mmxFile.id666Tag().fadeoutLength, 5714 );
+	// The RAM is not read
+	EXPECT_TRUE( mmxFile.ramData().empty() );
+
+	ID666Tag tag;
+	EXPECT_TRUE( SpcFileLoader::readTag(LEGACYSPC_TESTDATA"rs3_binarytag.spc", tag) );
+	EXPECT_STREQ( tag.artistName.c_str(), "Kenji Ito" );
+	EXPECT_EQ( tag.songLength, 200 );
+
+	EXPECT_FALSE( SpcFileLoader::readTag(LEGACYSPC_TESTDATA"notaspcfile", tag) );
+	EXPECT_FALSE( SpcFileLoader::readTag("roeotetewer", tag) );
+}
+
+TEST(TestSpcFileLoader, TestImplicitSharing)
+{
+	SpcFileLoader loader(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+	SpcFile file = loader.spcFile();
+	const byte *ram = &file.ramData()[0];
+
+	// Copies share the data
+	SpcFile copy = file;
+	SpcFile assigned;
+	assigned = copy;
+	EXPECT_EQ( &copy.ramData()[0], ram );
+	EXPECT_EQ( &assigned.ramData()[0], ram );
+
+	// Only the modified copy detaches
+	ID666Tag tag = copy.id666Tag();
+	tag.songTitle = "Modified";
+	copy.setID666Tag(tag);
+	EXPECT_NE( &copy.ramData()[0], ram );
+	EXPECT_STREQ( copy.id666Tag().songTitle.c_str(), "Modified" );
+	EXPECT_STREQ( file.id666Tag().songTitle.c_str(), "Prologue stage" );
+	EXPECT_EQ( copy.ramData(), file.ramData() );
+
+	// copy is no longer shared, it is modified in place
+	const byte *copyRam = &copy.ramData()[0];
+	copy.setContentHash(1);
+	EXPECT_EQ( &copy.ramData()[0], copyRam );
+
+	// The assigned data outlives the SpcFile it came from
+	{
+		SpcFile source = SpcFileLoader(LEGACYSPC_TESTDATA"rs3_binarytag.spc").spcFile();
+		assigned = source;
+		assigned = assigned;
+	}
+	EXPECT_STREQ( assigned.id666Tag().songTitle.c_str(), "Battle Theme" );
+	EXPECT_EQ( assigned.ramData().size(), (size_t)MappedSpcFile::RamSize );
+}
+
+TEST(TestSpcFileLoader, TestMoveSpcFile)
+{
+	SpcFileLoader loader(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+	const byte *ram = &loader.spcFile().ramData()[0];
+
+	// Moved out of the loader, not shared with it
+	SpcFile file = std::move(loader).spcFile();
+	EXPECT_EQ( &file.ramData()[0], ram );
+	EXPECT_TRUE( loader.spcFile().ramData().empty() );
+
+	SpcFile moved( std::move(file) );
+	EXPECT_EQ( &moved.ramData()[0], ram );
+	EXPECT_TRUE( file.ramData().empty() );
+	EXPECT_STREQ( file.id666Tag().songTitle.c_str(), "" );
+
+	SpcFile assigned;
+	assigned = std::move(moved);
+	EXPECT_EQ( &assigned.ramData()[0], ram );
+	EXPECT_STREQ( assigned.id666Tag().songTitle.c_str(), "Prologue stage" );
+
+	// Moved-from SpcFiles can be used again
+	moved.setRamData( assigned.ramData() );
+	EXPECT_EQ( moved.ramData(), assigned.ramData() );
+	EXPECT_NE( &moved.ramData()[0], ram );
+}
+
+TEST(TestSpcFileLoader, TestShareBetweenThreads)
+{
+	SpcFile file = SpcFileLoader(LEGACYSPC_TESTDATA"mmx1_prologue.spc").spcFile();
+
+	vector<thread> threads;
+	for(int i = 0; i < 4; i++)
+	{
+		threads.push_back( thread([&file]() {
+			for(int j = 0; j < 10000; j++)
+			{
+				SpcFile copy = file;
+				SpcFile other( std::move(copy) );
+			}
+		}) );
+	}
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	// Only file is left, it is modified in place
+	const byte *ram = &file.ramData()[0];
+	file.setContentHash(1);
+	EXPECT_EQ( &file.ramData()[0], ram );
+}
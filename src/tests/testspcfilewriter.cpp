@@ -0,0 +1,206 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// LegacySPC includes
+#include <dsp.h>
+#include <mappedspcfile.h>
+#include <spcfile.h>
+#include <spcfilewriter.h>
+#include <spcrunner.h>
+#include <spcstate.h>
+#include <spcstatefile.h>
+
+using namespace LegacySPC;
+
+static const int FrameCount = 8000;
+
+TEST(TestSpcFileWriter, WriteLoadedFile)
+{
+	const char *filename = "testspcfilewriter.spc";
+
+	MappedSpcFile original(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+	ASSERT_TRUE( original.isOpen() );
+
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(original) );
+
+	SpcFileWriter writer;
+	writer.setID666Tag( original.id666Tag() );
+	ASSERT_TRUE( writer.write(filename, runner) );
+
+	// Nothing ran, the same state is written back
+	MappedSpcFile written(filename);
+	ASSERT_TRUE( written.isOpen() );
+	EXPECT_EQ( written.size(), (size_t)MappedSpcFile::ExtendedTagOffset );
+	EXPECT_EQ( memcmp(written.data() + 0x25, original.data() + 0x25, 7), 0 );
+	EXPECT_EQ( memcmp(written.ramData(), original.ramData(), MappedSpcFile::RamSize), 0 );
+	// KON only takes effect when written, the loaded value is dropped
+	for(int i = 0; i < MappedSpcFile::DspRegistersSize; i++)
+	{
+		if( i != 0x4C )
+		{
+			EXPECT_EQ( written.dspRegisters()[i], original.dspRegisters()[i] );
+		}
+	}
+
+	ID666Tag tag = written.id666Tag();
+	EXPECT_STREQ( tag.songTitle.c_str(), "Prologue stage" );
+	EXPECT_STREQ( tag.gameTitle.c_str(), "MEGAMAN X" );
+	EXPECT_STREQ( tag.dateDumped.c_str(), "20.9.2000" );
+	EXPECT_EQ( tag.songLength, 46 );
+	EXPECT_EQ( tag.fadeoutLength, 5714 );
+	EXPECT_EQ( tag.emulatorIndex, 1 );
+	EXPECT_FALSE( tag.isBinary );
+
+	written.close();
+	std::remove(filename);
+}
+
+TEST(TestSpcFileWriter, WriteRunningState)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"rs3_binarytag.spc") );
+	runner.render(static_cast<s16*>(0), FrameCount);
+
+	std::unique_ptr<SpcState> state(new SpcState);
+	runner.saveState(*state);
+	// Values updated by the DSP since the CPU last wrote them
+	state->dsp.registers[0x10 + Dsp::EnvelopeX] = 0x5A;
+	state->dsp.registers[0x30 + Dsp::OutputX] = 0xC3;
+	state->dsp.registers[Dsp::EndX] = 0x81;
+	state->dsp.writtenRegisters[Dsp::EndX] = 0x00;
+
+	std::vector<byte> data = SpcFileWriter::encode(*state, ID666Tag());
+	ASSERT_EQ( data.size(), (size_t)MappedSpcFile::ExtendedTagOffset );
+	EXPECT_TRUE( MappedSpcFile::checkHeader(&data[0]) );
+	EXPECT_EQ( (int)MappedSpcFile::decodeProcessorRegisters(&data[0]).programCounter(), (int)state->processor.programCounter );
+	EXPECT_EQ( memcmp(&data[MappedSpcFile::RamOffset + 0x100], state->ram + 0x100, 0xFF00), 0 );
+	// ENVX, OUTX and ENDX are updated by the DSP, the others are written by the CPU
+	const byte *dspRegisters = &data[MappedSpcFile::DspRegistersOffset];
+	for(int i = 0; i < 128; i++)
+	{
+		bool updated = (i & 0x0F) == Dsp::EnvelopeX || (i & 0x0F) == Dsp::OutputX || i == Dsp::EndX;
+		EXPECT_EQ( dspRegisters[i], updated ? state->dsp.registers[i] : state->dsp.writtenRegisters[i] ) << "register " << i;
+	}
+	EXPECT_EQ( dspRegisters[0x18], 0x5A );
+	EXPECT_EQ( dspRegisters[0x39], 0xC3 );
+	EXPECT_EQ( dspRegisters[Dsp::EndX], 0x81 );
+	EXPECT_EQ( MappedSpcFile::decodeID666Tag(&data[0]).songLength, 0 );
+
+	// Lengths too long for the text fields are clamped
+	ID666Tag longTag;
+	longTag.songLength = 1200;
+	longTag.fadeoutLength = 123456;
+	data = SpcFileWriter::encode(*state, longTag);
+	ID666Tag writtenTag = MappedSpcFile::decodeID666Tag(&data[0]);
+	EXPECT_EQ( writtenTag.songLength, 999 );
+	EXPECT_EQ( writtenTag.fadeoutLength, 99999 );
+}
+
+TEST(TestSpcStateFile, SaveAndRestore)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	runner.render(static_cast<s16*>(0), FrameCount);
+
+	std::unique_ptr<SpcState> state(new SpcState);
+	runner.saveState(*state);
+
+	std::vector<byte> blob( SpcStateFile::blobSize() );
+	SpcStateFile::save(*state, &blob[0]);
+
+	std::unique_ptr<SpcState> restored(new SpcState);
+	ASSERT_TRUE( SpcStateFile::restore(&blob[0], blob.size(), *restored) );
+
+	SpcRunner other;
+	other.restoreState(*restored);
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	runner.render(&expected[0], FrameCount);
+	other.render(&output[0], FrameCount);
+	EXPECT_EQ( output, expected );
+
+	// Through a file
+	ASSERT_TRUE( SpcStateFile::write("testspcstatefile.state", *state) );
+	std::unique_ptr<SpcState> read(new SpcState);
+	ASSERT_TRUE( SpcStateFile::read("testspcstatefile.state", *read) );
+	EXPECT_EQ( memcmp(read->ram, state->ram, sizeof(state->ram)), 0 );
+	EXPECT_EQ( read->position, state->position );
+	std::remove("testspcstatefile.state");
+
+	// Every byte is written, whatever the memory held before
+	memset(restored.get(), 0xAA, sizeof(SpcState));
+	runner.saveState(*restored);
+	memset(read.get(), 0x55, sizeof(SpcState));
+	runner.saveState(*read);
+	EXPECT_EQ( memcmp(restored.get(), read.get(), sizeof(SpcState)), 0 );
+
+	// Other versions, truncated blobs and other files are refused
+	EXPECT_FALSE( SpcStateFile::restore(&blob[0], blob.size() - 1, *restored) );
+	blob[8]++;
+	EXPECT_FALSE( SpcStateFile::restore(&blob[0], blob.size(), *restored) );
+	EXPECT_FALSE( SpcStateFile::read(LEGACYSPC_TESTDATA"mmx1_prologue.spc", *read) );
+}
+
+TEST(TestSpcStateFile, RejectsPositionsOutOfRange)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	runner.render(static_cast<s16*>(0), FrameCount);
+
+	std::unique_ptr<SpcState> state(new SpcState);
+	std::unique_ptr<SpcState> restored(new SpcState);
+	std::vector<byte> blob( SpcStateFile::blobSize() );
+
+	for(int field = 0; field < 5; field++)
+	{
+		runner.saveState(*state);
+		DspVoiceState &voice = state->dsp.voices[3];
+		switch( field )
+		{
+			case 0:
+				voice.bufferPosition = 12;
+				break;
+			case 1:
+				voice.bufferPosition = 2;
+				break;
+			case 2:
+				voice.interpolationPosition = 0x4000;
+				break;
+			case 3:
+				voice.interpolationPosition = -1;
+				break;
+			case 4:
+				state->dsp.echoHistoryPosition = 8;
+				break;
+		}
+
+		SpcStateFile::save(*state, &blob[0]);
+		EXPECT_FALSE( SpcStateFile::restore(&blob[0], blob.size(), *restored) ) << "field " << field;
+	}
+
+	runner.saveState(*state);
+	SpcStateFile::save(*state, &blob[0]);
+	EXPECT_TRUE( SpcStateFile::restore(&blob[0], blob.size(), *restored) );
+}
@@ -0,0 +1,165 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// LegacySPC includes
+#include <contenthasher.h>
+#include <mappedspcfile.h>
+#include <spcfile.h>
+#include <spcfileloader.h>
+#include <spcindex.h>
+
+using namespace LegacySPC;
+
+TEST(TestContentHasher, PiecesGiveTheSameHash)
+{
+	std::vector<byte> data(1000);
+	for(size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = static_cast<byte>(i * 7 + 3);
+	}
+
+	ContentHasher whole;
+	whole.add(&data[0], data.size());
+
+	ContentHasher pieces;
+	size_t pieceSizes[] = { 1, 3, 5, 8, 13, 100, 870 };
+	size_t offset = 0;
+	for(int i = 0; i < 7; i++)
+	{
+		pieces.add(&data[offset], pieceSizes[i]);
+		offset += pieceSizes[i];
+	}
+	ASSERT_EQ( offset, data.size() );
+	EXPECT_EQ( pieces.result(), whole.result() );
+
+	// One byte more or one byte changed
+	ContentHasher longer = whole;
+	byte zero = 0;
+	longer.add(&zero, 1);
+	EXPECT_NE( longer.result(), whole.result() );
+
+	data[500] ^= 1;
+	ContentHasher changed;
+	changed.add(&data[0], data.size());
+	EXPECT_NE( changed.result(), whole.result() );
+}
+
+TEST(TestSpcIndex, BuildAndSearch)
+{
+	const char *filename = "testspcindex.idx";
+
+	std::vector<std::string> files = SpcIndex::findSpcFiles(LEGACYSPC_TESTDATA);
+	ASSERT_EQ( files.size(), 3u );
+	files.push_back(LEGACYSPC_TESTDATA"notaspcfile");
+	files.push_back(LEGACYSPC_TESTDATA"missing.spc");
+
+	ASSERT_EQ( SpcIndex::build(files, filename, 2), 3 );
+
+	SpcIndex index(filename);
+	ASSERT_TRUE( index.isOpen() );
+	ASSERT_EQ( index.count(), 3 );
+
+	for(int i = 0; i < index.count(); i++)
+	{
+		SpcIndexEntry entry = index.entry(i);
+		if( i > 0 )
+		{
+			EXPECT_LE( index.entry(i - 1).contentHash, entry.contentHash );
+		}
+
+		MappedSpcFile file(entry.path);
+		ASSERT_TRUE( file.isOpen() );
+		EXPECT_EQ( entry.contentHash, file.contentHash() );
+		EXPECT_EQ( index.find(entry.contentHash), i );
+	}
+	EXPECT_EQ( index.find(0), -1 );
+
+	std::vector<int> found = index.search("megaman");
+	ASSERT_EQ( found.size(), 1u );
+	SpcIndexEntry mmx = index.entry(found[0]);
+	EXPECT_STREQ( mmx.songTitle, "Prologue stage" );
+	EXPECT_STREQ( mmx.gameTitle, "MEGAMAN X" );
+	EXPECT_EQ( mmx.songLength, 46000 );
+	EXPECT_EQ( mmx.fadeoutLength, 5714 );
+
+	found = index.search("SAGA");
+	ASSERT_EQ( found.size(), 1u );
+	EXPECT_STREQ( index.entry(found[0]).songTitle, "Battle Theme" );
+
+	EXPECT_TRUE( index.search("not in the index").empty() );
+	EXPECT_EQ( index.search("").size(), 3u );
+
+	index.close();
+	std::remove(filename);
+}
+
+TEST(TestSpcIndex, InvalidIndex)
+{
+	SpcIndex index;
+	EXPECT_FALSE( index.open(LEGACYSPC_TESTDATA"notaspcfile") );
+	EXPECT_FALSE( index.open(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	EXPECT_FALSE( index.isOpen() );
+	EXPECT_EQ( index.count(), 0 );
+}
+
+TEST(TestSpcIndex, SameContentSameHash)
+{
+	const char *copyName = "testspcindex_retagged.spc";
+
+	// Same emulation state, another tag
+	std::ifstream input(LEGACYSPC_TESTDATA"mmx1_prologue.spc", std::ios::in | std::ios::binary);
+	std::vector<char> data( (std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>() );
+	ASSERT_GT( data.size(), 0x100u );
+	data[0x2E] = 'X';
+	std::ofstream(copyName, std::ios::out | std::ios::binary).write(&data[0], data.size());
+
+	SpcFile original = SpcFileLoader(LEGACYSPC_TESTDATA"mmx1_prologue.spc").spcFile();
+	SpcFile retagged = SpcFileLoader(copyName).spcFile();
+	EXPECT_NE( original.contentHash(), 0u );
+	EXPECT_EQ( original.contentHash(), retagged.contentHash() );
+	EXPECT_EQ( original.contentHash(), MappedSpcFile(copyName).contentHash() );
+	EXPECT_STRNE( original.id666Tag().songTitle.c_str(), retagged.id666Tag().songTitle.c_str() );
+
+	SpcFile other = SpcFileLoader(LEGACYSPC_TESTDATA"rs3_binarytag.spc").spcFile();
+	EXPECT_NE( original.contentHash(), other.contentHash() );
+
+	// The RAM is not read
+	EXPECT_EQ( SpcFileLoader(copyName, SpcFileLoader::TagOnly).spcFile().contentHash(), 0u );
+
+	std::vector<std::string> files;
+	files.push_back(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+	files.push_back(copyName);
+	files.push_back(LEGACYSPC_TESTDATA"rs3_binarytag.spc");
+	ASSERT_EQ( SpcIndex::build(files, "testspcindex.idx"), 3 );
+
+	SpcIndex index("testspcindex.idx");
+	int first = index.find( original.contentHash() );
+	ASSERT_GE( first, 0 );
+	ASSERT_LT( first + 1, index.count() );
+	EXPECT_EQ( index.entry(first + 1).contentHash, original.contentHash() );
+
+	index.close();
+	std::remove("testspcindex.idx");
+	std::remove(copyName);
+}
@@ -0,0 +1,74 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <vector>
+
+// LegacySPC includes
+#include <spcfile.h>
+#include <spcprefetcher.h>
+#include <spcrunner.h>
+
+using namespace LegacySPC;
+
+static const int FrameCount = 8000;
+
+TEST(TestSpcPrefetcher, LoadInBackground)
+{
+	SpcRunner direct;
+	ASSERT_TRUE( direct.loadSpcFile(LEGACYSPC_TESTDATA"rs3_binarytag.spc") );
+
+	SpcRunner first;
+	SpcRunner second;
+	SpcLoadHandle missing;
+	{
+		SpcPrefetcher prefetcher(2);
+		SpcLoadHandle firstHandle = prefetcher.load(LEGACYSPC_TESTDATA"mmx1_prologue.spc", &first);
+		SpcLoadHandle secondHandle = prefetcher.load(LEGACYSPC_TESTDATA"rs3_binarytag.spc", &second);
+		missing = prefetcher.load(LEGACYSPC_TESTDATA"notaspcfile", 0);
+
+		EXPECT_NE( firstHandle.status(), SpcLoadHandle::Invalid );
+		EXPECT_TRUE( firstHandle.wait() );
+		EXPECT_TRUE( secondHandle.wait() );
+		EXPECT_TRUE( secondHandle.isReady() );
+		EXPECT_EQ( secondHandle.status(), SpcLoadHandle::Loaded );
+		EXPECT_EQ( secondHandle.runner(), &second );
+		EXPECT_STREQ( firstHandle.spcFile().id666Tag().songTitle.c_str(), "Prologue stage" );
+		EXPECT_STREQ( secondHandle.spcFile().id666Tag().songTitle.c_str(), "Battle Theme" );
+	}
+
+	// The prefetcher waited for the last load
+	EXPECT_EQ( missing.status(), SpcLoadHandle::Failed );
+	EXPECT_FALSE( missing.wait() );
+	EXPECT_TRUE( missing.spcFile().ramData().empty() );
+
+	// Same output as a runner loaded directly
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	direct.render(&expected[0], FrameCount);
+	second.render(&output[0], FrameCount);
+	EXPECT_EQ( output, expected );
+}
+
+TEST(TestSpcPrefetcher, InvalidHandle)
+{
+	SpcLoadHandle handle;
+	EXPECT_EQ( handle.status(), SpcLoadHandle::Invalid );
+	EXPECT_FALSE( handle.isReady() );
+	EXPECT_FALSE( handle.wait() );
+	EXPECT_TRUE( handle.runner() == 0 );
+}
@@ -0,0 +1,340 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <vector>
+
+// LegacySPC includes
+#include <memorymap.h>
+#include <spcfile.h>
+#include <spcfileloader.h>
+#include <spcrunner.h>
+#include <spcstate.h>
+
+using namespace LegacySPC;
+
+static const int FrameCount = 32000;
+
+// Render in chunks of growing, uneven sizes
+static void renderInChunks(SpcRunner &runner, s16 *output, int frameCount)
+{
+	int done = 0;
+	int chunk = 1;
+	while( done < frameCount )
+	{
+		int frames = chunk < frameCount - done ? chunk : frameCount - done;
+		runner.render(output + done * 2, frames);
+
+		done += frames;
+		chunk = chunk * 7 % 3001 + 1;
+	}
+}
+
+TEST(TestSpcRunner, RenderProducesSound)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	std::vector<s16> output(FrameCount * 2);
+	runner.render(&output[0], FrameCount);
+
+	int nonZero = 0;
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		if( output[i] != 0 )
+		{
+			nonZero++;
+		}
+	}
+	EXPECT_GT( nonZero, FrameCount );
+}
+
+TEST(TestSpcRunner, RejectsFileWithoutRam)
+{
+	SpcRunner runner;
+	EXPECT_FALSE( runner.loadSpcFile(SpcFile()) );
+
+	SpcFile tagOnly = SpcFileLoader(LEGACYSPC_TESTDATA"mmx1_prologue.spc", SpcFileLoader::TagOnly).spcFile();
+	EXPECT_FALSE( runner.loadSpcFile(tagOnly) );
+
+	SpcFile file = SpcFileLoader(LEGACYSPC_TESTDATA"mmx1_prologue.spc").spcFile();
+	EXPECT_TRUE( runner.loadSpcFile(file) );
+}
+
+TEST(TestSpcRunner, ChunkSizeDoesNotChangeOutput)
+{
+	SpcRunner whole;
+	SpcRunner chunked;
+	ASSERT_TRUE( whole.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( chunked.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	whole.render(&expected[0], FrameCount);
+	renderInChunks(chunked, &output[0], FrameCount);
+
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2;
+	}
+}
+
+TEST(TestSpcRunner, ResampledChunkSizeDoesNotChangeOutput)
+{
+	SpcRunner whole;
+	SpcRunner chunked;
+	ASSERT_TRUE( whole.loadSpcFile(LEGACYSPC_TESTDATA"dkc2_roller_coaster.spc") );
+	ASSERT_TRUE( chunked.loadSpcFile(LEGACYSPC_TESTDATA"dkc2_roller_coaster.spc") );
+	whole.setOutputSampleRate(44100);
+	chunked.setOutputSampleRate(44100);
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	whole.render(&expected[0], FrameCount);
+	renderInChunks(chunked, &output[0], FrameCount);
+
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2;
+	}
+}
+
+TEST(TestSpcRunner, FloatMatchesInteger)
+{
+	SpcRunner integerRunner;
+	SpcRunner floatRunner;
+	ASSERT_TRUE( integerRunner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( floatRunner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<float> output(FrameCount * 2);
+	integerRunner.render(&expected[0], FrameCount);
+	floatRunner.render(&output[0], FrameCount);
+
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i] / 32768.0f, output[i] ) << "at frame " << i / 2;
+	}
+}
+
+TEST(TestSpcRunner, RestoredStateRendersTheSame)
+{
+	SpcRunner original;
+	ASSERT_TRUE( original.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	original.render(static_cast<s16*>(0), FrameCount);
+
+	SpcState *state = new SpcState;
+	original.saveState(*state);
+
+	SpcRunner restored;
+	restored.restoreState(*state);
+	delete state;
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	original.render(&expected[0], FrameCount);
+	restored.render(&output[0], FrameCount);
+
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2;
+	}
+}
+
+TEST(TestSpcRunner, ForkGoesOnFromTheSamePoint)
+{
+	SpcRunner original;
+	ASSERT_TRUE( original.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	original.setOutputSampleRate(44100);
+	original.setVoiceMuted(2, true);
+	// Leaves input pending in the resampler
+	original.render(static_cast<s16*>(0), FrameCount + 17);
+
+	SpcRunner *fork = original.fork();
+	EXPECT_EQ( fork->outputSampleRate(), 44100 );
+	EXPECT_TRUE( fork->isVoiceMuted(2) );
+	EXPECT_EQ( fork->position(), original.position() );
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+	original.render(&expected[0], FrameCount);
+	fork->render(&output[0], FrameCount);
+	EXPECT_EQ( output, expected );
+
+	// Each plays on its own
+	byte value = original.memory()->readByte(0x8000);
+	fork->memory()->writeByte(0x8000, value + 1);
+	EXPECT_EQ( original.memory()->readByte(0x8000), value );
+	fork->render(static_cast<s16*>(0), FrameCount);
+	EXPECT_GT( fork->position(), original.position() );
+
+	// Seeking backward from the shared loaded state, even after
+	// the original loaded another file
+	ASSERT_TRUE( original.loadSpcFile(LEGACYSPC_TESTDATA"rs3_binarytag.spc") );
+	fork->setVoiceMuted(2, true);
+	ASSERT_TRUE( fork->seek(500) );
+
+	SpcRunner reference;
+	ASSERT_TRUE( reference.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	reference.setOutputSampleRate(44100);
+	reference.setVoiceMuted(2, true);
+	ASSERT_TRUE( reference.seek(500) );
+
+	reference.render(&expected[0], FrameCount);
+	fork->render(&output[0], FrameCount);
+	EXPECT_EQ( output, expected );
+
+	delete fork;
+}
+
+TEST(TestSpcRunner, ParallelRenderMatchesSerial)
+{
+	const int Rates[2] = { 32000, 44100 };
+	const int Frames = FrameCount * 5 + 123;
+
+	for(int rate = 0; rate < 2; rate++)
+	{
+		SpcRunner serial;
+		SpcRunner parallel;
+		ASSERT_TRUE( serial.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+		ASSERT_TRUE( parallel.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+		serial.setOutputSampleRate(Rates[rate]);
+		parallel.setOutputSampleRate(Rates[rate]);
+
+		std::vector<s16> expected(Frames * 2);
+		std::vector<s16> output(Frames * 2);
+		serial.render(&expected[0], Frames);
+		parallel.renderParallel(&output[0], Frames, 1, 3);
+
+		for(int i = 0; i < Frames * 2; i++)
+		{
+			ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2 << " at " << Rates[rate] << " Hz";
+		}
+
+		// Both runners end in the same state
+		serial.render(&expected[0], FrameCount);
+		parallel.render(&output[0], FrameCount);
+		for(int i = 0; i < FrameCount * 2; i++)
+		{
+			ASSERT_EQ( expected[i], output[i] ) << "after the parallel render, at frame " << i / 2;
+		}
+	}
+}
+
+TEST(TestSpcRunner, SeekMatchesRender)
+{
+	SpcRunner rendered;
+	SpcRunner seeked;
+	ASSERT_TRUE( rendered.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	ASSERT_TRUE( seeked.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	std::vector<s16> expected(FrameCount * 2);
+	std::vector<s16> output(FrameCount * 2);
+
+	// Forward
+	rendered.render(static_cast<s16*>(0), FrameCount * 3);
+	ASSERT_TRUE( seeked.seek(3000) );
+	EXPECT_EQ( seeked.position(), 3000 );
+
+	rendered.render(&expected[0], FrameCount);
+	seeked.render(&output[0], FrameCount);
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "at frame " << i / 2;
+	}
+
+	// Backward, from the loaded file
+	SpcRunner fromStart;
+	ASSERT_TRUE( fromStart.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	fromStart.render(static_cast<s16*>(0), FrameCount / 2);
+	ASSERT_TRUE( seeked.seek(500) );
+	EXPECT_EQ( seeked.position(), 500 );
+
+	fromStart.render(&expected[0], FrameCount);
+	seeked.render(&output[0], FrameCount);
+	for(int i = 0; i < FrameCount * 2; i++)
+	{
+		ASSERT_EQ( expected[i], output[i] ) << "after seeking backward, at frame " << i / 2;
+	}
+}
+
+TEST(TestSpcRunner, SeekWithoutFile)
+{
+	SpcRunner runner;
+	EXPECT_FALSE( runner.seek(1000) );
+}
+
+TEST(TestSpcRunner, SilenceEndsTheSong)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	runner.setMutedVoices(0xFF);
+	// The echo feedback fades out without ever reaching 0
+	runner.setSilenceDetection(250, 8);
+
+	std::vector<s16> output(FrameCount * 4, 1);
+	size_t rendered = runner.render(&output[0], FrameCount * 2);
+
+	EXPECT_EQ( runner.endReason(), SpcRunner::SilenceDetected );
+	EXPECT_GE( rendered, FrameCount / 4u );
+	EXPECT_LT( rendered, FrameCount * 2u );
+	for(size_t i = rendered * 2; i < output.size(); i++)
+	{
+		ASSERT_EQ( output[i], 0 ) << "at frame " << i / 2;
+	}
+
+	// Nothing more once the song ended
+	EXPECT_EQ( runner.render(&output[0], FrameCount), 0u );
+}
+
+TEST(TestSpcRunner, SleepEndsTheSong)
+{
+	SpcRunner runner;
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+
+	SpcState *state = new SpcState;
+	runner.saveState(*state);
+	// SLEEP
+	state->ram[state->processor.programCounter] = 0xEF;
+	runner.restoreState(*state);
+	delete state;
+
+	std::vector<s16> output(FrameCount * 2);
+	EXPECT_EQ( runner.render(&output[0], FrameCount), static_cast<size_t>(FrameCount) );
+	EXPECT_EQ( runner.endReason(), SpcRunner::NotEnded );
+
+	runner.setHaltDetection(true);
+	EXPECT_LT( runner.render(&output[0], FrameCount), static_cast<size_t>(FrameCount) );
+	EXPECT_EQ( runner.endReason(), SpcRunner::ProcessorHalted );
+}
+
+TEST(TestSpcRunner, RunUntilTheEnd)
+{
+	SpcRunner runner;
+	EXPECT_FALSE( runner.run() );
+
+	ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	// Would never end
+	EXPECT_FALSE( runner.run() );
+	EXPECT_EQ( runner.position(), 0 );
+
+	runner.setMutedVoices(0xFF);
+	runner.setSilenceDetection(250, 8);
+	EXPECT_TRUE( runner.run() );
+	EXPECT_EQ( runner.endReason(), SpcRunner::SilenceDetected );
+	EXPECT_GT( runner.position(), 0 );
+}
@@ -0,0 +1,145 @@
+/*
+ * LegacySPC - A portable object-oriented SPC emulator.
+ * Copyright (c) 2011 by Michaël Larouche <larouche@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; version 2 of the
+ * License
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+// gtest includes
+#include <gtest/gtest.h>
+
+// STL includes
+#include <cstdio>
+#include <cstring>
+
+// LegacySPC includes
+#include <mappedspcfile.h>
+#include <memorymap.h>
+#include <spcrunner.h>
+#include <tracereader.h>
+#include <tracerecord.h>
+#include <tracerecorder.h>
+
+using namespace LegacySPC;
+
+static const int FrameCount = 16000;
+
+static bool recordSong(const char *filename)
+{
+	SpcRunner runner;
+	if( !runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") )
+	{
+		return false;
+	}
+
+	TraceRecorder recorder;
+	if( !recorder.open(filename) )
+	{
+		return false;
+	}
+
+	runner.setTraceRecorder(&recorder);
+	runner.render(static_cast<s16*>(0), FrameCount);
+	runner.setTraceRecorder(0);
+	recorder.close();
+
+	return recorder.recordCount() > TraceRecorder::BufferRecords;
+}
+
+TEST(TestTraceRecorder, RecordAndRead)
+{
+	const char *filename = "testtracerecorder.trace";
+	ASSERT_TRUE( recordSong(filename) );
+
+	TraceReader reader(filename);
+	ASSERT_TRUE( reader.isOpen() );
+	ASSERT_GT( reader.count(), (size_t)TraceRecorder::BufferRecords );
+
+	// Starts with the registers of the file
+	MappedSpcFile file(LEGACYSPC_TESTDATA"mmx1_prologue.spc");
+	const TraceRecord &first = reader.record(0);
+	EXPECT_EQ( first.cycle, 0u );
+	EXPECT_EQ( first.programCounter, file.data()[0x25] | (file.data()[0x26] << 8) );
+	EXPECT_EQ( first.a, file.data()[0x27] );
+	EXPECT_EQ( first.x, file.data()[0x28] );
+	EXPECT_EQ( first.y, file.data()[0x29] );
+	EXPECT_EQ( first.programStatus, file.data()[0x2A] );
+	EXPECT_EQ( first.stackPointer, file.data()[0x2B] );
+
+	bool hasRead = false;
+	bool hasWrite = false;
+	for(size_t i = 1; i < reader.count(); i++)
+	{
+		const TraceRecord &record = reader.record(i);
+		ASSERT_GT( record.cycle, reader.record(i - 1).cycle ) << "at record " << i;
+		hasRead = hasRead || record.accessType == ReadAccess;
+		hasWrite = hasWrite || record.accessType == WriteAccess;
+	}
+	EXPECT_TRUE( hasRead );
+	EXPECT_TRUE( hasWrite );
+	// Within the rendered time, give or take an instruction
+	EXPECT_LT( reader.record(reader.count() - 1).cycle, (unsigned long long)FrameCount * 32 );
+
+	reader.close();
+	EXPECT_FALSE( reader.isOpen() );
+	std::remove(filename);
+}
+
+TEST(TestTraceRecorder, ReplayCompare)
+{
+	const char *filename = "testtracerecorder_replay.trace";
+	ASSERT_TRUE( recordSong(filename) );
+
+	// The same run matches
+	{
+		SpcRunner runner;
+		ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+		TraceRecorder recorder;
+		ASSERT_TRUE( recorder.compareWith(filename) );
+		runner.setTraceRecorder(&recorder);
+		runner.render(static_cast<s16*>(0), FrameCount);
+		recorder.flush();
+		EXPECT_EQ( recorder.divergence(), -1 );
+	}
+
+	// A different port input changes the run
+	{
+		SpcRunner runner;
+		ASSERT_TRUE( runner.loadSpcFile(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+		TraceRecorder recorder;
+		ASSERT_TRUE( recorder.compareWith(filename) );
+		runner.setTraceRecorder(&recorder);
+		runner.render(static_cast<s16*>(0), FrameCount / 2);
+		for(int port = 0; port < 4; port++)
+		{
+			runner.memory()->writeByte(0xF4 + port, 0x5A);
+		}
+		runner.render(static_cast<s16*>(0), FrameCount);
+		recorder.close();
+
+		ASSERT_GE( recorder.divergence(), 0 );
+		EXPECT_NE( memcmp(&recorder.expectedRecord(), &recorder.actualRecord(), sizeof(TraceRecord)), 0 );
+		EXPECT_GT( recorder.actualRecord().cycle, (unsigned long long)FrameCount / 2 * 32 - 100 );
+	}
+
+	std::remove(filename);
+}
+
+TEST(TestTraceRecorder, RefuseOtherFiles)
+{
+	TraceReader reader;
+	EXPECT_FALSE( reader.open(LEGACYSPC_TESTDATA"notaspcfile") );
+	EXPECT_FALSE( reader.open(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	EXPECT_FALSE( reader.open("does_not_exist.trace") );
+
+	TraceRecorder recorder;
+	EXPECT_FALSE( recorder.compareWith(LEGACYSPC_TESTDATA"mmx1_prologue.spc") );
+	EXPECT_FALSE( recorder.isOpen() );
+}